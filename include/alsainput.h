@@ -0,0 +1,73 @@
+#pragma once
+#include "audiosource.h"
+#include <alsa/asoundlib.h>
+#include <string>
+#include <thread>
+#include <fstream>
+
+/** Captures straight from ALSA in mmap mode rather than through PortAudio. Each block is timestamped from the snd_pcm_status system
+*   timestamp (CLOCK_MONOTONIC_RAW where the driver supports it) taken by the kernel when it updated the hardware pointer, rather than from
+*   when a user-space callback happened to run.
+*   A device of the form "file:<path>" reads a 16 or 32 bit PCM or 32 bit float WAV file instead, paced in real time, so the rest of the
+*   pipeline can be run without any audio hardware
+**/
+class AlsaInput : public AudioSource
+{
+    public:
+        AlsaInput(const std::string& sDevice, unsigned long nSampleRate, unsigned char nChannels, SpscQueue<audioblock>& queue);
+        virtual ~AlsaInput();
+
+        virtual bool Init();
+
+        virtual unsigned long GetBufferSize() const { return m_nPeriod;}
+        virtual double GetSuggestedLatency() const { return m_dLatencySetting;}
+        virtual double GetInputLatency() const;
+
+        /** How far the audio clock is running from the timestamp clock in ppm, from successive snd_pcm_status audio/system timestamp pairs **/
+        double GetAudioClockPPM() const { return m_dAudioPPM.load(std::memory_order_relaxed);}
+
+        static const std::string FILE_PREFIX;
+
+    private:
+        bool OpenDevice();
+        bool OpenFile();
+        void CloseDevice();
+
+        void DeviceThread();
+        void FileThread();
+
+        bool ReadDevice();
+        void Recover(int nError);
+
+        bool ReadWavHeader();
+        void ReadFileBlock(std::vector<unsigned char>& vBuffer);
+
+        float ToFloat(const unsigned char* pSample) const;
+        std::chrono::time_point<std::chrono::system_clock> ToSystemTime(const timespec& ts) const;
+        void TrackAudioClock(const timespec& tsSystem, const timespec& tsAudio);
+
+        std::string m_sDevice;
+        unsigned long m_nSampleRate;
+        unsigned char m_nChannels;
+
+        snd_pcm_t* m_pPcm;
+        snd_pcm_status_t* m_pStatus;
+        snd_pcm_format_t m_eFormat;
+        size_t m_nSampleBytes;
+        unsigned long m_nPeriod;
+        unsigned long m_nBufferFrames;
+        clockid_t m_clockId;    //the clock the kernel timestamps are taken from
+
+        std::ifstream m_file;
+        std::streampos m_nDataStart;
+        std::streamoff m_nDataSize;
+
+        long long m_nLastSystemNs;
+        long long m_nLastAudioNs;
+        std::atomic<double> m_dAudioPPM;
+
+        bool m_bRecovered;  //the stream has been restarted so the next block follows a gap
+
+        std::thread m_thread;
+        std::atomic<bool> m_bRun;
+};
@@ -0,0 +1,204 @@
+#pragma once
+#include "log.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <type_traits>
+
+/** One argument of a log record, kept in binary form until the background thread formats it **/
+struct logarg
+{
+    enum enumType {INT, UINT, DOUBLE, TEXT, TIME};
+
+    enumType eType = INT;
+    union
+    {
+        long long nInt;
+        unsigned long long nUint;
+        double dValue;
+        long long nTimeNs;      //system clock
+        struct
+        {
+            unsigned short nOffset;
+            unsigned short nLength;
+        } text;                 //copied in to the record's text area
+    };
+};
+
+/** A log message as written by the thread that logged it: the level, when it was logged and its parts, unformatted **/
+struct logrecord
+{
+    static const size_t MAX_ARGS = 12;
+    static const size_t TEXT_SIZE = 192;
+
+    pml::enumLevel eLevel = pml::LOG_INFO;
+    std::chrono::system_clock::time_point tp;
+    unsigned char nArgs = 0;
+    bool bTruncated = false;
+    unsigned short nTextUsed = 0;
+    logarg args[MAX_ARGS];
+    char sText[TEXT_SIZE];
+};
+
+/** Logging front end for the threads that must not block. A call copies its arguments as binary in to a lock-free ring and returns, without
+*   formatting anything, taking a lock or making a system call. A background thread formats the records and hands them on to pmlLog.
+*   If the ring is full the record is dropped and counted. Before Start, and after Stop, records are formatted and logged straight away.
+*   Strings are copied (truncated if the record runs out of room) so any string may be passed, not only literals
+**/
+class AsyncLog
+{
+    public:
+        static AsyncLog& Get();
+
+        void Start();
+
+        /** Formats and logs anything still in the ring and stops the background thread **/
+        void Stop();
+
+        /** Records below this level are thrown away by the caller before anything is copied **/
+        void SetLevel(pml::enumLevel eLevel) { m_nLevel.store(eLevel, std::memory_order_relaxed);}
+        bool IsEnabled(pml::enumLevel eLevel) const { return eLevel >= m_nLevel.load(std::memory_order_relaxed);}
+
+        unsigned long long GetDropped() const { return m_nDropped.load(std::memory_order_relaxed);}
+
+        template<typename... Args> void Log(pml::enumLevel eLevel, const Args&... args)
+        {
+            if(IsEnabled(eLevel) == false)
+            {
+                return;
+            }
+            if(m_bRun.load(std::memory_order_acquire) == false)
+            {
+                logrecord record;
+                Fill(record, eLevel, args...);
+                Write(record);
+                return;
+            }
+
+            size_t nPosition;
+            if(Claim(nPosition) == false)
+            {
+                m_nDropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            slot& theSlot = m_vSlots[nPosition & m_nMask];
+            Fill(theSlot.record, eLevel, args...);
+            theSlot.nSequence.store(nPosition+1, std::memory_order_release);
+        }
+
+        static const size_t RING_SIZE = 512;    //must be a power of two
+
+    private:
+        struct slot
+        {
+            std::atomic<size_t> nSequence{0};
+            logrecord record;
+        };
+
+        AsyncLog();
+        ~AsyncLog();
+
+        bool Claim(size_t& nPosition);
+        bool Drain();
+        void Write(const logrecord& record);
+        void WriterThread();
+
+        template<typename... Args> void Fill(logrecord& record, pml::enumLevel eLevel, const Args&... args)
+        {
+            record.eLevel = eLevel;
+            record.tp = std::chrono::system_clock::now();
+            record.nArgs = 0;
+            record.nTextUsed = 0;
+            record.bTruncated = false;
+            int dummy[] = {0, (Add(record, args), 0)...};
+            (void)dummy;
+        }
+
+        static logarg* Next(logrecord& record)
+        {
+            if(record.nArgs == logrecord::MAX_ARGS)
+            {
+                record.bTruncated = true;
+                return nullptr;
+            }
+            return &record.args[record.nArgs++];
+        }
+
+        static void AddText(logrecord& record, const char* pText, size_t nLength)
+        {
+            logarg* pArg = Next(record);
+            if(pArg)
+            {
+                size_t nRoom = logrecord::TEXT_SIZE-record.nTextUsed;
+                if(nLength > nRoom)
+                {
+                    nLength = nRoom;
+                    record.bTruncated = true;
+                }
+                memcpy(record.sText+record.nTextUsed, pText, nLength);
+                pArg->eType = logarg::TEXT;
+                pArg->text.nOffset = record.nTextUsed;
+                pArg->text.nLength = nLength;
+                record.nTextUsed += nLength;
+            }
+        }
+
+        static void Add(logrecord& record, const char* pText) { AddText(record, pText, pText ? strlen(pText) : 0);}
+        static void Add(logrecord& record, const std::string& sText) { AddText(record, sText.data(), sText.size());}
+        static void Add(logrecord& record, char c) { AddText(record, &c, 1);}
+        static void Add(logrecord& record, bool b) { AddText(record, b ? "1" : "0", 1);}
+
+        static void Add(logrecord& record, const std::chrono::system_clock::time_point& tp)
+        {
+            logarg* pArg = Next(record);
+            if(pArg)
+            {
+                pArg->eType = logarg::TIME;
+                pArg->nTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+            }
+        }
+
+        template<typename T> static typename std::enable_if<std::is_arithmetic<T>::value>::type Add(logrecord& record, T value)
+        {
+            logarg* pArg = Next(record);
+            if(pArg == nullptr)
+            {
+                return;
+            }
+            if(std::is_floating_point<T>::value)
+            {
+                pArg->eType = logarg::DOUBLE;
+                pArg->dValue = static_cast<double>(value);
+            }
+            else if(std::is_signed<T>::value)
+            {
+                pArg->eType = logarg::INT;
+                pArg->nInt = static_cast<long long>(value);
+            }
+            else
+            {
+                pArg->eType = logarg::UINT;
+                pArg->nUint = static_cast<unsigned long long>(value);
+            }
+        }
+
+        std::vector<slot> m_vSlots;
+        size_t m_nMask;
+        std::atomic<size_t> m_nEnqueue;
+        size_t m_nDequeue;      //writer thread only
+
+        std::atomic<int> m_nLevel;
+        std::atomic<bool> m_bRun;
+        std::atomic<unsigned long long> m_nDropped;
+        unsigned long long m_nReportedDropped;
+        std::thread m_thWriter;
+};
+
+/** Logs through the AsyncLog ring e.g. logAsync(pml::LOG_INFO, "Offset\tFPS change: ", dFPS) **/
+template<typename... Args> void logAsync(pml::enumLevel eLevel, const Args&... args)
+{
+    AsyncLog::Get().Log(eLevel, args...);
+}
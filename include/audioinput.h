@@ -1,42 +1,54 @@
 #pragma once
 #include "portaudio.h"
-#include <queue>
+#include "audiosource.h"
 #include <mutex>
-#include <condition_variable>
 
-using aframe = std::vector<float>;
-using timedframe = std::pair<std::chrono::time_point<std::chrono::system_clock>, aframe>;
-
-class AudioInput
+class AudioInput : public AudioSource
 {
     public:
-        AudioInput(unsigned long nDevice, unsigned long nSampleRate, unsigned char nChannels, std::condition_variable& cv);
+        AudioInput(unsigned long nDevice, unsigned long nSampleRate, unsigned char nChannels, SpscQueue<audioblock>& queue);
         ~AudioInput();
 
-        bool Init();
+        virtual bool Init();
 
         void Callback(const float* pBuffer, size_t nFrameCount,const PaStreamCallbackTimeInfo* pTimeInfo, int nFlags);
 
-        bool IsReady();
-        const timedframe& GetNextFrame();
-        bool RemoveFrame();
-
         void OffsetOpenTime(double dOffset);
 
+        /** Reopens the stream with double the frames per callback if auto-tuning and PortAudio has reported input overflows. If it can't be reopened
+        *   the previous size is tried again, and then every REOPEN_INTERVAL until a stream is open
+        **/
+        virtual void Tune();
+
+        virtual unsigned long GetBufferSize() const { return m_nFramesPerBuffer;}
+        virtual double GetSuggestedLatency() const { return m_dLatency;}
+        virtual double GetInputLatency() const { return m_dInputLatency;}
+
     private:
 
         bool OpenStream();
+        void CloseStream();
 
         unsigned long m_nDevice;
         unsigned long m_nSampleRate;
         unsigned char m_nChannels;
 
         std::mutex m_mutex;
-        std::condition_variable& m_cv;
 
         PaStream* m_pStream;
 
-        std::queue<timedframe> m_qBuffer;
+        bool m_bThreadConfigured;   //the callback thread gets configured by the first callback
+        bool m_bRestarted;
+
+        unsigned long m_nFramesPerBuffer;
+        double m_dLatency;
+        double m_dInputLatency;
+
+        unsigned long long m_nTunedOverflows;
+        std::chrono::steady_clock::time_point m_tpTuned;
+        unsigned long m_nTuneLimit; //the device would not open with more frames per buffer than this
+        bool m_bReopen;     //Tune closed the stream and could not open it again
+        std::chrono::steady_clock::time_point m_tpReopen;
 
         PaTime m_OpenTime;
         std::chrono::time_point<std::chrono::system_clock> m_tpOpen;
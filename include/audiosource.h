@@ -0,0 +1,162 @@
+#pragma once
+#include "spscqueue.h"
+#include "stagestats.h"
+#include "utils.h"
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+using aframe = std::vector<float>;
+using timedframe = std::pair<std::chrono::time_point<std::chrono::system_clock>, aframe>;
+
+/** A block of captured audio as queued for the decode stage **/
+struct audioblock
+{
+    timedframe frame;
+    bool bDiscontinuity = false;    //samples were lost between the previous block and this one
+    unsigned long nLost = 0;        //how many, if it could be told
+};
+
+/** Captures audio and queues it for the decode stage one block at a time, each block tagged with the time its first sample was captured.
+*   AudioInput does this through PortAudio and AlsaInput directly through ALSA
+**/
+class AudioSource
+{
+    public:
+        AudioSource(SpscQueue<audioblock>& queue) :
+            m_queue(queue),
+            m_nBufferSetting(BUFFER_DEFAULT),
+            m_dLatencySetting(0.0),
+            m_nChannel(0),
+            m_nOverflows(0),
+            m_dNextStart(-1.0),
+            m_nDiscontinuities(0),
+            m_nPendingLost(0),
+            m_pPool(nullptr),
+            m_nPoolMisses(0)
+        {
+        }
+
+        virtual ~AudioSource(){}
+
+        virtual bool Init()=0;
+
+        /** Reacts to overflows when auto-tuning the buffer size, and reopens the device if that left it closed. Must not be called from the capture thread **/
+        virtual void Tune(){}
+
+        /** Core and priority for the capture thread. Must be called before Init **/
+        void SetThreadConfig(const threadconfig& config) { m_config = config;}
+
+        /** Frames per block. BUFFER_AUTO starts at AUTO_BUFFER_MIN and lets the source back off when it overflows. Must be called before Init **/
+        void SetBufferSize(unsigned long nFrames) { m_nBufferSetting = nFrames;}
+
+        /** Suggested input latency in seconds. 0 uses the device default. Must be called before Init **/
+        void SetLatency(double dLatency) { m_dLatencySetting = dLatency;}
+
+        /** Which of the device's channels carries the LTC, counting from 0. Must be called before Init **/
+        void SetChannel(unsigned char nChannel) { m_nChannel = nChannel;}
+        unsigned char GetChannel() const { return m_nChannel;}
+
+        /** Block buffers are taken from this pool, and given back to it by the decode stage, rather than being allocated in the capture thread.
+        *   Must be called before Init
+        **/
+        void SetBufferPool(SpscQueue<aframe>* pPool) { m_pPool = pPool;}
+
+        /** Number of blocks that had to be allocated because the pool was empty **/
+        unsigned long long GetPoolMisses() const { return m_nPoolMisses.load(std::memory_order_relaxed);}
+
+        /** Time from the ADC capturing the first sample of a block to the block being queued for decoding **/
+        stagestats& GetStats() { return m_stats;}
+        const stagestats& GetStats() const { return m_stats;}
+
+        virtual unsigned long GetBufferSize() const=0;
+        virtual double GetSuggestedLatency() const=0;
+        virtual double GetInputLatency() const=0;
+        unsigned long long GetOverflowCount() const { return m_nOverflows.load(std::memory_order_relaxed);}
+        unsigned long long GetDiscontinuityCount() const { return m_nDiscontinuities.load(std::memory_order_relaxed);}
+
+        static const unsigned long BUFFER_AUTO = 0;
+        static const unsigned long BUFFER_DEFAULT = 1024;
+        static const unsigned long AUTO_BUFFER_MIN = 256;
+        static const unsigned long AUTO_BUFFER_MAX = 8192;
+
+    protected:
+        /** Checks the device clock time of the first sample of a block against where the previous block ended. dStart < 0 means the device gives no time.
+        *   Returns true if samples have been lost, with nLost set to how many
+        **/
+        bool CheckGap(double dStart, size_t nFrames, double dSampleRate, unsigned long& nLost)
+        {
+            bool bGap(false);
+            nLost = 0;
+            if(dStart >= 0.0 && m_dNextStart >= 0.0)
+            {   //timestamps jitter a little but a whole lost period is much more than half a block
+                double dGap = dStart-m_dNextStart;
+                if(std::abs(dGap) > 0.5*static_cast<double>(nFrames)/dSampleRate)
+                {
+                    bGap = true;
+                    nLost = dGap > 0.0 ? static_cast<unsigned long>(dGap*dSampleRate+0.5) : 0;
+                }
+            }
+            m_dNextStart = dStart >= 0.0 ? dStart + static_cast<double>(nFrames)/dSampleRate : -1.0;
+            return bGap;
+        }
+
+        /** An empty buffer with room for nFrames, from the pool if there is one to be had **/
+        aframe GetBuffer(size_t nFrames)
+        {
+            aframe af(std::move(m_afSpare));
+            m_afSpare = aframe();
+            std::chrono::steady_clock::time_point tpQueued;
+            if(af.capacity() == 0 && (m_pPool == nullptr || m_pPool->Pop(af, tpQueued) == false))
+            {
+                m_nPoolMisses.fetch_add(1, std::memory_order_relaxed);
+            }
+            af.clear();
+            af.reserve(nFrames);
+            return af;
+        }
+
+        /** Queues a block, marking it if samples were lost before it. A block the queue has no room for is lost too, but the device timestamps
+        *   carry on as if it wasn't, so its frames are added to what the next block that is queued says was lost
+        **/
+        void Queue(timedframe&& frame, bool bDiscontinuity, unsigned long nLost)
+        {
+            audioblock block;
+            unsigned long nFrames = frame.second.size();
+            block.frame = std::move(frame);
+            bDiscontinuity = bDiscontinuity || m_nPendingLost > 0;
+            block.bDiscontinuity = bDiscontinuity;
+            block.nLost = nLost + m_nPendingLost;
+            if(m_queue.Push(std::move(block)) == false)
+            {   //the queue counts the drop. Push leaves the block alone so its buffer is kept for the next one rather than freed here
+                m_afSpare = std::move(block.frame.second);
+                m_nPendingLost += nLost + nFrames;  //nLost doesn't include what was already pending
+                return;
+            }
+            m_nPendingLost = 0;
+            if(bDiscontinuity)
+            {
+                m_nDiscontinuities.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        SpscQueue<audioblock>& m_queue;
+
+        threadconfig m_config;
+        stagestats m_stats;
+
+        unsigned long m_nBufferSetting;
+        double m_dLatencySetting;
+        unsigned char m_nChannel;
+
+        std::atomic<unsigned long long> m_nOverflows;
+
+        double m_dNextStart;    //device time the next block should start at, < 0 if not known
+        std::atomic<unsigned long long> m_nDiscontinuities;
+        unsigned long m_nPendingLost;   //frames dropped because the queue was full, only touched by the capture thread
+
+        SpscQueue<aframe>* m_pPool;
+        std::atomic<unsigned long long> m_nPoolMisses;
+        aframe m_afSpare;   //the buffer of a block the queue had no room for. Kept here as only the decode stage may give buffers back to the pool
+};
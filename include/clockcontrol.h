@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+
+/** An adjustment to the system clock worked out by Offset **/
+struct clockcommand
+{
+    enum enumType {NONE, SLEW, FREQUENCY, STEP};
+
+    enumType eType = NONE;
+    double dValue = 0.0;    //seconds to slew by, ppm to change the frequency by or seconds to step the clock by
+};
+
+/** Carries out the clock adjustments Offset asks for. Kept apart from Offset so the slow system calls run on their own thread **/
+class ClockControl
+{
+    public:
+        ClockControl();
+
+        void Execute(const clockcommand& command);
+
+        /** Number of times the clock has been stepped and when (on the steady clock) the last step happened **/
+        unsigned long long GetStepCount() const { return m_nSteps.load(std::memory_order_acquire);}
+        std::chrono::steady_clock::time_point GetLastStepTime() const;
+
+        /** Asks the kernel whether any of the last slew is still to be made and publishes the answer for IsSlewPending. Called by the clock thread
+        *   after each command and every so often while a slew is running
+        **/
+        bool CheckSlew();
+
+        /** What CheckSlew last found, so the estimate thread can tell a slew is still running without making a system call **/
+        bool IsSlewPending() const { return m_bSlewPending.load(std::memory_order_acquire);}
+
+    private:
+        void Slew(double dOffset);
+        void ChangeFrequency(double dPPM);
+        void Step(double dOffset);
+
+        std::atomic<long long> m_nLastStepNs;
+        std::atomic<unsigned long long> m_nSteps;
+        std::atomic<bool> m_bSlewPending;
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include "pipeline.h"
+#include "log.h"
+#include <string>
+#include <vector>
+#include <functional>
+#include <ostream>
+
+/** Every tunable of the client. Read from a file of "key = value" lines, where a "[section]" line puts "section." in front of the keys that follow
+*   and # starts a comment, and then from the command line, which wins: --<key>=<value>, or --<key> alone to turn a flag on.
+*   Anything on the command line that doesn't start with -- is an LTC source and replaces any sources in the file.
+*   The live settings are taken up again when the file is reloaded (on SIGHUP). Changing any other needs a restart
+**/
+class Config
+{
+    public:
+        Config();
+        Config(const Config&) = delete;     //the settings are bound to the members
+        Config& operator=(const Config&) = delete;
+
+        /** --config=<path> names the file, otherwise DEFAULT_PATH is read if it exists. Logs and returns false if anything can't be understood **/
+        bool Load(int argc, char* argv[]);
+
+        /** Reads the file again, with the command line still winning. Only live settings change: any other that differs is logged as needing a
+        *   restart. Returns false, with nothing changed, if the file can't be read or understood
+        **/
+        bool Reload();
+
+        /** Logs every setting **/
+        void Log() const;
+
+        /** Every key with its default and what it does **/
+        static void Usage(std::ostream& os);
+
+        //read by main. Priorities of 0 leave a stage at the pipeline's default
+        std::vector<std::string> vSources;      //<alsa device>|file:<path>|pa:<index>[@channel]
+        bool bCombine = false;
+        unsigned long nSampleRate = 48000;
+        unsigned long nChannels = 2;
+        int nDecoderQueue = LtcDecoder::QUEUE_SIZE;
+        unsigned long nCaptureBuffer = AudioSource::BUFFER_AUTO;
+        double dCaptureLatency = 0.0;
+        LtcSource::enumWakeup eWakeup = LtcSource::WAKE_DEADLINE;
+        unsigned long nWatermark = LtcSource::CAPTURE_WATERMARK;
+        long long nSlackUs = LtcSource::DEADLINE_SLACK_US;
+        bool bRealtime = true;
+        threadconfig stage[Pipeline::STAGES];
+        std::string sRecorderPath = "/var/lib/ltcclient/ltcclient.rec";
+        unsigned long long nRecorderCapacity = EventRecorder::DEFAULT_CAPACITY;
+        std::string sMetricsEndpoint = "9580";
+        bool bDaemon = false;
+        std::string sPidFile;
+        std::string sControlSocket = "/run/ltcclient.sock";
+
+        //live
+        servoconfig servo;
+        double dSelectTolerance = SourceSelector::DEFAULT_TOLERANCE;
+        double dMetricsInterval = 10.0;
+        pml::enumLevel eLogLevel = pml::LOG_INFO;
+
+        static const std::string DEFAULT_PATH;
+
+    private:
+        struct setting
+        {
+            std::string sKey;
+            bool bLive;
+            std::string sHelp;
+            std::function<bool(const std::string&)> set;
+            std::function<std::string()> get;
+            std::string sRange = std::string();     //what a ranged setting must be, for the messages
+        };
+
+        template<typename T> void Bind(const std::string& sKey, T& value, bool bLive, const std::string& sHelp);
+        /** Values outside [min, max] are refused as if they couldn't be read, so a reload with one leaves every setting as it was **/
+        template<typename T> void Bind(const std::string& sKey, T& value, T min, T max, bool bLive, const std::string& sHelp);
+        template<typename E> void BindChoice(const std::string& sKey, E& eValue, const std::vector<std::string>& vChoices, bool bLive,
+                                             const std::string& sHelp);
+
+        bool ReadFile(bool bMissingOk);
+        bool ReadArgs();
+        bool Set(const std::string& sKey, const std::string& sValue, const std::string& sWhere);
+
+        std::string m_sPath;
+        bool m_bPathGiven;
+        std::vector<std::string> m_vArgs;
+        std::vector<setting> m_vSettings;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <atomic>
+
+class Pipeline;
+
+/** Lets a running client be queried and steered over a Unix socket, one command per line with one line of JSON back for each:
+*   status                      the current timecode, offset, frequency error, lock and sync state and every source
+*   source <index|name|auto>    follow that source for as long as it is decoding, or go back to letting the selector choose
+*   relock                      have every decoder find the LTC again and the servo start over
+*   pause / resume              stop and start carrying out the servo's commands, e.g. while another clock source is tried
+*   Everything is read from what the pipeline publishes and every command only sets an atomic, so nothing here can hold the pipeline up.
+*   Clients are served one at a time on the server's own thread, which runs at normal priority. The socket is only open to our own user and group
+**/
+class ControlServer
+{
+    public:
+        explicit ControlServer(Pipeline& pipeline);
+        ~ControlServer();
+
+        bool Start(const std::string& sPath);
+        void Stop();
+
+    private:
+        int Listen(const std::string& sPath);
+        void ServerThread();
+        bool IsAllowed(int nClient) const;
+        void Serve(int nClient);
+        std::string Execute(const std::string& sLine);
+        std::string Status() const;
+        std::string PinSource(const std::string& sSource);
+
+        Pipeline& m_pipeline;
+        int m_nListen;
+        std::string m_sPath;
+        std::thread m_thServer;
+        std::atomic<bool> m_bRun;
+};
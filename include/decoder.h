@@ -18,16 +18,29 @@
    If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdint.h>
 #include "ltc.h"
 #ifndef SAMPLE_CENTER // also defined in encoder.h
 #define SAMPLE_CENTER 128 // unsigned 8 bit.
 #endif
 
+#define LTC_ACQ_HISTORY 4096 ///< samples of soft-decision history kept by the sync-word correlator, power of 2. Enough for a sync word at 24fps and 384kHz
+#define LTC_ACQ_RATES 3 ///< number of bit periods the correlator searches
+#define LTC_ACQ_SYNC_BITS 16
+
+enum LTC_ACQ_STATE {
+	LTC_ACQ_OFF, ///< the tracking path is decoding
+	LTC_ACQ_SEARCH, ///< correlating against the sync word
+	LTC_ACQ_SOFT ///< decoding from soft decisions
+};
+
 struct LTCDecoder {
 	LTCFrameExt* queue;
 	int queue_len;
 	int queue_read_off;
 	int queue_write_off;
+	int queue_backpressure;
+	unsigned long long queue_overflows;
 
 	unsigned char biphase_state;
 	unsigned char biphase_prev;
@@ -40,7 +53,7 @@ struct LTCDecoder {
 	ltcsnd_sample_t snd_to_biphase_max;
 
 	unsigned short decoder_sync_word;
-	LTCFrame ltc_frame;
+	uint64_t ltc_bits[2]; ///< the frame being assembled as an 80 bit shift register, bit n of the frame is bit n%64 of word n/64
 	int bit_cnt;
 
 	ltc_off_t frame_start_off;
@@ -48,7 +61,29 @@ struct LTCDecoder {
 
 	float biphase_tics[LTC_FRAME_BIT_COUNT];
 	int biphase_tic;
+
+	/* correlation based acquisition - only runs while the tracking path has no lock */
+	int acq_enabled;
+	enum LTC_ACQ_STATE acq_state;
+	int acq_since_frame; ///< samples since a frame was last queued
+	int acq_fill; ///< number of valid samples in the acquisition history
+	unsigned int acq_pos;
+	unsigned int acq_sum[LTC_ACQ_HISTORY]; ///< running sum of the centred signal
+	float acq_soft[LTC_ACQ_RATES][LTC_ACQ_HISTORY]; ///< soft bit decision for a bit cell ending at each sample
+	double acq_period[LTC_ACQ_RATES];
+	int acq_half[LTC_ACQ_RATES];
+	int acq_offset[LTC_ACQ_RATES][LTC_ACQ_SYNC_BITS]; ///< distance back in samples to the end of each bit of the sync word
+	float acq_corr[LTC_ACQ_RATES]; ///< correlation at the previous sample
+	float acq_amp[LTC_ACQ_RATES]; ///< average signal amplitude
+	int acq_prev_level;
+	int acq_rate; ///< candidate being decoded from soft decisions
+	double acq_next; ///< position in the history of the end of the next bit
+	float acq_quality; ///< average strength of the soft decisions
+	unsigned long long acq_locks;
 };
 
+int acquisition_init(LTCDecoder *d, double period);
+void decoder_reset(LTCDecoder *d);
+
 
-void decode_ltc(LTCDecoder *d, ltcsnd_sample_t *sound, size_t size, ltc_off_t posinfo);
+size_t decode_ltc(LTCDecoder *d, ltcsnd_sample_t *sound, size_t size, ltc_off_t posinfo);
@@ -0,0 +1,79 @@
+#pragma once
+#include "ltcsource.h"
+#include <string>
+#include <vector>
+#include <ostream>
+#include <chrono>
+
+/** What was decoded from one channel of a device **/
+struct channelscan
+{
+    unsigned char nChannel = 0;
+    unsigned long long nFrames = 0;     //LTC frames decoded
+    double dFPS = 0.0;
+    double dVolume = 0.0;               //dBFS of the last frame
+};
+
+/** What the probe found out about one capture device **/
+struct deviceprobe
+{
+    LtcSource::enumBackend eBackend = LtcSource::PORTAUDIO;
+    std::string sDevice;                //as it would be given to ltcclient as a source
+    std::string sName;
+    std::string sHostApi;
+    unsigned long nMaxChannels = 0;
+    double dDefaultLowLatency = 0.0;    //seconds, PortAudio only
+    double dDefaultHighLatency = 0.0;
+    std::vector<unsigned long> vSampleRates;
+    std::vector<unsigned long> vBufferSizes;
+    std::string sError;                 //why the device could not be probed or captured from
+
+    //from capturing for a while
+    bool bMeasured = false;
+    unsigned long nSampleRate = 0;
+    unsigned long nBufferSize = 0;
+    double dInputLatency = 0.0;         //seconds, as the driver reports it
+    unsigned long long nBlocks = 0;
+    double dInterval = 0.0;             //mean time between blocks arriving, seconds
+    double dJitter = 0.0;               //RMS difference of the time between blocks from the block length, seconds
+    double dMaxJitter = 0.0;            //worst difference, seconds
+    unsigned long long nOverflows = 0;
+    unsigned long long nDiscontinuities = 0;
+    std::vector<channelscan> vChannels;
+};
+
+/** Finds every PortAudio and ALSA capture device and works out what it can do, so a source can be picked without guesswork.
+*   The sample rates each device supports are asked of PortAudio (Pa_IsFormatSupported) or ALSA without capturing anything, and each buffer size
+*   by opening a stream with it. Each device is then captured from for a while to measure how evenly its blocks arrive and what input latency its
+*   driver reports, with the first channel run through an LTC decoder, or if scanning every channel in turn.
+*   The results are written as JSON along with the source best suited to use: the lowest latency device, of those carrying LTC if any do
+**/
+class DeviceProbe
+{
+    public:
+        DeviceProbe(std::chrono::milliseconds duration, bool bScan);
+
+        void Run();
+
+        const std::vector<deviceprobe>& GetDevices() const { return m_vDevices;}
+
+        /** The recommended source as <device>@<channel>, or empty if no device could be captured from **/
+        std::string GetRecommended() const;
+
+        void WriteJson(std::ostream& os) const;
+
+        static const std::vector<unsigned long> SAMPLE_RATES;
+        static const std::vector<unsigned long> BUFFER_SIZES;
+        static const unsigned long PREFERRED_RATE = 48000;
+        static const unsigned long SETTLE_BLOCKS = 4;   //blocks at the start of a capture left out of the jitter, while the stream gets going
+
+    private:
+        void FindPortAudio();
+        void FindAlsa();
+        void Measure(deviceprobe& device);
+        bool Capture(deviceprobe& device, unsigned char nChannel, bool bTime);
+
+        std::chrono::milliseconds m_duration;
+        bool m_bScan;
+        std::vector<deviceprobe> m_vDevices;
+};
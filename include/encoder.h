@@ -23,6 +23,17 @@
 #define SAMPLE_CENTER 128 // unsigned 8 bit.
 #endif
 
+/* the filtered edge moves at least one step per sample until it settles,
+ * so it can never take more than this many samples from SAMPLE_CENTER */
+#define LTC_EDGE_MAX 130
+
+/* what encode_byte() renders into */
+enum LTC_ENC_OUTPUT {
+	LTC_ENC_U8,    /* the internal buffer */
+	LTC_ENC_FLOAT, /* a caller's float buffer, see ltc_encoder_encode_frame_float() */
+	LTC_ENC_S16    /* a caller's s16 buffer, see ltc_encoder_encode_frame_s16() */
+};
+
 struct LTCEncoder {
 	double fps;
 	double sample_rate;
@@ -42,6 +53,29 @@ struct LTCEncoder {
 	double sample_remainder;
 
 	LTCFrame f;
+
+	/* pre-rendered low-pass edges from SAMPLE_CENTER towards enc_lo [0] and enc_hi [1],
+	 * forwards and reversed. The last sample is the value the filter settles at */
+	ltcsnd_sample_t edge[2][LTC_EDGE_MAX];
+	ltcsnd_sample_t edge_rev[2][LTC_EDGE_MAX];
+	int edge_len[2];
+
+	/* the same edges for float and s16 output: unquantised, at 'level' (1.0 = 0dBFS),
+	 * lo then hi, each edge_f_len long which covers a whole bit */
+	double level;
+	float *edge_f;
+	short *edge_s16;
+	int edge_f_len;
+
+	enum LTC_ENC_OUTPUT out_format;
+	void *out;
+	int out_stride;
+	size_t out_offset;
 };
 
 int encode_byte(LTCEncoder *e, int byte, double speed);
+void encoder_update_edges(LTCEncoder *e);
+
+/* bulk rendering, see ltc_encoder_render_float(). These only read the encoder */
+long long encoder_render_offset(LTCEncoder *e, long long halfbit);
+int encoder_render_frame(LTCEncoder *e, enum LTC_ENC_OUTPUT format, const LTCFrame *f, long long frame, long long base, void *buf, int state);
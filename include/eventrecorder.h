@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <chrono>
+
+/** What is kept for every decoded LTC frame. Fixed size and plain data so it can be written straight in to the mapped file **/
+struct framerecord
+{
+    enum enumFlags {FLAG_DISCONTINUITY = 1, FLAG_SYNCED = 2, FLAG_DISCARDED = 4, FLAG_FAILOVER = 8, FLAG_COMBINED = 16, FLAG_PAUSED = 32};
+
+    uint64_t nSequence = 0;     //position in the file's history, starting at 1. Written last so a record torn by a crash can be spotted
+    int64_t nCaptureNs = 0;     //system clock time the first bit of the frame was captured
+    int64_t nLtcNs = 0;         //time the frame says, as system clock
+    int64_t nOffsetUs = 0;      //LTC minus capture time
+    int64_t nFrameStart = 0;    //sample positions of the frame in the decoder's timeline
+    int64_t nFrameEnd = 0;
+    double dCommandValue = 0.0; //what the servo did in response to this frame, if anything
+    float fVolume = 0.0f;       //dBFS
+    float fFPS = 0.0f;
+    float fPPM = 0.0f;          //frequency error from the last regression
+    uint32_t nRejected = 0;     //frames rejected by the validator so far
+    uint8_t raw[10] = {};       //the frame's 80 bits as decoded, user bits and all
+    uint8_t nCommand = 0;       //clockcommand::enumType
+    uint8_t nFlags = 0;
+    uint8_t nSource = 0;        //which of the pipeline's sources the frame came from, or the active one if it was combined
+    uint8_t reserved[11] = {};
+};
+static_assert(sizeof(framerecord) == 96, "framerecord is part of the file format");
+
+/** The start of the recorder file **/
+struct recorderheader
+{
+    char sMagic[8];
+    uint32_t nVersion;
+    uint32_t nRecordSize;
+    uint64_t nCapacity;
+    uint64_t nNext;             //sequence number of the next record to be written
+    uint8_t reserved[32];
+};
+static_assert(sizeof(recorderheader) == 64, "recorderheader is part of the file format");
+
+/** Keeps the last nCapacity framerecords in a memory-mapped ring file. Writing a record is a copy in to the mapping: no allocation and no
+*   system call. As the mapping is shared the kernel writes it back even if the process crashes, and Flush asks it to do so periodically in case
+*   the power goes. The ring carries on from where it was when the file is reopened
+**/
+class EventRecorder
+{
+    public:
+        EventRecorder();
+        ~EventRecorder();
+
+        /** Creates the file's directory if need be. Refuses a symlink, or anything other than a regular file we own with a single link, as we run as root **/
+        bool Open(const std::string& sPath, uint64_t nCapacity=DEFAULT_CAPACITY);
+        void Close();
+        bool IsOpen() const { return m_pHeader != nullptr;}
+
+        /** Single writer only **/
+        void Record(framerecord& record);
+
+        /** Starts writing dirty pages back if FLUSH_INTERVAL has passed since the last time. Called from a non real-time thread **/
+        void Flush();
+
+        static const uint64_t DEFAULT_CAPACITY = 3*60*60*30;    //three hours at 30fps
+        static const uint32_t VERSION = 1;
+        static const char MAGIC[8];
+
+    private:
+        recorderheader* m_pHeader;
+        framerecord* m_pRecords;
+        size_t m_nMapSize;
+        std::chrono::steady_clock::time_point m_tpFlushed;
+};
+
+/** Reads a recorder file, oldest record first. Used by the dump tool **/
+class EventReader
+{
+    public:
+        EventReader();
+        ~EventReader();
+
+        bool Open(const std::string& sPath);
+
+        /** Returns false once there are no more records. Records torn by a crash are skipped **/
+        bool Next(framerecord& record);
+
+        uint64_t GetSkipped() const { return m_nSkipped;}
+
+    private:
+        const recorderheader* m_pHeader;
+        const framerecord* m_pRecords;
+        size_t m_nMapSize;
+        uint64_t m_nSequence;
+        uint64_t m_nEnd;
+        uint64_t m_nSkipped;
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include "ltc.h"
+
+/** Checks each decoded LTC frame against its parity bit and against the frame predicted from the last good one.
+*   A frame that disagrees with its parity and differs from the prediction by a single bit is corrected,
+*   anything else that does not follow on from the previous frame is rejected.
+*   The user bits are not predicted, they are whatever the frame carries. Two frames a step apart in either direction
+*   set the direction of play, so reverse play is followed too. If the frame rate learnt turns out to be wrong, because
+*   another rate keeps predicting the frames it gets wrong, that rate is learnt instead
+**/
+class FrameValidator
+{
+    public:
+        FrameValidator();
+
+        enum enumResult {ACCEPTED, CORRECTED, REJECTED};
+
+        enumResult Validate(LTCFrame& frame);
+        void Reset();
+
+        unsigned long long GetRejectedCount() const { return m_nRejected;}
+        unsigned long long GetCorrectedCount() const { return m_nCorrected;}
+
+        bool IsParityInUse() const { return m_nFPS != 0 && m_nParityScore > 0;}
+        unsigned char GetFPS() const { return m_nFPS;}
+
+    private:
+        LTC_TV_STANDARD GetStandard(int nFPS) const;
+        bool CheckParity(const LTCFrame& frame) const;
+        unsigned int CountDifferences(const LTCFrame& frame, const LTCFrame& predicted, int nFPS) const;
+        int Predict(const LTCFrame& previous, const LTCFrame& frame, LTCFrame& predicted, bool bReverse) const;
+        void Step(const LTCFrame& previous, const LTCFrame& frame, LTCFrame& predicted, int nFPS, bool bReverse) const;
+
+        bool Follows(const LTCFrame& frame, const LTCFrame& previous);
+        void LearnFPS(int nFPS);
+        bool RelearnFPS(const LTCFrame& frame);
+        void UpdateParityScore(bool bParity);
+
+        LTCFrame m_last;
+        bool m_bLast;
+
+        LTCFrame m_candidate;
+        bool m_bCandidate;
+
+        bool m_bReverse;
+
+        unsigned char m_nFPS;
+        unsigned char m_nOtherFPS;
+        int m_nOtherFPSCount;
+        int m_nParityScore;
+
+        unsigned long long m_nRejected;
+        unsigned long long m_nCorrected;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <ostream>
+
+/** HDR-style latency histogram. Buckets are log-linear: exact below 32ns, then 32 buckets per power of two so any value is recorded to within about 3%,
+*   up to 2^(MAX_BIT+1)ns. Recording is a couple of relaxed atomic adds so it is safe from any thread, including the audio callback, and never blocks
+**/
+class LatencyHistogram
+{
+    public:
+        void Record(std::chrono::nanoseconds latency);
+
+        unsigned long long GetCount() const;
+        unsigned long long GetMaxNs() const { return m_nMaxNs.load(std::memory_order_relaxed);}
+
+        /** The latency below which dPercentile percent of the recorded values fall, e.g. 99.9. Reported as the upper edge of the bucket it falls in **/
+        unsigned long long GetPercentileNs(double dPercentile) const;
+
+        static const unsigned int SUB_BUCKET_BITS = 5;
+        static const unsigned int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static const unsigned int MAX_BIT = 39;     //2^40ns is about 18 minutes. Anything longer goes in the last bucket
+        static const unsigned int BUCKETS = (MAX_BIT-SUB_BUCKET_BITS+2)*SUB_BUCKETS;
+
+    private:
+        static unsigned int ToBucket(unsigned long long nNs);
+        static unsigned long long BucketUpperNs(unsigned int nBucket);
+
+        std::atomic<unsigned long long> m_nCounts[BUCKETS] = {};
+        std::atomic<unsigned long long> m_nMaxNs{0};
+};
+
+/** The points on the hot path that are timed when built with LATENCY_HISTOGRAMS **/
+enum enumLatencyPoint {LATENCY_CALLBACK,        //time spent in the capture callback or read
+                       LATENCY_QUEUE_DWELL,     //an audio block waiting in the capture queue for the decode stage
+                       LATENCY_WRITE_FLOAT,     //ltc_decoder_write_float
+                       LATENCY_READ,            //ltc_decoder_read_span
+                       LATENCY_DATE_TIME,       //DecodeDateAndTime
+                       LATENCY_OFFSET_ADD,      //Offset::Add
+                       LATENCY_END_TO_END,      //ADC capturing the last bit of a frame to Offset::Add getting its offset
+                       LATENCY_POINTS};
+
+extern LatencyHistogram g_latency[LATENCY_POINTS];
+
+/** Logs count, p50, p99, p99.9 and max for every point. Not safe to call from a signal handler **/
+extern void LogLatencyHistograms();
+
+/** Writes the histograms as Prometheus summaries. Writes nothing unless built with LATENCY_HISTOGRAMS **/
+extern void WriteLatencyMetrics(std::ostream& os);
+
+#ifdef LATENCY_HISTOGRAMS
+#define LATENCY_START(tp) auto tp = std::chrono::steady_clock::now()
+#define LATENCY_END(point, tp) g_latency[point].Record(std::chrono::steady_clock::now()-tp)
+#define LATENCY_RECORD(point, latency) g_latency[point].Record(latency)
+#else
+//compiled out: the arguments are not even evaluated
+#define LATENCY_START(tp)
+#define LATENCY_END(point, tp)
+#define LATENCY_RECORD(point, latency)
+#endif
@@ -408,6 +408,10 @@ int ltc_frame_decrement(LTCFrame* frame, int fps, enum LTC_TV_STANDARD standard,
 /**
  * Create a new LTC decoder.
  *
+ * The decoder tracks the signal's edges against a threshold that follows the
+ * signal's level. It can also search for the sync word by correlation while
+ * it has no lock, see \ref ltc_decoder_set_acquisition.
+ *
  * @param apv audio-frames per video frame. This is just used for initial settings, the speed is tracked dynamically. setting this in the right ballpark is needed to properly decode the first LTC frame in a sequence.
  * @param queue_size length of the internal queue to store decoded frames
  * to SMPTEDecoderWrite.
@@ -428,12 +432,18 @@ int ltc_decoder_free(LTCDecoder *d);
  * Parse raw audio for LTC timestamps. Once a complete LTC frame has been
  * decoded it is pushed into a queue (\ref ltc_decoder_read)
  *
+ * If the queue is full the oldest unread frame is overwritten and counted
+ * (\ref ltc_decoder_queue_overflows), unless back-pressure is enabled
+ * (\ref ltc_decoder_set_backpressure) in which case parsing stops and
+ * fewer than \ref size samples are consumed.
+ *
  * @param d decoder handle
  * @param buf pointer to ltcsnd_sample_t - unsigned 8 bit mono audio data
  * @param size \anchor size number of samples to parse
  * @param posinfo (optional, recommended) sample-offset in the audio-stream. It is added to \ref off_start, \ref off_end in \ref LTCFrameExt and should be monotonic (ie incremented by \ref size for every call to ltc_decoder_write)
+ * @return number of samples consumed
  */
-void ltc_decoder_write(LTCDecoder *d,
+size_t ltc_decoder_write(LTCDecoder *d,
 		ltcsnd_sample_t *buf, size_t size,
 		ltc_off_t posinfo);
 
@@ -445,8 +455,9 @@ void ltc_decoder_write(LTCDecoder *d,
  * @param buf pointer to audio sample data
  * @param size number of samples to parse
  * @param posinfo (optional, recommended) sample-offset in the audio-stream.
+ * @return number of samples consumed, see \ref ltc_decoder_write
  */
-void ltc_decoder_write_float(LTCDecoder *d, float *buf, size_t size, ltc_off_t posinfo);
+size_t ltc_decoder_write_float(LTCDecoder *d, float *buf, size_t size, ltc_off_t posinfo);
 
 /**
  * Wrapper around \ref ltc_decoder_write that accepts signed 16 bit
@@ -456,8 +467,9 @@ void ltc_decoder_write_float(LTCDecoder *d, float *buf, size_t size, ltc_off_t p
  * @param buf pointer to audio sample data
  * @param size number of samples to parse
  * @param posinfo (optional, recommended) sample-offset in the audio-stream.
+ * @return number of samples consumed, see \ref ltc_decoder_write
  */
-void ltc_decoder_write_s16(LTCDecoder *d, short *buf, size_t size, ltc_off_t posinfo);
+size_t ltc_decoder_write_s16(LTCDecoder *d, short *buf, size_t size, ltc_off_t posinfo);
 
 /**
  * Wrapper around \ref ltc_decoder_write that accepts unsigned 16 bit
@@ -467,8 +479,9 @@ void ltc_decoder_write_s16(LTCDecoder *d, short *buf, size_t size, ltc_off_t pos
  * @param buf pointer to audio sample data
  * @param size number of samples to parse
  * @param posinfo (optional, recommended) sample-offset in the audio-stream.
+ * @return number of samples consumed, see \ref ltc_decoder_write
  */
-void ltc_decoder_write_u16(LTCDecoder *d, unsigned short *buf, size_t size, ltc_off_t posinfo);
+size_t ltc_decoder_write_u16(LTCDecoder *d, unsigned short *buf, size_t size, ltc_off_t posinfo);
 
 /**
  * Decoded LTC frames are placed in a queue. This function retrieves
@@ -480,12 +493,47 @@ void ltc_decoder_write_u16(LTCDecoder *d, unsigned short *buf, size_t size, ltc_
  */
 int ltc_decoder_read(LTCDecoder *d, LTCFrameExt *frame);
 
+/**
+ * Direct access to the decoded LTC frames waiting in the queue,
+ * without copying them out. The frames stay in the queue until they
+ * are released with \ref ltc_decoder_read_commit.
+ *
+ * The queue is a ring-buffer, only the frames up to the end of the
+ * ring are returned. Once they have been committed call this function
+ * again to get the rest.
+ *
+ * The returned frames are only valid until the next call to one of
+ * the ltc_decoder_write functions.
+ *
+ * @param d decoder handle
+ * @param frames is set to point to the first pending frame
+ * @return the number of contiguous frames at *frames or 0 when no frames queued.
+ */
+int ltc_decoder_read_span(LTCDecoder *d, const LTCFrameExt **frames);
+
+/**
+ * Remove frames obtained with \ref ltc_decoder_read_span from the queue.
+ *
+ * @param d decoder handle
+ * @param count number of frames to release, this is limited to the number of queued frames
+ */
+void ltc_decoder_read_commit(LTCDecoder *d, int count);
+
 /**
  * Remove all LTC frames from the internal queue.
  * @param d decoder handle
  */
 void ltc_decoder_queue_flush(LTCDecoder* d);
 
+/**
+ * Forget any partly decoded bit or frame, e.g. after samples have been
+ * lost, so that audio either side of the gap is not stitched together
+ * in to one frame. The tracked bit period and signal level are kept.
+ * Frames already in the queue are not affected, see \ref ltc_decoder_queue_flush.
+ * @param d decoder handle
+ */
+void ltc_decoder_reset(LTCDecoder* d);
+
 /**
  * Count number of LTC frames currently in the queue.
  * @param d decoder handle
@@ -493,6 +541,68 @@ void ltc_decoder_queue_flush(LTCDecoder* d);
  */
 int ltc_decoder_queue_length(LTCDecoder* d);
 
+/**
+ * Number of decoded frames that have been overwritten in the queue
+ * before they were read.
+ * @param d decoder handle
+ * @return number of lost frames since the decoder was created
+ */
+unsigned long long ltc_decoder_queue_overflows(LTCDecoder* d);
+
+/**
+ * Enable or disable back-pressure. With back-pressure enabled the
+ * ltc_decoder_write functions stop consuming audio when the queue is full
+ * instead of overwriting unread frames. The caller must read the queue and
+ * write the remaining samples again. Useful when decoding from a file
+ * where the audio can wait but frames must not be lost.
+ *
+ * @param d decoder handle
+ * @param enable 1 to enable, 0 to disable (default)
+ */
+void ltc_decoder_set_backpressure(LTCDecoder* d, int enable);
+
+/**
+ * Enable or disable the correlation based sync-word search.
+ *
+ * While no frames are being decoded the incoming signal is turned into
+ * soft bit decisions: for the bit cell ending at each sample, do its two
+ * halves have opposite signs (a '1') or the same sign (a '0'), and how
+ * strongly. These are correlated against the sync word for 24, 25 and 30 fps
+ * (assuming the apv given to \ref ltc_decoder_create is for 25fps), and
+ * the strongest match above the threshold is locked on to.
+ *
+ * A clean match sets the bit timing, period and levels of the normal
+ * decoder, which then takes over. A weaker one puts the decoder in
+ * soft-decision mode: bits are taken from the soft decisions one bit period
+ * apart, with the timing nudged towards the strongest decision, and frames
+ * are queued from them as usual. It hands over to the normal decoder once
+ * the average strength of the decisions shows the signal is clean enough,
+ * and goes back to searching if no frame is decoded for two frames' worth of
+ * bits. This locks faster and more reliably on weak or heavily filtered LTC.
+ *
+ * Once the normal decoder is producing frames the search does not run and
+ * the per-sample cost is unchanged.
+ *
+ * A candidate frame rate is only searched if half a bit is at least one
+ * sample and its sync word fits in the search history, which covers the
+ * usual sample rates up to 384kHz.
+ *
+ * @param d decoder handle
+ * @param enable 1 to enable, 0 to disable (default)
+ * @return 0 on success, -1 if enable was asked for but the apv the decoder
+ * was created with leaves no frame rate that can be searched; the search then
+ * stays disabled
+ */
+int ltc_decoder_set_acquisition(LTCDecoder* d, int enable);
+
+/**
+ * Number of times the correlation based search has found a sync word and
+ * handed over to the decoder.
+ * @param d decoder handle
+ * @return number of hand-overs since the decoder was created
+ */
+unsigned long long ltc_decoder_acquisition_locks(LTCDecoder* d);
+
 
 
 /**
@@ -694,11 +804,14 @@ int ltc_encoder_set_bufsize(LTCEncoder *e, double sample_rate, double fps);
  * typically LTC is sent at 0dBu ; in EBU callibrated systems that
  * corresponds to -18dBFS. - by default libltc creates -3dBFS
  *
- * since libltc generated 8bit audio-data, the minimum dBFS
- * is about -42dB which corresponds to 1 bit.
+ * 8bit audio-data bottoms out at about -42dB which corresponds to 1 bit;
+ * quieter levels are rejected and leave the volume as it was. The float and
+ * s16 output of \ref ltc_encoder_encode_frame_float and
+ * \ref ltc_encoder_encode_frame_s16 is rendered at exactly the given level.
  *
  * 0dB corresponds to a signal range of 127
- * 1..255 with 128 at the center.
+ * 1..255 with 128 at the center for 8 bit, +-1.0 for float and
+ * +-32767 for s16.
  *
  * @param e encoder handle
  * @param dBFS the volume in dB full-scale (<= 0.0)
@@ -763,6 +876,100 @@ int ltc_encoder_encode_byte(LTCEncoder *e, int byte, double speed);
  */
 void ltc_encoder_encode_frame(LTCEncoder *e);
 
+/**
+ * Encode a full LTC frame at fixed speed as 32 bit float samples straight
+ * into the caller's buffer, e.g. an output callback's, without going through
+ * the internal 8 bit buffer or its quantisation. The biphase state is shared
+ * with \ref ltc_encoder_encode_frame so the two can be mixed.
+ *
+ * The level is the one given to \ref ltc_encoder_set_volume, the rise time
+ * the one given to \ref ltc_encoder_set_filter.
+ *
+ * There is no size parameter: the frame is written as if into the encoder's
+ * own buffer, so buf must hold \ref ltc_encoder_get_buffersize samples times
+ * the stride. Nothing written goes past that.
+ *
+ * @param e encoder handle
+ * @param buf where to write the samples, at least
+ * ltc_encoder_get_buffersize(e) * stride of them
+ * @param stride distance between samples in buf: 1 for a mono buffer, the
+ * channel count to write one channel of an interleaved one
+ * @return the number of samples written, -1 if buf is NULL, stride is less
+ * than 1 or the frame does not fit in \ref ltc_encoder_get_buffersize samples
+ * (in which case what was written of it is incomplete)
+ */
+int ltc_encoder_encode_frame_float(LTCEncoder *e, float *buf, int stride);
+
+/**
+ * Encode a full LTC frame at fixed speed as signed 16 bit samples straight
+ * into the caller's buffer. See \ref ltc_encoder_encode_frame_float
+ *
+ * @param e encoder handle
+ * @param buf where to write the samples, at least
+ * ltc_encoder_get_buffersize(e) * stride of them
+ * @param stride distance between samples in buf
+ * @return the number of samples written, -1 if buf is NULL, stride is less
+ * than 1 or the frame does not fit in \ref ltc_encoder_get_buffersize samples
+ */
+int ltc_encoder_encode_frame_s16(LTCEncoder *e, short *buf, int stride);
+
+/**
+ * Render a run of consecutive LTC frames as float samples into one
+ * contiguous span, for generating long test signals in one call.
+ *
+ * The frames count up from the start timecode, with drop-frame, parity and
+ * (with LTC_USE_DATE) the date at midnight handled as \ref ltc_frame_increment
+ * does. Sample rate, fps, standard, flags, level and rise time come from the
+ * encoder. The encoder's own frame, buffer and biphase state are not touched:
+ * each render starts from a reset state.
+ *
+ * The sample position of every bit is worked out from its absolute position in
+ * the render rather than accumulated, so a long render can be split into
+ * segments that are rendered independently - concurrently from several threads
+ * on the same encoder - and placed end to end with
+ * \ref ltc_encoder_render_offset. The result is the same as rendering it in
+ * one go.
+ *
+ * The timecode and date of a segment's first frame are worked out from its
+ * number, so where a segment starts costs nothing. The exceptions are
+ * LTC_NO_PARITY, where the biphase state depends on every frame before it,
+ * and a start timecode that is out of range (hours over 23, a frame number of
+ * fps or more): then the encoder counts through all first frames before the
+ * segment, which is O(first).
+ *
+ * @param e encoder handle, only read from
+ * @param start timecode (and date) of frame 0 of the whole render
+ * @param first the first frame of this segment, counting from start
+ * @param count number of frames in this segment
+ * @param buf where to write the segment: needs room for
+ * ltc_encoder_render_offset(e, first+count) - ltc_encoder_render_offset(e, first) samples
+ * @return the number of samples written, -1 if a parameter is invalid
+ */
+long long ltc_encoder_render_float(LTCEncoder *e, SMPTETimecode *start, long long first, long long count, float *buf);
+
+/**
+ * Render a run of consecutive LTC frames as s16 samples into one contiguous
+ * span. See \ref ltc_encoder_render_float
+ *
+ * @param e encoder handle, only read from
+ * @param start timecode (and date) of frame 0 of the whole render
+ * @param first the first frame of this segment, counting from start
+ * @param count number of frames in this segment
+ * @param buf where to write the segment
+ * @return the number of samples written, -1 if a parameter is invalid
+ */
+long long ltc_encoder_render_s16(LTCEncoder *e, SMPTETimecode *start, long long first, long long count, short *buf);
+
+/**
+ * Where a frame starts in a bulk render, in samples from the start of frame 0.
+ * See \ref ltc_encoder_render_float
+ *
+ * @param e encoder handle
+ * @param frame frame number counting from the start of the render
+ * @return sample offset
+ */
+long long ltc_encoder_render_offset(LTCEncoder *e, long long frame);
+
 /**
  * Set the parity of the LTC frame.
  *
@@ -1,20 +1,42 @@
 #pragma once
 #include "ltc.h"
-#include "audioinput.h"
+#include "audiosource.h"
+#include "framevalidator.h"
 #include <string>
+#include <functional>
 
 class LtcDecoder
 {
     public:
-        LtcDecoder();
+        /** nSampleRate is the rate of the audio passed to DecodeLtc, which every sample position is turned in to time with. With bBackPressure a full
+        *   queue holds the rest of the block back until it has been read rather than losing frames, which only suits audio that can wait, e.g. a file
+        **/
+        explicit LtcDecoder(unsigned long nSampleRate, int nQueueSize=QUEUE_SIZE, bool bBackPressure=false);
         ~LtcDecoder();
-        std::pair<bool, std::chrono::microseconds> DecodeLtc(const timedframe& buffer);
 
-        const std::chrono::time_point<std::chrono::system_clock>& GetTime() { return m_tp;}
+        /** Called for each frame that is decoded, with its offset from the capture time. The getters describe that frame for the duration of the call **/
+        using frameCallback = std::function<void(std::chrono::microseconds)>;
+
+        /** Decodes a block, which may hold several frames when the blocks are long, calling onFrame for every one that passes validation in the
+        *   order they were captured. Returns how many there were
+        **/
+        size_t DecodeLtc(const timedframe& buffer, const frameCallback& onFrame);
+
+        const std::chrono::time_point<std::chrono::system_clock>& GetTime() const { return m_tp;}
+
+        /** The most recently decoded frame and where it started and ended in the decoder's sample timeline **/
+        const LTCFrame& GetFrame() const { return m_Frame;}
+        ltc_off_t GetFrameStartSample() const { return m_nFrameStartSample;}
+        ltc_off_t GetFrameEndSample() const { return m_nFrameEndSample;}
 
         const std::string& GetFrameStart() const;
         const std::string& GetFrameEnd() const;
+
+        /** When the last bit of the most recently decoded frame was captured **/
+        const std::chrono::time_point<std::chrono::system_clock>& GetFrameEndTime() const { return m_tpFrameEnd;}
         const std::string& GetAmplitude() const;
+        double GetVolume() const { return m_dVolume;}      //dBFS of the signal that carried the last frame
+        double GetEdgeJitter() const { return m_dEdgeJitter;}  //RMS variation, in samples, of the bit period the decoder tracked over the last frame
         const std::string& GetRaw() const;
         double GetFPS() const;
         const std::string& GetMode() const;
@@ -25,11 +47,30 @@ class LtcDecoder
 
         void SetDateMode(int nMode);
 
+        unsigned long long GetOverflowCount() const;
+        int GetQueueSize() const { return m_nQueueSize;}
+
+        unsigned long long GetRejectedCount() const { return m_validator.GetRejectedCount();}
+        unsigned long long GetCorrectedCount() const { return m_validator.GetCorrectedCount();}
+
+        /** Call before decoding a block that follows lost samples. Throws away anything partly decoded so audio either side of the gap
+        *   isn't stitched together, and moves the sample timeline on by the number of samples lost
+        **/
+        void Discontinuity(unsigned long nLost);
+
+        /** Turns the correlation based sync word search on or off. Returns false if it can't run at this sample rate **/
+        bool SetCorrelationLock(bool bEnable);
+        unsigned long long GetCorrelationLockCount() const;
+
         enum {UNKNOWN, SMPTE, BBC, TVE, MTD};
 
+        static const int QUEUE_SIZE = 32;
+
     private:
 
         void CreateRaw();
+        size_t ReadFrames(const timedframe& frame, const frameCallback& onFrame);
+        double EdgeJitter(const LTCFrameExt& ext) const;
 
         int WorkoutUserMode();
         std::chrono::microseconds DecodeDateAndTime(int nUserMode, std::chrono::time_point<std::chrono::system_clock> tp, ltc_off_t startSample);
@@ -40,8 +81,12 @@ class LtcDecoder
         void ltc_frame_to_time_mtd(SMPTETimecode& stime);
         void ltc_frame_to_time_only(SMPTETimecode& stime);
 
+        double m_dSampleRate;
         LTCDecoder* m_pDecoder;
-        LTCFrameExt m_Frame;
+        int m_nQueueSize;
+        bool m_bBackPressure;
+        LTCFrame m_Frame;
+        FrameValidator m_validator;
         std::string m_sDate;
         std::string m_sTime;
         std::string m_sFrameStart;
@@ -55,7 +100,12 @@ class LtcDecoder
 
 
 
+        std::chrono::time_point<std::chrono::system_clock> m_tpFrameEnd;
         ltc_off_t m_nTotal;
+        ltc_off_t m_nFrameStartSample;
+        ltc_off_t m_nFrameEndSample;
+        double m_dVolume;
+        double m_dEdgeJitter;
         unsigned char m_nFPS;
         unsigned char m_nLastFrame;
         unsigned char m_nLastFPS;
@@ -64,7 +114,7 @@ class LtcDecoder
 
         std::chrono::time_point<std::chrono::system_clock> m_tp;
 
-        static const int APV = 1920;
+        static const int INITIAL_FPS = 25;  //the decoder starts out expecting frames at this rate and then tracks the real one
 
         static const std::string STR_MODE[4];
         static const std::string STR_DATE_MODE[5];
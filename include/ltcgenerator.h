@@ -0,0 +1,84 @@
+#pragma once
+#include "portaudio.h"
+#include "ltc.h"
+#include "stagestats.h"
+#include "timecodeindex.h"
+#include "utils.h"
+#include <atomic>
+#include <vector>
+
+/** Generates LTC from the system clock on a PortAudio output stream, so a machine disciplined by PTP or NTP can act as a timecode master.
+*   Frame edges are phase-aligned to the system clock's second boundaries (local time, as the decoder expects): the DAC time of every
+*   callback is compared with where the stream says it is and the difference is pulled in a sample at a time, or the stream is resynced if it
+*   is more than half a frame out. The date goes in the user bits in any of the formats the decoder understands
+**/
+class LtcGenerator
+{
+    public:
+        /** dFPS is 24, 25, 29.97 (drop frame) or 30. nDateMode is one of LtcDecoder's SMPTE, BBC, TVE or MTD **/
+        LtcGenerator(unsigned long nDevice, unsigned long nSampleRate, unsigned char nChannels, double dFPS, int nDateMode);
+        ~LtcGenerator();
+
+        /** Must be called before Init **/
+        void SetVolume(double dBFS) { m_dVolume = dBFS;}
+        void SetThreadConfig(const threadconfig& config) { m_config = config;}
+
+        bool Init();
+
+        void Callback(float* pBuffer, size_t nFrameCount, const PaStreamCallbackTimeInfo* pTimeInfo, int nFlags);
+
+        /** Works out the offset of local time from UTC, which is not safe to do in the callback. Called periodically from the main thread **/
+        void Service();
+
+        /** Logs the alignment error (where the frame edges come out of the DAC relative to the system clock) and corrections since the last call **/
+        void LogMetrics();
+
+        double GetAlignmentErrorUs() const { return m_dErrorUs.load(std::memory_order_relaxed);}
+
+        static const double DEFAULT_VOLUME;
+
+    private:
+        void CloseStream();
+
+        void Resync(long long nDacNs);
+        void RenderFrame();
+        void SetFrameTime(long long nFrameNs);
+
+        long long FrameStartNs(long long nDayNs, long long nFrame) const;
+        long long FrameAt(long long nTodNs) const;
+
+        unsigned long m_nDevice;
+        unsigned long m_nSampleRate;
+        unsigned char m_nChannels;
+        int m_nDateMode;
+        double m_dVolume;
+        threadconfig m_config;
+        bool m_bThreadConfigured;
+
+        //the frame rate as a fraction: 30000/1001 for 29.97
+        long long m_nRateNum;
+        long long m_nRateDen;
+        int m_nFPS;         //frames per timecode second
+        bool m_bDropFrame;
+        LTC_TV_STANDARD m_eStandard;
+        TimecodeIndex m_index;
+
+        LTCEncoder* m_pEncoder;
+        bool m_bPaInitialized;
+        PaStream* m_pStream;
+
+        std::vector<float> m_vFrame;    //the frame being played out
+        size_t m_nFramePos;             //next sample of it to go out
+        long long m_nDayNs;             //local midnight of the frame's day, ns since the epoch
+        long long m_nFrame;             //frame number within the day
+        bool m_bSynced;
+        std::atomic<long long> m_nLocalOffsetNs;
+
+        double m_dErrorNs;              //smoothed alignment error
+        std::atomic<double> m_dErrorUs;
+        stagestats m_error;             //absolute alignment error of each callback
+        std::atomic<unsigned long long> m_nResyncs;
+        std::atomic<unsigned long long> m_nCorrections;
+        std::atomic<unsigned long long> m_nUnderflows;
+        std::atomic<unsigned long long> m_nEncodeFailures;  //frames that went out as silence because libltc could not encode them
+};
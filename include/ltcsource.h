@@ -0,0 +1,169 @@
+#pragma once
+#include "audioinput.h"
+#include "alsainput.h"
+#include "ltcdecoder.h"
+#include "spscqueue.h"
+#include "stagestats.h"
+#include "utils.h"
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <string>
+
+/** What the decode stage passes on to the estimate stage for each LTC frame **/
+struct decodedframe
+{
+    std::chrono::microseconds offset{0};
+    double dFPS = 0.0;
+    std::chrono::steady_clock::time_point tpCaptured;   //when the audio block holding the frame was queued by the capture stage
+    std::chrono::system_clock::time_point tpFrameEnd;   //when the last bit of the frame was captured
+
+    //kept for the event recorder
+    std::chrono::system_clock::time_point tpLtc;        //the time the frame says
+    long long nFrameStart = 0;
+    long long nFrameEnd = 0;
+    LTCFrame frame;
+    float fVolume = 0.0f;
+    double dEdgeJitter = 0.0;       //seconds
+    unsigned long long nRejected = 0;
+    bool bDiscontinuity = false;    //samples were lost since the previous frame was passed on
+};
+
+/** One LTC reference: a channel of an audio device with its own capture stage, decoder and decode thread.
+*   The decode thread keeps a smoothed offset and jitter of every source for the source selector, but only queues frames for the estimate
+*   stage while its source is active (the one being followed or, when combining, one of those being combined), so the sources that are not
+*   in use cost the active one nothing
+**/
+class LtcSource
+{
+    public:
+        /** Where the audio comes from. PORTAUDIO: sDevice is the PortAudio device index. ALSA: sDevice is an ALSA device name such as "hw:0"
+        *   or "file:<path>" to read a WAV file in place of a device
+        **/
+        enum enumBackend {PORTAUDIO, ALSA};
+
+        /** How the decode stage waits for audio. WAKE_NOTIFY: the capture callback wakes it whenever the queue reaches the watermark.
+        *   WAKE_DEADLINE: it sleeps until the next block is due and drains everything that has arrived, the callback only waking it if it falls
+        *   a watermark's worth of blocks behind
+        **/
+        enum enumWakeup {WAKE_NOTIFY, WAKE_DEADLINE};
+
+        /** nChannel is the channel of the device that carries the LTC. At least nChannel+1 channels are opened. nDecoderQueue is the number of
+        *   frames libltc can hold between DecodeLtc calls
+        **/
+        LtcSource(enumBackend eBackend, const std::string& sDevice, unsigned char nChannel, unsigned long nSampleRate, unsigned char nChannels,
+                  int nDecoderQueue=LtcDecoder::QUEUE_SIZE);
+        ~LtcSource();
+
+        /** Must be called before Start **/
+        void SetDecodeWakeup(enumWakeup eWakeup, size_t nWatermark, long long nSlackUs);
+        void SetCaptureBuffer(unsigned long nFrames, double dLatency);
+
+        /** Pre-faults the block pool, starts the decode thread and opens the device. Returns false, with everything stopped again, if the device
+        *   can't be opened
+        **/
+        bool Start(const threadconfig& capture, const threadconfig& decode);
+        void Stop();
+
+        /** Reopens the capture stream if it needs to. Called periodically from the main thread **/
+        void Service();
+
+        /** Has the decode thread throw away anything partly decoded and find the LTC again, passing the next frame on as a discontinuity **/
+        void Relock() { m_bRelock.store(true, std::memory_order_release);}
+
+        /** Whether decoded frames are queued for the estimate stage **/
+        void SetActive(bool bActive) { m_bActive.store(bActive, std::memory_order_release);}
+        bool IsActive() const { return m_bActive.load(std::memory_order_acquire);}
+
+        /** Frames for the estimate stage. Only the estimate thread may pop them **/
+        SpscQueue<decodedframe>& GetDecoded() { return m_qDecoded;}
+        const SpscQueue<decodedframe>& GetDecoded() const { return m_qDecoded;}
+        const SpscQueue<audioblock>& GetCapture() const { return m_qCapture;}
+
+        /** device@channel, as used in the logs and metric labels **/
+        const std::string& GetName() const { return m_sName;}
+        bool IsRunning() const { return m_pInput != nullptr;}
+
+        /** Steady clock time the block holding the last decoded frame was queued, the offset smoothed over the last few frames and the RMS
+        *   difference of each frame's offset from that, all in seconds. Zero if no frame has been decoded since the last discontinuity
+        **/
+        std::chrono::steady_clock::time_point GetLastFrameTime() const;
+        double GetOffset() const { return m_dOffset.load(std::memory_order_relaxed);}
+        double GetJitter() const { return m_dJitter.load(std::memory_order_relaxed);}
+
+        /** Logs anything the decode thread has noticed since the last call, so the decode thread itself never has to log **/
+        void LogEvents();
+
+        const AudioSource* GetInput() const { return m_pInput.get();}
+        AudioSource* GetInput() { return m_pInput.get();}
+        stagestats& GetStats() { return m_stats;}
+        const stagestats& GetStats() const { return m_stats;}
+        stagestats& GetWakeupStats() { return m_wakeup;}
+
+        unsigned long long GetFramesDecoded() const { return m_nFramesDecoded.load(std::memory_order_relaxed);}
+        unsigned long long GetDecoderOverflows() const { return m_nDecoderOverflows.load(std::memory_order_relaxed);}
+        unsigned long long GetDiscontinuities() const { return m_nDiscontinuities.load(std::memory_order_relaxed);}
+        unsigned long long GetRejected() const { return m_nRejected.load(std::memory_order_relaxed);}
+        unsigned long long GetCorrected() const { return m_nCorrected.load(std::memory_order_relaxed);}
+        double GetVolume() const { return m_dVolume.load(std::memory_order_relaxed);}
+
+        static const size_t CAPTURE_QUEUE_SIZE = 64;
+        static const size_t DECODE_QUEUE_SIZE = 256;
+        static const size_t CAPTURE_WATERMARK = 2;
+        static const long long DEADLINE_SLACK_US = 200;
+        static const size_t POOL_SIZE = CAPTURE_QUEUE_SIZE+8;
+
+    private:
+        void DecodeThread();
+        void FillPool();
+        void TrackOffset(double dOffset, bool bRestart);
+
+        enumBackend m_eBackend;
+        std::string m_sDevice;
+        unsigned char m_nChannel;
+        unsigned long m_nSampleRate;
+        unsigned char m_nChannels;
+        std::string m_sName;
+
+        SpscQueue<audioblock> m_qCapture;
+        SpscQueue<decodedframe> m_qDecoded;
+        SpscQueue<aframe> m_qPool;     //empty block buffers, handed to the capture stage and given back by the decode thread
+
+        std::unique_ptr<AudioSource> m_pInput;
+        LtcDecoder m_ltc;
+
+        threadconfig m_config;
+        enumWakeup m_eWakeup;
+        long long m_nSlackUs;
+        unsigned long m_nCaptureFrames;
+        double m_dCaptureLatency;
+        stagestats m_stats;
+        stagestats m_wakeup;
+
+        std::thread m_thDecode;
+        std::atomic<bool> m_bRun;
+        std::atomic<bool> m_bActive;
+        std::atomic<bool> m_bRelock;
+
+        //only touched by the decode thread
+        double m_dSmoothed;
+        double m_dJitterSq;
+        double m_dLastFPS;
+
+        //written by the decode thread, read by the selector, LogEvents and the metrics
+        std::atomic<long long> m_nLastFrameNs;
+        std::atomic<double> m_dOffset;
+        std::atomic<double> m_dJitter;
+        std::atomic<unsigned long long> m_nFramesDecoded;
+        std::atomic<unsigned long long> m_nDecoderOverflows;
+        std::atomic<unsigned long long> m_nCorrelationLocks;
+        std::atomic<unsigned long long> m_nDiscontinuities;
+        std::atomic<unsigned long long> m_nRejected;
+        std::atomic<unsigned long long> m_nCorrected;
+        std::atomic<double> m_dVolume;
+
+        unsigned long long m_nLastFramesDecoded;
+        unsigned long long m_nLastDecoderOverflows;
+        unsigned long long m_nLastCorrelationLocks;
+        unsigned long long m_nLastDiscontinuities;
+};
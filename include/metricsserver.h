@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <atomic>
+
+class Pipeline;
+
+/** Serves the pipeline's metrics in the Prometheus text format over HTTP on a local socket.
+*   The pipeline only updates atomics; all the formatting is done here on the server's own thread, which runs at normal priority
+**/
+class MetricsServer
+{
+    public:
+        explicit MetricsServer(const Pipeline& pipeline);
+        ~MetricsServer();
+
+        /** sEndpoint is either "unix:<path>" for a Unix socket or a TCP port number, which is bound to localhost only **/
+        bool Start(const std::string& sEndpoint);
+        void Stop();
+
+        static const std::string UNIX_PREFIX;
+
+    private:
+        int Listen(const std::string& sEndpoint);
+        void ServerThread();
+        void Serve(int nClient);
+
+        const Pipeline& m_pipeline;
+        int m_nListen;
+        std::string m_sUnixPath;
+        std::thread m_thServer;
+        std::atomic<bool> m_bRun;
+};
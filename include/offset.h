@@ -1,27 +1,52 @@
 #pragma once
 #include <chrono>
 #include <list>
+#include "clockcontrol.h"
+
+/** The servo's tunables **/
+struct servoconfig
+{
+    size_t nWindow = 500;           //frames in each regression
+    double dStepThreshold = 0.5;    //seconds. A larger average offset steps the clock rather than slewing it
+    double dSlewPPM = 0.8;          //the offset is only corrected once the frequency error is within this. Until then only the frequency is
+    double dSyncPPM = 1.0;          //synced once the frequency error is within this...
+    double dSyncIntercept = 1e-4;   //...and the regression's intercept within this many seconds
+};
 
 class Offset
 {
     public:
-        Offset();
-        std::pair<bool, double> Add(std::chrono::microseconds offset, unsigned char nFrame, double dFPS);
+        /** clock is only asked whether a slew is still running **/
+        explicit Offset(const ClockControl& clock);
+        clockcommand Add(std::chrono::microseconds offset, unsigned char nFrame, double dFPS);
         void ClearData();
 
+        /** Takes effect from the next measurement. A shorter window ends the one being collected as soon as it has enough frames **/
+        void SetConfig(const servoconfig& config) { m_config = config;}
+        const servoconfig& GetConfig() const { return m_config;}
+
+        /** Samples were lost. Throws away the measurements collected so far so no regression straddles the gap **/
+        void Discontinuity();
+
+        /** Starts again as if no LTC had been seen: the frame rate is learnt afresh and the clock is not synced until a regression says so **/
+        void Reset();
+
         bool IsSynced() const { return m_bSynced;}
 
+        /** Frequency error from the last regression, in ppm **/
+        double GetPPM() const { return m_dPPM;}
+
     private:
-        void WorkoutLR();
+        clockcommand WorkoutLR();
         double GetAverage();
 
-        void CrashTime(double dOffset);
-
+        const ClockControl& m_clock;
         std::list<double> m_lstOffset;
         std::list<double> m_lstFrame;
 
-
+        servoconfig m_config;
         double m_dFPS;
+        double m_dPPM;
         size_t m_nFrame;
 
         bool m_bSlewing;
@@ -0,0 +1,75 @@
+#pragma once
+#include "ltcsource.h"
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+/** Combines the offsets several sources measure for the same LTC frame in to one, for sources that share a generator.
+*   Each source's offset is already on the common timeline (LTC time less the system clock time its frame started), so frames are paired up
+*   by the LTC time they carry. The offsets are averaged weighted by the inverse of each frame's expected timing variance, worked out from
+*   its edge jitter and its level: the noise floor is taken to be the same on every input so the level stands in for the SNR, and an edge's
+*   timing error under noise is its rise time over twice the SNR.
+*   A frame time is passed on once every participating source has given it or once it is MAX_WAIT frames behind the newest, so a source
+*   that has gone quiet holds things up by at most that much. Only used by the estimate thread, apart from the contribution figures
+**/
+class OffsetCombiner
+{
+    public:
+        explicit OffsetCombiner(size_t nSources);
+
+        /** Adds a frame from source nSource. nParticipants is a mask of the sources that are expected to give every frame **/
+        void Add(size_t nSource, const decodedframe& frame, std::chrono::steady_clock::time_point tpQueued, uint64_t nParticipants);
+
+        /** Takes the oldest frame time that is complete. The combined frame is a copy of the first one to arrive with the weighted offset in place
+        *   of its own. Returns false if none is
+        **/
+        bool Next(decodedframe& combined, std::chrono::steady_clock::time_point& tpQueued);
+
+        /** Throws away everything partly combined, e.g. when the LTC jumps back **/
+        void Reset();
+
+        /** Each source's share of the total weight, smoothed over the last few frames, and how many combined frames it has been part of **/
+        double GetShare(size_t nSource) const;
+        unsigned long long GetContributions(size_t nSource) const;
+
+        /** RMS difference of the source's offset from the combined offset, seconds **/
+        double GetResidual(size_t nSource) const;
+
+        static const size_t SLOTS = 8;
+        static const long long MAX_WAIT = 2;
+        static const double NOISE_FLOOR_DBFS;
+        static const double EDGE_RISE_TIME;
+        static const double MIN_DEVIATION;
+
+    private:
+        struct slot
+        {
+            bool bUsed = false;
+            long long nLtcNs = 0;
+            decodedframe frame;
+            std::chrono::steady_clock::time_point tpQueued;
+            uint64_t nParticipants = 0;
+            uint64_t nHave = 0;
+            std::vector<double> vOffset;
+            std::vector<double> vWeight;
+        };
+
+        struct contribution
+        {
+            std::atomic<double> dShare{0.0};
+            std::atomic<double> dResidualSq{0.0};
+            std::atomic<unsigned long long> nCount{0};
+        };
+
+        double Weight(const decodedframe& frame) const;
+        void Combine(slot& s, decodedframe& combined);
+
+        size_t m_nSources;
+        std::vector<slot> m_vSlots;
+        long long m_nNewestNs;
+        long long m_nFrameNs;   //length of a frame at the current rate
+        long long m_nEmittedNs; //the last frame time passed on
+
+        std::unique_ptr<contribution[]> m_pContribution;
+};
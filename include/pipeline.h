@@ -0,0 +1,225 @@
+#pragma once
+#include "ltcsource.h"
+#include "sourceselector.h"
+#include "offsetcombiner.h"
+#include "offset.h"
+#include "clockcontrol.h"
+#include "spscqueue.h"
+#include "stagestats.h"
+#include "utils.h"
+#include "eventrecorder.h"
+#include "seqlock.h"
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <ostream>
+
+/** What the estimate stage last made of the LTC. Published by the estimate thread with a seqlock so it can be read from anywhere without holding
+*   the pipeline up
+**/
+struct pipelinestate
+{
+    unsigned long long nFrames = 0;     //frames estimated since starting
+    long long nLtcNs = 0;               //the time the last frame said, as system clock ns since the epoch
+    long long nQueuedNs = 0;            //steady clock time the audio block holding it was queued
+    LTCFrame frame;                     //as decoded, for its timecode
+    double dFPS = 0.0;
+    double dOffset = 0.0;               //seconds
+    double dPPM = 0.0;
+    float fVolume = 0.0f;
+    uint8_t nSource = 0;                //the active source
+    bool bSynced = false;
+    bool bCombined = false;
+    bool bPaused = false;               //the servo's commands were not carried out, so bSynced is only what it would have been
+};
+
+/** Runs the client as four stages, each on its own thread and joined by bounded lock-free queues:
+*   capture (the PortAudio callback) -> decode (LtcDecoder) -> estimate (Offset) -> clock control (ClockControl).
+*   A slow system call or log write in a later stage can no longer hold up decoding.
+*   There can be several LTC sources, each with its own capture and decode stages. All of them are decoded all the time but only the active
+*   one's frames go on to the estimate stage. The SourceSelector picks the active source from the main thread and fails over to another when
+*   it is lost or disagrees with the majority, so selection adds nothing to the active source's path.
+*   Sources that share a generator can instead be combined: every truechimer's frames go to the estimate stage and the OffsetCombiner turns
+*   each frame time in to one weighted measurement, at the cost of waiting up to OffsetCombiner::MAX_WAIT frames for a source that goes quiet
+**/
+class Pipeline
+{
+    public:
+        enum enumStage {CAPTURE, DECODE, ESTIMATE, CLOCK, STAGES};
+
+        /** nDecoderQueue is the number of frames each source's decoder can hold between blocks **/
+        Pipeline(unsigned long nSampleRate, unsigned char nChannels, int nDecoderQueue=LtcDecoder::QUEUE_SIZE);
+        ~Pipeline();
+
+        /** Adds an LTC source on channel nChannel of a device. The first source added starts off as the active one. Must be called before Start **/
+        void AddSource(LtcSource::enumBackend eBackend, const std::string& sDevice, unsigned char nChannel=0);
+
+        /** The disagreement in seconds allowed between sources before one is called a falseticker. The selector runs in Service, so once started
+        *   this must be called from the same thread
+        **/
+        void SetSelectTolerance(double dTolerance) { m_selector.SetTolerance(dTolerance);}
+
+        /** Combine the offsets of all the sources that agree rather than only using the active one. Must be called before Start **/
+        void SetCombine(bool bCombine) { m_bCombine = bCombine;}
+
+        /** The servo's tunables. May be called at any time from one thread: once started they are handed to the estimate thread, which
+        *   takes them up before the next frame
+        **/
+        void SetServo(const servoconfig& config);
+
+        /** Must be called before Start **/
+        void SetStageConfig(enumStage eStage, const threadconfig& config);
+
+        /** Must be called before Start **/
+        void SetDecodeWakeup(LtcSource::enumWakeup eWakeup, size_t nWatermark, long long nSlackUs=LtcSource::DEADLINE_SLACK_US);
+
+        /** Capture buffer size in frames (AudioSource::BUFFER_AUTO to auto-tune) and suggested latency in seconds (0 for the device default).
+        *   Must be called before Start
+        **/
+        void SetCaptureBuffer(unsigned long nFrames, double dLatency);
+
+        /** Lock memory, pre-fault the block pool and run every stage under SCHED_FIFO. Stages given no priority with SetStageConfig get the defaults
+        *   below. Must be called before Start
+        **/
+        void SetRealtime(bool bRealtime) { m_bRealtime = bRealtime;}
+
+        /** Record every decoded frame, and what the servo made of it, in a ring file at sPath. Must be called before Start **/
+        void SetRecorder(const std::string& sPath, uint64_t nCapacity=EventRecorder::DEFAULT_CAPACITY) { m_sRecorderPath = sPath; m_nRecorderCapacity = nCapacity;}
+
+        bool Start();
+        void Stop();
+
+        /** Work that must not be done on the audio or pipeline threads, e.g. reopening a capture stream or choosing the active source.
+        *   Called periodically from the main thread
+        **/
+        void Service();
+
+        /** Logs the latency (time from an item being queued for a stage to the stage finishing with it), the worst wakeup latency (time from an item
+        *   being queued to the stage starting on it) and the depth of the queue in to each stage.
+        *   Called periodically from the main thread
+        **/
+        void LogMetrics();
+
+        /** Writes every metric in the Prometheus text format. Only reads atomics so is safe to call from any thread, but must not be called once Stop
+        *   has been
+        **/
+        void WriteMetrics(std::ostream& os) const;
+
+        /** Logs anything the decode stages have noticed since the last call, so the decode threads themselves never have to log **/
+        void LogDecoderEvents();
+
+        /** The source the clock is following **/
+        size_t GetActiveSource() const { return m_nActive.load(std::memory_order_acquire);}
+
+        /** What the estimate stage last published, and whether the active source has given it a frame recently. Safe to call from any thread **/
+        pipelinestate GetState() const { return m_state.Read();}
+        bool IsLocked() const;
+
+        size_t GetSourceCount() const { return m_vSources.size();}
+        const LtcSource& GetSource(size_t nSource) const { return *m_vSources[nSource];}
+
+        /** What the selector last made of the source. Safe to call from any thread **/
+        SourceSelector::enumState GetSourceState(size_t nSource) const;
+
+        /** Follows nSource for as long as it is decoding, whatever the selector makes of it, or goes back to the selector's choice given NO_SOURCE.
+        *   Safe to call from any thread: the switch is made by the next Service. Returns false if there is no such source
+        **/
+        bool PinSource(size_t nSource);
+        size_t GetPinnedSource() const { return m_nPinned.load(std::memory_order_acquire);}
+
+        /** Has every decoder find the LTC again and the servo start over as if it had never been locked. Safe to call from any thread **/
+        void Relock();
+
+        /** While paused the servo carries on measuring but none of its commands are carried out. It carries on as if they had been, so its
+        *   frequency, slewing and sync state only say what it would have done, and it is reset when discipline resumes so it starts again
+        *   from what the clock is really doing. Safe to call from any thread
+        **/
+        void PauseDiscipline(bool bPause) { m_bPaused.store(bPause, std::memory_order_release);}
+        bool IsDisciplinePaused() const { return m_bPaused.load(std::memory_order_acquire);}
+
+        static const size_t CLOCK_QUEUE_SIZE = 16;
+        static const size_t SERVO_QUEUE_SIZE = 4;
+        static const size_t MAX_SOURCES = 64;   //sources are kept track of in a 64 bit mask
+        static const size_t NO_SOURCE = static_cast<size_t>(-1);
+
+        static const int RT_PRIORITY_CAPTURE = 80;
+        static const int RT_PRIORITY_DECODE = 70;
+        static const int RT_PRIORITY_ESTIMATE = 60;
+        static const int RT_PRIORITY_CLOCK = 60;
+
+    private:
+        /** Kept by the estimate thread between frames **/
+        struct estimatestate
+        {
+            bool bSynced = false;
+            bool bAwaitStep = false;    //a step has been asked for and frames are thrown away until it has happened
+            bool bPaused = false;       //discipline was paused at the last frame
+            bool bFailover = false;     //the next frame is the first since the active source changed
+            unsigned long long nSteps = 0;
+            unsigned long long nFrames = 0;
+        };
+
+        void EstimateThread();
+        void Estimate(const decodedframe& decoded, std::chrono::steady_clock::time_point tpQueued, size_t nSource, unsigned char nFlags, estimatestate& state);
+        void ClockThread();
+
+        void ApplyRealtime();
+        void RecordFrame(const decodedframe& decoded, const clockcommand& command, unsigned char nFlags, size_t nSource);
+        void SelectSource();
+
+        void LogStage(const std::string& sName, stagestats& stats, stagestats* pWakeup);
+        template<typename T> void LogQueue(const std::string& sName, const SpscQueue<T>& queue);
+        template<typename F> void WriteSourceMetrics(std::ostream& os, const std::string& sMetric, const std::string& sType, const std::string& sHelp, F value) const;
+        template<typename T> void WriteQueueMetrics(std::ostream& os, const std::string& sStage, const std::string& sSource, const SpscQueue<T>& queue) const;
+        void WriteStageMetrics(std::ostream& os, const std::string& sStage, const std::string& sSource, const stagestats& stats) const;
+
+        unsigned long m_nSampleRate;
+        unsigned char m_nChannels;
+        int m_nDecoderQueue;
+
+        std::vector<std::unique_ptr<LtcSource>> m_vSources;
+        SourceSelector m_selector;  //only used by the main thread
+        std::atomic<size_t> m_nActive;
+        std::atomic<uint64_t> m_nParticipants;  //mask of the sources being combined
+        bool m_bCombine;
+        std::unique_ptr<OffsetCombiner> m_pCombiner;    //used by the estimate thread when combining
+        std::atomic<unsigned long long> m_nFailovers;
+        std::atomic<size_t> m_nPinned;
+        std::atomic<uint64_t> m_nTruechimers;   //masks of what the selector last made of each source
+        std::atomic<uint64_t> m_nFalsetickers;
+
+        std::atomic<bool> m_bRelock;
+        std::atomic<bool> m_bPaused;
+        SeqLock<pipelinestate> m_state;     //written by the estimate thread
+
+        SpscQueue<clockcommand> m_qClock;
+        SpscQueue<servoconfig> m_qServo;    //new tunables for the estimate thread
+
+        ClockControl m_clock;
+        Offset m_offset;    //reads m_clock so comes after it
+        EventRecorder m_recorder;   //written by the estimate thread
+        std::string m_sRecorderPath;
+        uint64_t m_nRecorderCapacity;
+
+        threadconfig m_config[STAGES];
+        LtcSource::enumWakeup m_eWakeup;
+        size_t m_nWatermark;
+        long long m_nSlackUs;
+        stagestats m_stats[STAGES];
+        stagestats m_wakeup[STAGES];
+        bool m_bRealtime;
+        unsigned long m_nCaptureFrames;
+        double m_dCaptureLatency;
+
+        std::thread m_thEstimate;
+        std::thread m_thClock;
+        std::atomic<bool> m_bRun;
+
+        //written by the estimate thread for the metrics
+        std::atomic<bool> m_bSynced;
+        std::atomic<double> m_dOffset;
+        std::atomic<double> m_dPPM;
+
+        static const std::string STR_STAGE[STAGES];
+};
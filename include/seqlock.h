@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/** Publishes a value from one writer thread to any number of readers without either ever blocking the other.
+*   The writer bumps the sequence to odd, copies the value in and bumps it back to even. A reader copies the value out and tries again if the
+*   sequence was odd or moved while it did, so a reader can spin for a moment while a write is under way but the writer never waits.
+*   The value is held as atomic words so the copy a reader throws away is not a data race
+**/
+template<typename T> class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a type that can be copied as bytes");
+
+    public:
+        SeqLock() : m_nSequence(0)
+        {
+            T value;
+            uint64_t words[WORDS] = {};
+            memcpy(words, &value, sizeof(T));
+            for(size_t i = 0; i < WORDS; i++)
+            {
+                m_data[i].store(words[i], std::memory_order_relaxed);
+            }
+        }
+
+        SeqLock(const SeqLock&) = delete;
+        SeqLock& operator=(const SeqLock&) = delete;
+
+        /** Writer only **/
+        void Write(const T& value)
+        {
+            uint64_t words[WORDS] = {};
+            memcpy(words, &value, sizeof(T));
+
+            unsigned long nSequence = m_nSequence.load(std::memory_order_relaxed);
+            m_nSequence.store(nSequence+1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for(size_t i = 0; i < WORDS; i++)
+            {
+                m_data[i].store(words[i], std::memory_order_relaxed);
+            }
+            m_nSequence.store(nSequence+2, std::memory_order_release);
+        }
+
+        T Read() const
+        {
+            uint64_t words[WORDS];
+            unsigned long nBefore;
+            unsigned long nAfter;
+            do
+            {
+                nBefore = m_nSequence.load(std::memory_order_acquire);
+                for(size_t i = 0; i < WORDS; i++)
+                {
+                    words[i] = m_data[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                nAfter = m_nSequence.load(std::memory_order_relaxed);
+            } while((nBefore & 1) || nBefore != nAfter);
+
+            T value;
+            memcpy(&value, words, sizeof(T));
+            return value;
+        }
+
+        /** Number of times the value has been written **/
+        unsigned long GetVersion() const { return m_nSequence.load(std::memory_order_acquire)/2;}
+
+    private:
+        static const size_t WORDS = (sizeof(T)+sizeof(uint64_t)-1)/sizeof(uint64_t);
+
+        std::atomic<unsigned long> m_nSequence;
+        std::atomic<uint64_t> m_data[WORDS];
+};
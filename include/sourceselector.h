@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <chrono>
+
+/** How a source looks to the selector at the moment **/
+struct sourcesample
+{
+    bool bValid = false;    //a frame has been decoded recently
+    double dOffset = 0.0;   //seconds
+    double dJitter = 0.0;   //seconds
+};
+
+/** Chooses which of several LTC sources the clock follows, in the way NTP's clock select does. Each valid source gives an interval of its offset
+*   plus or minus its distance (a multiple of its jitter, but never less than the tolerance allowed for differing cable and converter delays).
+*   The intersection that the most sources agree on is found by Marzullo's algorithm and sources whose interval misses it are falsetickers.
+*   The active source is kept for as long as it is valid and a truechimer, so the clock does not flap between sources that agree, otherwise the
+*   truechimer with the smallest distance takes over once it has been valid for HOLDOFF.
+*   With two sources that disagree there is no majority, so any source already found to be a falseticker stays one and the active one is kept
+*   while it is valid
+**/
+class SourceSelector
+{
+    public:
+        enum enumState {INVALID, TRUECHIMER, FALSETICKER};
+
+        SourceSelector();
+
+        /** Smallest distance any source is given, in seconds **/
+        void SetTolerance(double dTolerance) { m_dTolerance = dTolerance;}
+        double GetTolerance() const { return m_dTolerance;}
+
+        /** Works out which sources agree and returns the index of the one that should be active **/
+        size_t Select(const std::vector<sourcesample>& vSamples, size_t nActive, std::chrono::steady_clock::time_point tpNow);
+
+        enumState GetState(size_t nSource) const { return nSource < m_vState.size() ? m_vState[nSource] : INVALID;}
+        bool HasMajority() const { return m_bMajority;}
+
+        static const double DEFAULT_TOLERANCE;
+        static const double JITTER_FACTOR;
+        static const std::chrono::seconds HOLDOFF;
+        static const std::string STR_STATE[3];
+
+    private:
+        double Distance(const sourcesample& sample) const;
+        bool Intersect(const std::vector<sourcesample>& vSamples, double& dLow, double& dHigh) const;
+
+        double m_dTolerance;
+        bool m_bMajority;
+        std::vector<enumState> m_vState;
+        std::vector<std::chrono::steady_clock::time_point> m_vValidSince;
+};
@@ -0,0 +1,239 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/** Bounded queue between one producer thread and one consumer thread. Push and Pop never take a lock so the producer can be the audio callback.
+*   When the queue is full Push drops the new entry and counts it rather than blocking the producer.
+*   The time each entry was pushed is kept so the consumer can tell how long it sat in the queue.
+*
+*   The producer only makes a system call to wake the consumer when the consumer is asleep and the queue has reached the watermark.
+*   A consumer that knows entries arrive regularly can instead use WaitForNext to sleep until the next one is due, drain everything, and
+*   only be woken early if it has fallen a watermark's worth behind
+**/
+template<typename T> class SpscQueue
+{
+    public:
+        explicit SpscQueue(size_t nCapacity, size_t nWatermark=1) :
+            m_vSlots(nCapacity+1),  //one slot is always kept free to tell full from empty
+            m_nHead(0),
+            m_nTail(0),
+            m_nWatermark(std::min(std::max(nWatermark, static_cast<size_t>(1)), nCapacity)),
+            m_nWakeAt(1),
+            m_nFutex(0),
+            m_bSleeping(false),
+            m_bWoken(false),
+            m_nLastPushNs(0),
+            m_nIntervalNs(0),
+            m_nHighWater(0),
+            m_nDropped(0),
+            m_nNotifies(0),
+            m_nWakeups(0)
+        {
+        }
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        /** Producer only **/
+        bool Push(T&& value)
+        {
+            size_t nTail = m_nTail.load(std::memory_order_relaxed);
+            size_t nNext = Next(nTail);
+            if(nNext == m_nHead.load(std::memory_order_acquire))
+            {
+                m_nDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            auto tpNow = std::chrono::steady_clock::now();
+            m_vSlots[nTail].value = std::move(value);
+            m_vSlots[nTail].tpQueued = tpNow;
+            m_nTail.store(nNext, std::memory_order_seq_cst);
+
+            TrackInterval(tpNow);
+
+            size_t nSize = Size();
+            if(nSize > m_nHighWater.load(std::memory_order_relaxed))
+            {
+                m_nHighWater.store(nSize, std::memory_order_relaxed);
+            }
+
+            //m_bSleeping first: the consumer sets m_nWakeAt before it, so only once we have seen it asleep is the depth it asked for the current one
+            if(m_bSleeping.load(std::memory_order_seq_cst) && nSize >= m_nWakeAt.load(std::memory_order_relaxed))
+            {
+                m_bSleeping.store(false, std::memory_order_relaxed);
+                m_nNotifies.fetch_add(1, std::memory_order_relaxed);
+                Signal();
+            }
+            return true;
+        }
+
+        /** Consumer only. Returns false if the queue is empty **/
+        bool Pop(T& value, std::chrono::steady_clock::time_point& tpQueued)
+        {
+            size_t nHead = m_nHead.load(std::memory_order_relaxed);
+            if(nHead == m_nTail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            value = std::move(m_vSlots[nHead].value);
+            tpQueued = m_vSlots[nHead].tpQueued;
+            m_nHead.store(Next(nHead), std::memory_order_release);
+            return true;
+        }
+
+        /** Consumer only. Blocks until the queue reaches the watermark or Wake has been called **/
+        void Wait()
+        {
+            Sleep(nullptr, m_nWatermark.load(std::memory_order_relaxed));
+        }
+
+        /** Consumer only. As Wait but gives up at tpDeadline **/
+        void WaitUntil(std::chrono::steady_clock::time_point tpDeadline)
+        {
+            long long nDeadline = std::chrono::duration_cast<std::chrono::nanoseconds>(tpDeadline.time_since_epoch()).count();
+            timespec ts;
+            ts.tv_sec = nDeadline/1000000000LL;
+            ts.tv_nsec = nDeadline%1000000000LL;
+            Sleep(&ts, m_nWatermark.load(std::memory_order_relaxed));
+        }
+
+        /** Consumer only. Blocks until the next entry is due, going by the interval between recent pushes, or until the queue reaches the watermark.
+        *   nSlackUs is added to the due time to allow for jitter in the producer. If the entry is already overdue the consumer asks to be woken by the
+        *   next push instead. Until the interval is known this is the same as Wait
+        **/
+        void WaitForNext(long long nSlackUs)
+        {
+            if(Size() > 0)
+            {
+                return;
+            }
+
+            long long nInterval = m_nIntervalNs.load(std::memory_order_relaxed);
+            if(nInterval == 0)
+            {
+                Sleep(nullptr, m_nWatermark.load(std::memory_order_relaxed));
+                return;
+            }
+
+            long long nDue = m_nLastPushNs.load(std::memory_order_relaxed) + nInterval + nSlackUs*1000;
+            size_t nWatermark = m_nWatermark.load(std::memory_order_relaxed);
+            long long nNow = NowNs();
+            if(nDue <= nNow)
+            {   //the next entry is late so have the producer wake us as soon as it arrives, but don't wait longer than another interval
+                nDue += nInterval;
+                nWatermark = 1;
+                if(nDue <= nNow)
+                {   //the producer has stalled. Wait for it rather than spin, which at real-time priority could starve it altogether
+                    Sleep(nullptr, nWatermark);
+                    return;
+                }
+            }
+
+            timespec ts;
+            ts.tv_sec = nDue/1000000000LL;
+            ts.tv_nsec = nDue%1000000000LL;
+            Sleep(&ts, nWatermark);
+        }
+
+        /** Releases the consumer from Wait, e.g. so it can see it should stop **/
+        void Wake()
+        {
+            m_bWoken.store(true, std::memory_order_seq_cst);
+            Signal();
+        }
+
+        /** The queue depth at which the producer wakes a sleeping consumer **/
+        void SetWatermark(size_t nWatermark)
+        {
+            m_nWatermark.store(std::min(std::max(nWatermark, static_cast<size_t>(1)), GetCapacity()), std::memory_order_relaxed);
+        }
+
+        size_t Size() const
+        {
+            size_t nHead = m_nHead.load(std::memory_order_seq_cst);
+            size_t nTail = m_nTail.load(std::memory_order_seq_cst);
+            return (nTail+m_vSlots.size()-nHead)%m_vSlots.size();
+        }
+
+        size_t GetCapacity() const { return m_vSlots.size()-1;}
+        size_t GetWatermark() const { return m_nWatermark.load(std::memory_order_relaxed);}
+        size_t GetHighWatermark() const { return m_nHighWater.load(std::memory_order_relaxed);}
+        unsigned long long GetDropped() const { return m_nDropped.load(std::memory_order_relaxed);}
+
+        /** Number of times the producer had to wake the consumer and number of times the consumer has slept and been woken, for any reason **/
+        unsigned long long GetNotifyCount() const { return m_nNotifies.load(std::memory_order_relaxed);}
+        unsigned long long GetWakeupCount() const { return m_nWakeups.load(std::memory_order_relaxed);}
+
+    private:
+        struct slot
+        {
+            T value;
+            std::chrono::steady_clock::time_point tpQueued;
+        };
+
+        size_t Next(size_t n) const { return (n+1)%m_vSlots.size();}
+
+        static long long NowNs()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void TrackInterval(std::chrono::steady_clock::time_point tpNow)
+        {
+            long long nNow = std::chrono::duration_cast<std::chrono::nanoseconds>(tpNow.time_since_epoch()).count();
+            long long nLast = m_nLastPushNs.load(std::memory_order_relaxed);
+            if(nLast != 0)
+            {   //smoothed so one late push does not throw the consumer's deadline out
+                long long nInterval = m_nIntervalNs.load(std::memory_order_relaxed);
+                nInterval = nInterval == 0 ? nNow-nLast : nInterval + ((nNow-nLast)-nInterval)/8;
+                m_nIntervalNs.store(nInterval, std::memory_order_relaxed);
+            }
+            m_nLastPushNs.store(nNow, std::memory_order_relaxed);
+        }
+
+        void Sleep(const timespec* pDeadline, size_t nWatermark)
+        {
+            int nFutex = m_nFutex.load(std::memory_order_acquire);
+            m_nWakeAt.store(nWatermark, std::memory_order_relaxed);
+            m_bSleeping.store(true, std::memory_order_seq_cst);
+            if(Size() < nWatermark && m_bWoken.exchange(false, std::memory_order_seq_cst) == false)
+            {   //an absolute CLOCK_MONOTONIC deadline (the steady_clock) so it is not affected by the clock being adjusted
+                syscall(SYS_futex, reinterpret_cast<int*>(&m_nFutex), FUTEX_WAIT_BITSET_PRIVATE, nFutex, pDeadline, nullptr, FUTEX_BITSET_MATCH_ANY);
+                m_nWakeups.fetch_add(1, std::memory_order_relaxed);     //only counted when we really slept
+            }
+            m_bSleeping.store(false, std::memory_order_relaxed);
+        }
+
+        void Signal()
+        {
+            m_nFutex.fetch_add(1, std::memory_order_release);
+            syscall(SYS_futex, reinterpret_cast<int*>(&m_nFutex), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+        }
+
+        std::vector<slot> m_vSlots;
+        std::atomic<size_t> m_nHead;
+        std::atomic<size_t> m_nTail;
+        std::atomic<size_t> m_nWatermark;
+        std::atomic<size_t> m_nWakeAt;  //the depth the sleeping consumer asked to be woken at
+
+        std::atomic<int> m_nFutex;
+        std::atomic<bool> m_bSleeping;
+        std::atomic<bool> m_bWoken;
+
+        std::atomic<long long> m_nLastPushNs;
+        std::atomic<long long> m_nIntervalNs;
+
+        std::atomic<size_t> m_nHighWater;
+        std::atomic<unsigned long long> m_nDropped;
+        std::atomic<unsigned long long> m_nNotifies;
+        std::atomic<unsigned long long> m_nWakeups;
+};
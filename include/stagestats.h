@@ -0,0 +1,29 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+
+/** Latency figures for one stage of the pipeline. Written by the stage's own thread and read by anyone without locking **/
+struct stagestats
+{
+    std::atomic<unsigned long long> nCount{0};
+    std::atomic<unsigned long long> nTotalNs{0};
+    std::atomic<unsigned long long> nMaxNs{0};
+
+    void Add(std::chrono::nanoseconds latency)
+    {
+        unsigned long long nNs = latency.count() > 0 ? latency.count() : 0;
+        nCount.fetch_add(1, std::memory_order_relaxed);
+        nTotalNs.fetch_add(nNs, std::memory_order_relaxed);
+
+        unsigned long long nMax = nMaxNs.load(std::memory_order_relaxed);
+        while(nNs > nMax && !nMaxNs.compare_exchange_weak(nMax, nNs, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /** Returns the worst latency since the last call and starts again **/
+    unsigned long long TakeMaxNs()
+    {
+        return nMaxNs.exchange(0, std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include "ltc.h"
+
+/** Converts between timecode and an absolute frame index in constant time, in both directions, using tables built at compile time.
+*   Without LTC_USE_DATE the index is the frame of the day. With it the SMPTE date in the user bits adds whole days counted from
+*   2000-01-01, following libltc's two digit year (every fourth year a leap year, wrapping after 2099), so the index runs on across midnight.
+*   29.97 drop frame labels skip frames 0 and 1 at the start of every minute except every tenth
+**/
+class TimecodeIndex
+{
+    public:
+        /** nFPS is the whole number of frames per timecode second: 24, 25 or 30. bDropFrame with 30 for 29.97 drop frame **/
+        TimecodeIndex(unsigned int nFPS, bool bDropFrame);
+
+        long long GetFramesPerDay() const { return m_nFramesPerDay;}
+
+        /** Returns -1 if the time, or with LTC_USE_DATE the date, is not a valid label at this rate **/
+        long long ToIndex(const LTCFrame& frame, int nFlags) const;
+        long long ToIndex(const SMPTETimecode& stime, int nFlags) const;
+
+        /** Sets the time, the drop frame bit and with LTC_USE_DATE the date. Then the parity unless LTC_NO_PARITY. The other user bits are left alone.
+        *   Indexes outside the range wrap
+        **/
+        void ToFrame(long long nIndex, LTCFrame& frame, LTC_TV_STANDARD eStandard, int nFlags) const;
+        /** Sets the time and with LTC_USE_DATE the date. The timezone is left alone **/
+        void ToTimecode(long long nIndex, SMPTETimecode& stime, int nFlags) const;
+
+    private:
+        long long FrameOfDay(int nHours, int nMinutes, int nSeconds, int nFrame) const;
+        long long Day(int nYear, int nMonth, int nDay) const;
+
+        int m_nFPS;
+        bool m_bDropFrame;
+        long long m_nFramesPerDay;
+};
@@ -8,3 +8,20 @@ extern std::string ConvertTimeToIsoString(std::time_t t, unsigned long nMicro);
 extern std::string ConvertTimeToIsoString(std::chrono::time_point<std::chrono::system_clock> tp);
 
 extern std::chrono::microseconds DoubleToMicro(double dDuration);
+
+/** Where a thread should run. nCpu < 0 leaves it free to run on any core. nPriority > 0 runs it SCHED_FIFO at that priority,
+*   otherwise it is left with the normal scheduler
+**/
+struct threadconfig
+{
+    int nCpu = -1;
+    int nPriority = 0;
+};
+
+/** Names the calling thread and applies the core and priority in config to it. A thread given a real-time priority also has its stack pre-faulted.
+*   Returns false if either could not be set. Set bAsyncLog when calling from an audio callback so failures are logged with logAsync
+**/
+extern bool ConfigureThread(const std::string& sName, const threadconfig& config, bool bAsyncLog = false);
+
+/** Locks all current and future memory in to RAM and stops malloc handing memory back to the system, so real-time threads never page fault **/
+extern bool LockMemory();
@@ -0,0 +1,538 @@
+#include "alsainput.h"
+#include "log.h"
+#include "latencyhistogram.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    const snd_pcm_format_t FORMATS[] = {SND_PCM_FORMAT_FLOAT_LE, SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S16_LE};
+    const unsigned long PERIODS_PER_BUFFER = 4;
+    const int WAIT_TIMEOUT_MS = 1000;
+
+    long long ToNs(const timespec& ts)
+    {
+        return static_cast<long long>(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+    }
+
+    timespec FromNs(long long nNs)
+    {
+        timespec ts;
+        ts.tv_sec = nNs/1000000000LL;
+        ts.tv_nsec = nNs%1000000000LL;
+        return ts;
+    }
+
+    //split so a file that has been playing for days doesn't overflow
+    long long FramesToNs(unsigned long long nFrames, unsigned long nSampleRate)
+    {
+        return static_cast<long long>((nFrames/nSampleRate)*1000000000ULL + (nFrames%nSampleRate)*1000000000ULL/nSampleRate);
+    }
+
+    template<typename T> T ReadLE(std::ifstream& file)
+    {
+        T value = 0;
+        file.read(reinterpret_cast<char*>(&value), sizeof(value));
+        return value;
+    }
+}
+
+const std::string AlsaInput::FILE_PREFIX = "file:";
+
+AlsaInput::AlsaInput(const std::string& sDevice, unsigned long nSampleRate, unsigned char nChannels, SpscQueue<audioblock>& queue) :
+    AudioSource(queue),
+    m_sDevice(sDevice),
+    m_nSampleRate(nSampleRate),
+    m_nChannels(nChannels),
+    m_pPcm(nullptr),
+    m_pStatus(nullptr),
+    m_eFormat(SND_PCM_FORMAT_UNKNOWN),
+    m_nSampleBytes(0),
+    m_nPeriod(BUFFER_DEFAULT),
+    m_nBufferFrames(0),
+    m_clockId(CLOCK_MONOTONIC),
+    m_nDataSize(0),
+    m_nLastSystemNs(0),
+    m_nLastAudioNs(0),
+    m_dAudioPPM(0.0),
+    m_bRecovered(false),
+    m_bRun(false)
+{
+
+}
+
+AlsaInput::~AlsaInput()
+{
+    m_bRun = false;
+    if(m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    CloseDevice();
+}
+
+bool AlsaInput::Init()
+{
+    m_nPeriod = (m_nBufferSetting == BUFFER_AUTO) ? BUFFER_DEFAULT : m_nBufferSetting;
+
+    if(m_sDevice.compare(0, FILE_PREFIX.size(), FILE_PREFIX) == 0)
+    {
+        if(OpenFile() == false)
+        {
+            return false;
+        }
+        m_bRun = true;
+        m_thread = std::thread(&AlsaInput::FileThread, this);
+    }
+    else
+    {
+        if(OpenDevice() == false)
+        {
+            CloseDevice();
+            return false;
+        }
+        m_bRun = true;
+        m_thread = std::thread(&AlsaInput::DeviceThread, this);
+    }
+    return true;
+}
+
+double AlsaInput::GetInputLatency() const
+{
+    return m_nSampleRate ? static_cast<double>(m_nBufferFrames)/static_cast<double>(m_nSampleRate) : 0.0;
+}
+
+bool AlsaInput::OpenDevice()
+{
+    pmlLog() << "AlsaInput\tAttempt to open device " << m_sDevice;
+
+    int nError = snd_pcm_open(&m_pPcm, m_sDevice.c_str(), SND_PCM_STREAM_CAPTURE, 0);
+    if(nError < 0)
+    {
+        m_pPcm = nullptr;
+        pmlLog(pml::LOG_ERROR) << "AlsaInput\tFailed to open device " << m_sDevice << ": " << snd_strerror(nError);
+        return false;
+    }
+
+    snd_pcm_hw_params_t* pHw;
+    snd_pcm_hw_params_malloc(&pHw);
+    snd_pcm_hw_params_any(m_pPcm, pHw);
+
+    if((nError = snd_pcm_hw_params_set_access(m_pPcm, pHw, SND_PCM_ACCESS_MMAP_INTERLEAVED)) < 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "AlsaInput\tDevice does not support mmap access: " << snd_strerror(nError);
+        snd_pcm_hw_params_free(pHw);
+        return false;
+    }
+
+    for(auto eFormat : FORMATS)
+    {
+        if(snd_pcm_hw_params_test_format(m_pPcm, pHw, eFormat) == 0 && snd_pcm_hw_params_set_format(m_pPcm, pHw, eFormat) == 0)
+        {
+            m_eFormat = eFormat;
+            break;
+        }
+    }
+    if(m_eFormat == SND_PCM_FORMAT_UNKNOWN)
+    {
+        pmlLog(pml::LOG_ERROR) << "AlsaInput\tDevice supports none of float, s32 or s16";
+        snd_pcm_hw_params_free(pHw);
+        return false;
+    }
+    m_nSampleBytes = (m_eFormat == SND_PCM_FORMAT_S16_LE) ? 2 : 4;
+
+    unsigned int nChannels = m_nChannels;
+    unsigned int nRate = m_nSampleRate;
+    snd_pcm_uframes_t nPeriod = m_nPeriod;
+    snd_pcm_uframes_t nBuffer = (m_dLatencySetting > 0.0) ? static_cast<snd_pcm_uframes_t>(m_dLatencySetting*m_nSampleRate) : nPeriod*PERIODS_PER_BUFFER;
+    nBuffer = std::max(nBuffer, nPeriod*2);
+
+    snd_pcm_hw_params_set_channels_near(m_pPcm, pHw, &nChannels);
+    snd_pcm_hw_params_set_rate_near(m_pPcm, pHw, &nRate, nullptr);
+    snd_pcm_hw_params_set_period_size_near(m_pPcm, pHw, &nPeriod, nullptr);
+    snd_pcm_hw_params_set_buffer_size_near(m_pPcm, pHw, &nBuffer);
+
+    nError = snd_pcm_hw_params(m_pPcm, pHw);
+    snd_pcm_hw_params_free(pHw);
+    if(nError < 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "AlsaInput\tFailed to set hardware parameters: " << snd_strerror(nError);
+        return false;
+    }
+
+    m_nChannels = nChannels;
+    m_nSampleRate = nRate;
+    if(m_nChannel >= m_nChannels)
+    {
+        pmlLog(pml::LOG_ERROR) << "AlsaInput\tDevice " << m_sDevice << " has no capture channel " << static_cast<int>(m_nChannel);
+        return false;
+    }
+    m_nPeriod = nPeriod;
+    m_nBufferFrames = nBuffer;
+
+    snd_pcm_sw_params_t* pSw;
+    snd_pcm_sw_params_malloc(&pSw);
+    snd_pcm_sw_params_current(m_pPcm, pSw);
+    snd_pcm_sw_params_set_avail_min(m_pPcm, pSw, m_nPeriod);
+    snd_pcm_sw_params_set_tstamp_mode(m_pPcm, pSw, SND_PCM_TSTAMP_ENABLE);
+    if(snd_pcm_sw_params_set_tstamp_type(m_pPcm, pSw, SND_PCM_TSTAMP_TYPE_MONOTONIC_RAW) == 0)
+    {
+        m_clockId = CLOCK_MONOTONIC_RAW;
+    }
+    else
+    {
+        snd_pcm_sw_params_set_tstamp_type(m_pPcm, pSw, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+        m_clockId = CLOCK_MONOTONIC;
+    }
+    nError = snd_pcm_sw_params(m_pPcm, pSw);
+    snd_pcm_sw_params_free(pSw);
+    if(nError < 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "AlsaInput\tFailed to set software parameters: " << snd_strerror(nError);
+        return false;
+    }
+
+    snd_pcm_status_malloc(&m_pStatus);
+
+    pmlLog() << "AlsaInput\tDevice " << m_sDevice << " opened: " << nChannels << " channels at " << nRate << "Hz, " << m_nSampleBytes*8 << " bit"
+             << (m_eFormat == SND_PCM_FORMAT_FLOAT_LE ? " float" : "") << ", period " << m_nPeriod << " frames, buffer " << m_nBufferFrames
+             << " frames, timestamps from " << (m_clockId == CLOCK_MONOTONIC_RAW ? "CLOCK_MONOTONIC_RAW" : "CLOCK_MONOTONIC");
+    return true;
+}
+
+void AlsaInput::CloseDevice()
+{
+    if(m_pPcm)
+    {
+        snd_pcm_drop(m_pPcm);
+        snd_pcm_close(m_pPcm);
+        m_pPcm = nullptr;
+    }
+    if(m_pStatus)
+    {
+        snd_pcm_status_free(m_pStatus);
+        m_pStatus = nullptr;
+    }
+}
+
+void AlsaInput::DeviceThread()
+{
+    ConfigureThread("capture", m_config);
+
+    int nError = snd_pcm_start(m_pPcm);
+    if(nError < 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "AlsaInput\tFailed to start capture: " << snd_strerror(nError);
+        return;
+    }
+
+    while(m_bRun)
+    {
+        snd_pcm_sframes_t nAvail = snd_pcm_avail_update(m_pPcm);
+        if(nAvail < 0)
+        {
+            Recover(nAvail);
+        }
+        else if(static_cast<snd_pcm_uframes_t>(nAvail) < m_nPeriod)
+        {
+            nError = snd_pcm_wait(m_pPcm, WAIT_TIMEOUT_MS);
+            if(nError < 0)
+            {
+                Recover(nError);
+            }
+        }
+        else
+        {
+            ReadDevice();
+        }
+    }
+}
+
+void AlsaInput::Recover(int nError)
+{
+    if(nError == -EPIPE)
+    {
+        m_nOverflows.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    nError = snd_pcm_recover(m_pPcm, nError, 1);
+    if(nError == 0)
+    {   //a capture stream has to be restarted by hand after being prepared
+        nError = snd_pcm_start(m_pPcm);
+    }
+    if(nError < 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "AlsaInput\tFailed to recover from error: " << snd_strerror(nError);
+    }
+    m_nLastSystemNs = 0;
+    m_bRecovered = true;
+}
+
+bool AlsaInput::ReadDevice()
+{
+    LATENCY_START(tpRead);
+    //the kernel took the timestamp when it last moved the hardware pointer, at which point there were nAvail frames waiting to be read.
+    //So the first of them, the first sample of our block, was captured nAvail frames earlier
+    int nError = snd_pcm_status(m_pPcm, m_pStatus);
+    if(nError < 0)
+    {
+        Recover(nError);
+        return false;
+    }
+
+    timespec tsSystem, tsAudio;
+    snd_pcm_status_get_htstamp(m_pStatus, &tsSystem);
+    snd_pcm_status_get_audio_htstamp(m_pStatus, &tsAudio);
+    snd_pcm_uframes_t nAvail = snd_pcm_status_get_avail(m_pStatus);
+
+    TrackAudioClock(tsSystem, tsAudio);
+    long long nFirstNs = ToNs(tsSystem) - static_cast<long long>(nAvail)*1000000000LL/static_cast<long long>(m_nSampleRate);
+    auto tpFirst = ToSystemTime(FromNs(nFirstNs));
+
+    unsigned long nLost(0);
+    bool bDiscontinuity = CheckGap(static_cast<double>(nFirstNs)/1e9, m_nPeriod, m_nSampleRate, nLost) || m_bRecovered;
+    m_bRecovered = false;
+
+    aframe af = GetBuffer(m_nPeriod);
+
+    snd_pcm_uframes_t nWanted = m_nPeriod;
+    while(nWanted > 0)
+    {   //the area may wrap at the end of the ring buffer so could take two goes
+        const snd_pcm_channel_area_t* pAreas;
+        snd_pcm_uframes_t nOffset;
+        snd_pcm_uframes_t nFrames = nWanted;
+        nError = snd_pcm_mmap_begin(m_pPcm, &pAreas, &nOffset, &nFrames);
+        if(nError < 0)
+        {
+            Recover(nError);
+            return false;
+        }
+
+        const unsigned char* pFirst = reinterpret_cast<const unsigned char*>(pAreas[m_nChannel].addr) + pAreas[m_nChannel].first/8;
+        size_t nStep = pAreas[m_nChannel].step/8;
+        for(snd_pcm_uframes_t i = 0; i < nFrames; i++)
+        {
+            af.push_back(ToFloat(pFirst + (nOffset+i)*nStep));
+        }
+
+        snd_pcm_sframes_t nCommitted = snd_pcm_mmap_commit(m_pPcm, nOffset, nFrames);
+        if(nCommitted < 0 || static_cast<snd_pcm_uframes_t>(nCommitted) != nFrames)
+        {
+            Recover(nCommitted < 0 ? nCommitted : -EPIPE);
+            return false;
+        }
+        nWanted -= nFrames;
+    }
+
+    Queue(timedframe(tpFirst, std::move(af)), bDiscontinuity, nLost);
+    m_stats.Add(std::chrono::system_clock::now()-tpFirst);
+    LATENCY_END(LATENCY_CALLBACK, tpRead);
+    return true;
+}
+
+float AlsaInput::ToFloat(const unsigned char* pSample) const
+{
+    switch(m_eFormat)
+    {
+        case SND_PCM_FORMAT_FLOAT_LE:
+            {
+                float dSample;
+                memcpy(&dSample, pSample, sizeof(dSample));
+                return dSample;
+            }
+        case SND_PCM_FORMAT_S32_LE:
+            {
+                int32_t nSample;
+                memcpy(&nSample, pSample, sizeof(nSample));
+                return static_cast<float>(nSample)/2147483648.0f;
+            }
+        case SND_PCM_FORMAT_S16_LE:
+            {
+                int16_t nSample;
+                memcpy(&nSample, pSample, sizeof(nSample));
+                return static_cast<float>(nSample)/32768.0f;
+            }
+        default:
+            return 0.0f;
+    }
+}
+
+std::chrono::time_point<std::chrono::system_clock> AlsaInput::ToSystemTime(const timespec& ts) const
+{
+    //read the timestamp clock either side of the real time clock and take the mid point to get the offset between the two
+    timespec tsBefore, tsReal, tsAfter;
+    clock_gettime(m_clockId, &tsBefore);
+    clock_gettime(CLOCK_REALTIME, &tsReal);
+    clock_gettime(m_clockId, &tsAfter);
+
+    long long nMid = (ToNs(tsBefore)+ToNs(tsAfter))/2;
+    long long nReal = ToNs(tsReal) + (ToNs(ts)-nMid);
+
+    return std::chrono::time_point<std::chrono::system_clock>(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(nReal)));
+}
+
+void AlsaInput::TrackAudioClock(const timespec& tsSystem, const timespec& tsAudio)
+{
+    long long nSystem = ToNs(tsSystem);
+    long long nAudio = ToNs(tsAudio);
+    if(m_nLastSystemNs != 0 && nAudio != 0 && nSystem > m_nLastSystemNs && nAudio > m_nLastAudioNs)
+    {
+        double dPPM = (static_cast<double>(nAudio-m_nLastAudioNs)/static_cast<double>(nSystem-m_nLastSystemNs) - 1.0)*1e6;
+        double dAverage = m_dAudioPPM.load(std::memory_order_relaxed);
+        m_dAudioPPM.store(dAverage + (dPPM-dAverage)/64.0, std::memory_order_relaxed);
+    }
+    m_nLastSystemNs = nSystem;
+    m_nLastAudioNs = nAudio;
+}
+
+bool AlsaInput::OpenFile()
+{
+    std::string sPath = m_sDevice.substr(FILE_PREFIX.size());
+    pmlLog() << "AlsaInput\tAttempt to open capture file " << sPath;
+
+    m_file.open(sPath, std::ios::binary);
+    if(!m_file.is_open() || ReadWavHeader() == false)
+    {
+        pmlLog(pml::LOG_ERROR) << "AlsaInput\tFailed to open capture file " << sPath;
+        return false;
+    }
+    if(m_nChannel >= m_nChannels)
+    {
+        pmlLog(pml::LOG_ERROR) << "AlsaInput\tCapture file " << sPath << " has no channel " << static_cast<int>(m_nChannel);
+        return false;
+    }
+
+    //file blocks are timestamped from the same clock the pacing uses
+    m_clockId = CLOCK_MONOTONIC;
+    m_nBufferFrames = m_nPeriod;
+
+    pmlLog() << "AlsaInput\tCapture file " << sPath << " opened: " << static_cast<int>(m_nChannels) << " channels at " << m_nSampleRate << "Hz, "
+             << m_nSampleBytes*8 << " bit" << (m_eFormat == SND_PCM_FORMAT_FLOAT_LE ? " float" : "") << ", block " << m_nPeriod << " frames";
+    return true;
+}
+
+bool AlsaInput::ReadWavHeader()
+{
+    char id[4];
+    m_file.read(id, 4);
+    ReadLE<uint32_t>(m_file);
+    char wave[4];
+    m_file.read(wave, 4);
+    if(!m_file || memcmp(id, "RIFF", 4) != 0 || memcmp(wave, "WAVE", 4) != 0)
+    {
+        return false;
+    }
+
+    bool bFormat(false);
+    while(m_file.read(id, 4))
+    {
+        uint32_t nSize = ReadLE<uint32_t>(m_file);
+        if(memcmp(id, "fmt ", 4) == 0)
+        {
+            uint16_t nType = ReadLE<uint16_t>(m_file);
+            m_nChannels = ReadLE<uint16_t>(m_file);
+            m_nSampleRate = ReadLE<uint32_t>(m_file);
+            ReadLE<uint32_t>(m_file);   //byte rate
+            ReadLE<uint16_t>(m_file);   //block align
+            uint16_t nBits = ReadLE<uint16_t>(m_file);
+            m_file.seekg(nSize-16, std::ios::cur);
+
+            if(nType == 3 && nBits == 32)
+            {
+                m_eFormat = SND_PCM_FORMAT_FLOAT_LE;
+            }
+            else if(nType == 1 && nBits == 32)
+            {
+                m_eFormat = SND_PCM_FORMAT_S32_LE;
+            }
+            else if(nType == 1 && nBits == 16)
+            {
+                m_eFormat = SND_PCM_FORMAT_S16_LE;
+            }
+            else
+            {
+                pmlLog(pml::LOG_ERROR) << "AlsaInput\tUnsupported WAV format " << nType << " with " << nBits << " bits";
+                return false;
+            }
+            m_nSampleBytes = nBits/8;
+            bFormat = (m_nChannels > 0 && m_nSampleRate > 0);
+        }
+        else if(memcmp(id, "data", 4) == 0)
+        {
+            m_nDataStart = m_file.tellg();
+            m_nDataSize = nSize;
+            return bFormat && m_nDataSize >= static_cast<std::streamoff>(m_nSampleBytes*m_nChannels);
+        }
+        else
+        {
+            m_file.seekg(nSize + (nSize&1), std::ios::cur);  //chunks are word aligned
+        }
+    }
+    return false;
+}
+
+void AlsaInput::FileThread()
+{
+    ConfigureThread("capture", m_config);
+
+    size_t nFrameBytes = m_nSampleBytes*m_nChannels;
+    std::vector<unsigned char> vBuffer(m_nPeriod*nFrameBytes);
+
+    timespec tsStart;
+    clock_gettime(m_clockId, &tsStart);
+    long long nStartNs = ToNs(tsStart);
+    unsigned long long nFrames(0);
+
+    while(m_bRun)
+    {
+        //a block is ready once its last sample would have been captured
+        long long nFirstNs = nStartNs + FramesToNs(nFrames, m_nSampleRate);
+        timespec tsReady = FromNs(nStartNs + FramesToNs(nFrames+m_nPeriod, m_nSampleRate));
+        while(clock_nanosleep(m_clockId, TIMER_ABSTIME, &tsReady, nullptr) == EINTR)
+        {
+        }
+
+        LATENCY_START(tpRead);
+        ReadFileBlock(vBuffer);
+
+        aframe af = GetBuffer(m_nPeriod);
+        for(size_t i = 0; i < m_nPeriod; i++)
+        {
+            af.push_back(ToFloat(vBuffer.data()+i*nFrameBytes+m_nChannel*m_nSampleBytes));
+        }
+
+        auto tpFirst = ToSystemTime(FromNs(nFirstNs));
+        Queue(timedframe(tpFirst, std::move(af)), false, 0);
+        m_stats.Add(std::chrono::system_clock::now()-tpFirst);
+        LATENCY_END(LATENCY_CALLBACK, tpRead);
+
+        nFrames += m_nPeriod;
+    }
+}
+
+void AlsaInput::ReadFileBlock(std::vector<unsigned char>& vBuffer)
+{
+    //loop round to the start of the data when we reach the end
+    size_t nRead(0);
+    bool bRewound(false);
+    while(nRead < vBuffer.size())
+    {
+        std::streamoff nLeft = m_nDataSize - (m_file.tellg()-m_nDataStart);
+        if(nLeft <= 0 || !m_file)
+        {
+            m_file.clear();
+            m_file.seekg(m_nDataStart);
+            nLeft = m_nDataSize;
+            bRewound = true;
+        }
+        size_t nChunk = std::min(vBuffer.size()-nRead, static_cast<size_t>(nLeft));
+        m_file.read(reinterpret_cast<char*>(vBuffer.data()+nRead), nChunk);
+        if(m_file.gcount() == 0 && bRewound)
+        {   //the data chunk is shorter than its header says
+            std::fill(vBuffer.begin()+nRead, vBuffer.end(), 0);
+            break;
+        }
+        nRead += m_file.gcount();
+    }
+}
@@ -0,0 +1,156 @@
+#include "asynclog.h"
+#include "utils.h"
+#include <sstream>
+#include <iomanip>
+
+namespace
+{
+    const std::chrono::milliseconds WRITER_INTERVAL(20);   //the writer polls so that logging never has to wake it
+    const std::chrono::milliseconds LATE_THRESHOLD(100);   //records formatted later than this after being logged say when they were logged
+}
+
+AsyncLog& AsyncLog::Get()
+{
+    static AsyncLog log;
+    return log;
+}
+
+AsyncLog::AsyncLog() :
+    m_vSlots(RING_SIZE),
+    m_nMask(RING_SIZE-1),
+    m_nEnqueue(0),
+    m_nDequeue(0),
+    m_nLevel(pml::LOG_TRACE),
+    m_bRun(false),
+    m_nDropped(0),
+    m_nReportedDropped(0)
+{
+    for(size_t i = 0; i < RING_SIZE; i++)
+    {
+        m_vSlots[i].nSequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+AsyncLog::~AsyncLog()
+{
+    Stop();
+}
+
+void AsyncLog::Start()
+{
+    if(m_bRun == false)
+    {
+        m_bRun = true;
+        m_thWriter = std::thread(&AsyncLog::WriterThread, this);
+    }
+}
+
+void AsyncLog::Stop()
+{
+    if(m_bRun)
+    {
+        m_bRun = false;
+        m_thWriter.join();
+    }
+}
+
+bool AsyncLog::Claim(size_t& nPosition)
+{
+    //bounded multi-producer ring: each slot's sequence says whether it is free for the producer at this position to fill
+    nPosition = m_nEnqueue.load(std::memory_order_relaxed);
+    while(true)
+    {
+        size_t nSequence = m_vSlots[nPosition & m_nMask].nSequence.load(std::memory_order_acquire);
+        long long nDiff = static_cast<long long>(nSequence) - static_cast<long long>(nPosition);
+        if(nDiff == 0)
+        {
+            if(m_nEnqueue.compare_exchange_weak(nPosition, nPosition+1, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        else if(nDiff < 0)
+        {   //the writer hasn't got to this slot yet: the ring is full
+            return false;
+        }
+        else
+        {
+            nPosition = m_nEnqueue.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool AsyncLog::Drain()
+{
+    bool bAny(false);
+    while(true)
+    {
+        slot& theSlot = m_vSlots[m_nDequeue & m_nMask];
+        if(theSlot.nSequence.load(std::memory_order_acquire) != m_nDequeue+1)
+        {   //empty, or the producer that claimed it hasn't finished filling it
+            break;
+        }
+        Write(theSlot.record);
+        theSlot.nSequence.store(m_nDequeue+RING_SIZE, std::memory_order_release);
+        m_nDequeue++;
+        bAny = true;
+    }
+
+    auto nDropped = m_nDropped.load(std::memory_order_relaxed);
+    if(nDropped != m_nReportedDropped)
+    {
+        pmlLog(pml::LOG_WARN) << "AsyncLog\tRing full: " << (nDropped-m_nReportedDropped) << " records dropped";
+        m_nReportedDropped = nDropped;
+    }
+    return bAny;
+}
+
+void AsyncLog::Write(const logrecord& record)
+{
+    std::stringstream ss;
+    for(unsigned char i = 0; i < record.nArgs; i++)
+    {
+        const logarg& arg(record.args[i]);
+        switch(arg.eType)
+        {
+            case logarg::INT:
+                ss << arg.nInt;
+                break;
+            case logarg::UINT:
+                ss << arg.nUint;
+                break;
+            case logarg::DOUBLE:
+                ss << arg.dValue;
+                break;
+            case logarg::TEXT:
+                ss.write(record.sText+arg.text.nOffset, arg.text.nLength);
+                break;
+            case logarg::TIME:
+                ss << ConvertTimeToIsoString(std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(arg.nTimeNs))));
+                break;
+        }
+    }
+    if(record.bTruncated)
+    {
+        ss << "...";
+    }
+    if(std::chrono::system_clock::now()-record.tp > LATE_THRESHOLD)
+    {
+        ss << "\t[logged " << ConvertTimeToIsoString(record.tp) << "]";
+    }
+    pmlLog(record.eLevel) << ss.str();
+}
+
+void AsyncLog::WriterThread()
+{
+    ConfigureThread("asynclog", threadconfig());
+
+    while(m_bRun)
+    {
+        if(Drain() == false)
+        {
+            std::this_thread::sleep_for(WRITER_INTERVAL);
+        }
+    }
+    Drain();
+}
@@ -1,8 +1,16 @@
 #include "audioinput.h"
 #include "log.h"
+#include "latencyhistogram.h"
 #include "pa_linux_alsa.h"
 #include "utils.h"
 #include <cmath>
+#include <algorithm>
+
+namespace
+{
+    const std::chrono::seconds TUNE_HOLDOFF(5);
+    const std::chrono::seconds REOPEN_INTERVAL(1);
+}
 
 int paCallback( const void *input, void *output, unsigned long frameCount, const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void *userData )
 {
@@ -16,17 +24,31 @@ int paCallback( const void *input, void *output, unsigned long frameCount, const
 }
 
 
-AudioInput::AudioInput(unsigned long nDevice, unsigned long nSampleRate, unsigned char nChannels, std::condition_variable& cv) :
+AudioInput::AudioInput(unsigned long nDevice, unsigned long nSampleRate, unsigned char nChannels, SpscQueue<audioblock>& queue) :
+    AudioSource(queue),
     m_nDevice(nDevice),
     m_nSampleRate(nSampleRate),
     m_nChannels(nChannels),
-    m_cv(cv),
-    m_pStream(nullptr)
+    m_pStream(nullptr),
+    m_bThreadConfigured(false),
+    m_bRestarted(false),
+    m_nFramesPerBuffer(BUFFER_DEFAULT),
+    m_dLatency(0.0),
+    m_dInputLatency(0.0),
+    m_nTunedOverflows(0),
+    m_nTuneLimit(AUTO_BUFFER_MAX),
+    m_bReopen(false)
 {
 
 }
 
 AudioInput::~AudioInput()
+{
+    CloseStream();
+    Pa_Terminate();
+}
+
+void AudioInput::CloseStream()
 {
     if(m_pStream)
     {
@@ -37,8 +59,8 @@ AudioInput::~AudioInput()
         {
             pmlLog(pml::LOG_ERROR) << "AudioInput\tFailed to stop PortAudio stream: " << Pa_GetErrorText(err);
         }
+        m_pStream = nullptr;
     }
-    Pa_Terminate();
 }
 
 
@@ -49,6 +71,9 @@ bool AudioInput::Init()
         pmlLog(pml::LOG_CRITICAL) << "AudioInput\tCould not initialize PortAudio";
         return false;
     }
+
+    m_nFramesPerBuffer = (m_nBufferSetting == BUFFER_AUTO) ? AUTO_BUFFER_MIN : m_nBufferSetting;
+    m_tpTuned = std::chrono::steady_clock::now();
     return OpenStream();
 }
 
@@ -63,28 +88,36 @@ bool AudioInput::OpenStream()
     const PaDeviceInfo* pInfo = Pa_GetDeviceInfo(m_nDevice);
     if(pInfo)
     {
-        if(pInfo->maxInputChannels < 2)
+        if(pInfo->maxInputChannels < m_nChannels)
         {
             m_nChannels = pInfo->maxInputChannels;
             pmlLog() << "AudioInput\tInput channels changed to " << m_nChannels;
         }
 
     }
+    if(m_nChannel >= m_nChannels)
+    {
+        pmlLog(pml::LOG_ERROR) << "AudioInput\tDevice " << m_nDevice << " has no input channel " << static_cast<int>(m_nChannel);
+        return false;
+    }
 
 
+    if(m_dLatency <= 0.0)
+    {
+        m_dLatency = (m_dLatencySetting > 0.0 || pInfo == nullptr) ? m_dLatencySetting : pInfo->defaultLowInputLatency;
+    }
+
     inputParameters.channelCount = m_nChannels;
     inputParameters.device = m_nDevice;
     inputParameters.hostApiSpecificStreamInfo = NULL;
     inputParameters.sampleFormat = paFloat32;
-    inputParameters.suggestedLatency = 0;
+    inputParameters.suggestedLatency = m_dLatency;
     inputParameters.hostApiSpecificStreamInfo = NULL;
 
-    double dLatency(.04);
-
     PaError err;
 
-    pmlLog() << "AudioInput\tAttempt to open " << m_nChannels << " channel INPUT stream on device " << m_nDevice;
-    err = Pa_OpenStream(&m_pStream, &inputParameters, 0, m_nSampleRate, 1024, paNoFlag, paCallback, reinterpret_cast<void*>(this) );
+    pmlLog() << "AudioInput\tAttempt to open " << m_nChannels << " channel INPUT stream on device " << m_nDevice << " with " << m_nFramesPerBuffer << " frames per buffer and suggested latency " << m_dLatency;
+    err = Pa_OpenStream(&m_pStream, &inputParameters, 0, m_nSampleRate, m_nFramesPerBuffer, paNoFlag, paCallback, reinterpret_cast<void*>(this) );
 
     if(err == paNoError)
     {
@@ -95,11 +128,15 @@ bool AudioInput::OpenStream()
         err = Pa_StartStream(m_pStream);
         if(err == paNoError)
         {
-            PaAlsa_EnableRealtimeScheduling(m_pStream,1);
+            if(m_config.nPriority == 0)
+            {   //no priority of our own so let PortAudio decide
+                PaAlsa_EnableRealtimeScheduling(m_pStream,1);
+            }
             pmlLog() << "AudioInput\tDevice " << m_nDevice << " opened";
             const PaStreamInfo* pStreamInfo = Pa_GetStreamInfo(m_pStream);
             if(pStreamInfo)
             {
+                m_dInputLatency = pStreamInfo->inputLatency;
                 pmlLog() << "AudioInput\tStreamInfo: Input Latency " << pStreamInfo->inputLatency << " Sample Rate " << pStreamInfo->sampleRate;
             }
             return true;
@@ -114,6 +151,27 @@ bool AudioInput::OpenStream()
 
 void AudioInput::Callback(const float* pBuffer, size_t nFrameCount, const PaStreamCallbackTimeInfo* pTimeInfo, int nFlags)
 {
+    LATENCY_START(tpCallback);
+    if(m_bThreadConfigured == false)
+    {
+        ConfigureThread("capture", m_config, true);    //on PortAudio's callback thread so mustn't log with pmlLog
+        m_bThreadConfigured = true;
+    }
+
+    //samples have been lost if PortAudio says so or if this block doesn't start where the last one ended
+    unsigned long nLost(0);
+    bool bDiscontinuity = CheckGap(pTimeInfo->inputBufferAdcTime > 0.0 ? pTimeInfo->inputBufferAdcTime : -1.0, nFrameCount, m_nSampleRate, nLost);
+    if(nFlags & paInputOverflow)
+    {
+        m_nOverflows.fetch_add(1, std::memory_order_relaxed);
+        bDiscontinuity = true;
+    }
+    if(m_bRestarted)
+    {
+        bDiscontinuity = true;
+        m_bRestarted = false;
+    }
+
     //time of first sample of frame is open time + difference
     auto tpNow = std::chrono::system_clock::now();
 
@@ -121,40 +179,71 @@ void AudioInput::Callback(const float* pBuffer, size_t nFrameCount, const PaStre
     auto tpFirst = tpNow - DoubleToMicro(diff);
 
 
-    aframe af;
-    af.reserve(nFrameCount);
-    for(size_t i = 0; i < nFrameCount*m_nChannels; i+=m_nChannels)
+    aframe af = GetBuffer(nFrameCount);
+    for(size_t i = m_nChannel; i < nFrameCount*m_nChannels; i+=m_nChannels)
     {
         af.push_back(pBuffer[i]);
     }
 
-    m_mutex.lock();
-    m_qBuffer.push(timedframe(tpFirst, af));
-    m_mutex.unlock();
+    Queue(timedframe(tpFirst, std::move(af)), bDiscontinuity, nLost);
 
-    //@todo tell main thread that we have audio...
-    m_cv.notify_one();
+    m_stats.Add(std::chrono::system_clock::now()-tpFirst);
+    LATENCY_END(LATENCY_CALLBACK, tpCallback);
 }
 
-bool AudioInput::IsReady()
+void AudioInput::Tune()
 {
-    std::lock_guard<std::mutex> lg(m_mutex);
-    return m_qBuffer.empty() == false;
-}
+    if(m_bReopen)
+    {
+        if(std::chrono::steady_clock::now()-m_tpReopen >= REOPEN_INTERVAL)
+        {
+            pmlLog(pml::LOG_WARN) << "AudioInput\tDevice " << m_nDevice << " is closed. Trying to reopen it with " << m_nFramesPerBuffer << " frames per buffer";
+            m_bReopen = (OpenStream() == false);
+            m_tpReopen = std::chrono::steady_clock::now();
+            m_tpTuned = m_tpReopen;
+        }
+        return;
+    }
 
-const timedframe& AudioInput::GetNextFrame()
-{
-    std::lock_guard<std::mutex> lg(m_mutex);
-    return m_qBuffer.front();
-}
+    auto nOverflows = GetOverflowCount();
+    if(m_nBufferSetting != BUFFER_AUTO || nOverflows == m_nTunedOverflows || m_nFramesPerBuffer >= m_nTuneLimit)
+    {
+        return;
+    }
+    if(std::chrono::steady_clock::now()-m_tpTuned < TUNE_HOLDOFF)
+    {   //give the last change a chance to settle before backing off again
+        return;
+    }
 
-bool AudioInput::RemoveFrame()
-{
-    std::lock_guard<std::mutex> lg(m_mutex);
-    m_qBuffer.pop();
-    return m_qBuffer.empty() == false;
-}
+    pmlLog(pml::LOG_WARN) << "AudioInput\t" << (nOverflows-m_nTunedOverflows) << " input overflows with " << m_nFramesPerBuffer << " frames per buffer. Backing off";
 
+    CloseStream();
+    unsigned long nPrevious = m_nFramesPerBuffer;
+    double dPreviousLatency = m_dLatency;
+    m_nFramesPerBuffer = std::min(m_nFramesPerBuffer*2, static_cast<unsigned long>(AUTO_BUFFER_MAX));
+    if(m_dLatencySetting <= 0.0)
+    {   //latency follows the buffer size unless it has been set explicitly
+        m_dLatency = std::max(m_dLatency, 2.0*static_cast<double>(m_nFramesPerBuffer)/static_cast<double>(m_nSampleRate));
+    }
+    m_bThreadConfigured = false;
+    m_dNextStart = -1.0;
+    m_bRestarted = true;    //whatever was captured while the stream was closed has been lost
+    if(OpenStream() == false)
+    {
+        pmlLog(pml::LOG_WARN) << "AudioInput\tCould not reopen device " << m_nDevice << " with " << m_nFramesPerBuffer << " frames per buffer. Going back to " << nPrevious;
+        m_nFramesPerBuffer = nPrevious;
+        m_dLatency = dPreviousLatency;
+        m_bReopen = (OpenStream() == false);    //if even that fails keep trying from Service
+        m_tpReopen = std::chrono::steady_clock::now();
+        if(m_bReopen == false)
+        {   //it is the size that the device won't take so don't try it again
+            m_nTuneLimit = nPrevious;
+        }
+    }
+
+    m_nTunedOverflows = GetOverflowCount();
+    m_tpTuned = std::chrono::steady_clock::now();
+}
 
 void AudioInput::OffsetOpenTime(double dOffset)
 {
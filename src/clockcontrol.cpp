@@ -0,0 +1,123 @@
+#include "clockcontrol.h"
+#include "asynclog.h"
+#include "utils.h"
+#include <sys/timex.h>
+#include <sys/time.h>
+#include <cstring>
+#include <cmath>
+
+ClockControl::ClockControl() : m_nLastStepNs(0), m_nSteps(0), m_bSlewPending(false)
+{
+
+}
+
+void ClockControl::Execute(const clockcommand& command)
+{
+    switch(command.eType)
+    {
+        case clockcommand::SLEW:
+            Slew(command.dValue);
+            break;
+        case clockcommand::FREQUENCY:
+            ChangeFrequency(command.dValue);
+            break;
+        case clockcommand::STEP:
+            Step(command.dValue);
+            break;
+        default:
+            break;
+    }
+}
+
+std::chrono::steady_clock::time_point ClockControl::GetLastStepTime() const
+{
+    return std::chrono::steady_clock::time_point(std::chrono::nanoseconds(m_nLastStepNs.load(std::memory_order_acquire)));
+}
+
+bool ClockControl::CheckSlew()
+{
+    timeval tvOld;
+    if(adjtime(nullptr, &tvOld) != 0)
+    {   //leave it as it was rather than have the servo think a slew finished when we can't tell
+        logAsync(pml::LOG_ERROR, "Failed to read offset ", strerror(errno));
+        return IsSlewPending();
+    }
+    bool bPending = (tvOld.tv_sec != 0 || tvOld.tv_usec != 0);
+    m_bSlewPending.store(bPending, std::memory_order_release);
+    return bPending;
+}
+
+void ClockControl::Slew(double dOffset)
+{
+    double dSec;
+    double dMicro = modf(dOffset, &dSec);
+    dMicro*=1e6;
+    timeval tv, tvOld;
+    tv.tv_sec = dSec;
+    tv.tv_usec = dMicro;
+    if(adjtime(&tv, &tvOld) != 0)
+    {
+        logAsync(pml::LOG_ERROR, "Failed to adjtime ", strerror(errno));
+    }
+    else
+    {
+        logAsync(pml::LOG_INFO, "Time adjusted by ", tv.tv_sec, "s and ", tv.tv_usec, "us", "\tLeft ", tvOld.tv_sec, "s and ", tvOld.tv_usec, "us");
+    }
+}
+
+void ClockControl::ChangeFrequency(double dPPM)
+{
+    //change the frequency to get the slope to 0
+    timex buf;
+    memset(&buf, 0,sizeof(buf));
+    if(adjtimex(&buf) == -1)
+    {
+        logAsync(pml::LOG_ERROR, "Failed to read frequency ", strerror(errno));
+        return;
+    }
+    logAsync(pml::LOG_INFO, "Old freq=", buf.freq);
+
+
+    double dOffsetFreq = dPPM*65535.0;
+    buf.freq += dOffsetFreq;
+    buf.modes = ADJ_FREQUENCY;
+
+
+
+    if(adjtimex(&buf) == -1)
+    {
+        logAsync(pml::LOG_ERROR, "Failed to set frequency ", strerror(errno));
+        return;
+    }
+
+    logAsync(pml::LOG_INFO, "New freq=", buf.freq);
+}
+
+void ClockControl::Step(double dOffset)
+{
+
+    logAsync(pml::LOG_INFO, "CrashTime: ", dOffset);
+    auto now = std::chrono::system_clock::now();
+
+    logAsync(pml::LOG_INFO, "TimeWas: ", now);
+
+    now += DoubleToMicro(dOffset);
+
+    logAsync(pml::LOG_INFO, "TimeWillbe: ", now);
+
+    timespec ts;
+    ts.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+    ts.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count() % 1000000000;
+
+
+    if(clock_settime(CLOCK_REALTIME, &ts) != 0)
+    {
+        logAsync(pml::LOG_ERROR, "Failed to hard crash ", strerror(errno));
+        return;
+    }
+    m_nLastStepNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(), std::memory_order_release);
+    m_nSteps.fetch_add(1, std::memory_order_acq_rel);
+
+    logAsync(pml::LOG_INFO, "Hard crashed to ", std::chrono::system_clock::now());
+
+}
@@ -0,0 +1,336 @@
+#include "config.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <sched.h>
+
+const std::string Config::DEFAULT_PATH = "/etc/ltcclient.conf";
+
+namespace
+{
+    const std::string STR_STAGE[Pipeline::STAGES] = {"capture", "decode", "estimate", "clock"};
+
+    //the limits of what is accepted, set wide: they are only there to keep out values that would stop the client working at all
+    const unsigned long MIN_SAMPLE_RATE = 8000;
+    const unsigned long MAX_SAMPLE_RATE = 384000;
+    const unsigned long MAX_CHANNELS = 64;
+    const int MAX_DECODER_QUEUE = 4096;
+    const unsigned long MAX_CAPTURE_BUFFER = 65536;
+    const double MAX_LATENCY = 2.0;                     //seconds
+    const long long MAX_SLACK_US = 1000000;
+    const int MAX_PRIORITY = 99;                        //SCHED_FIFO
+    const unsigned long long MAX_RECORDER_CAPACITY = 1ULL << 32;
+    const size_t MAX_WINDOW = 100000;                   //frames, about an hour at 30fps
+    const double MAX_STEP_THRESHOLD = 86400.0;          //seconds
+    const double MAX_PPM = 500.0;                       //as far as the kernel will slew
+    const double MIN_METRICS_INTERVAL = 0.1;            //seconds
+    const double MAX_METRICS_INTERVAL = 86400.0;
+
+    std::string Trim(const std::string& str)
+    {
+        auto nStart = str.find_first_not_of(" \t\r\n");
+        if(nStart == std::string::npos)
+        {
+            return std::string();
+        }
+        return str.substr(nStart, str.find_last_not_of(" \t\r\n")-nStart+1);
+    }
+
+    template<typename T> bool FromString(const std::string& sValue, T& value)
+    {
+        std::istringstream is(sValue);
+        T read;
+        is >> read;
+        if(is.fail() || (is >> std::ws).eof() == false)
+        {
+            return false;
+        }
+        value = read;
+        return true;
+    }
+
+    bool FromString(const std::string& sValue, bool& bValue)
+    {
+        if(sValue == "true" || sValue == "yes" || sValue == "on" || sValue == "1")
+        {
+            bValue = true;
+            return true;
+        }
+        if(sValue == "false" || sValue == "no" || sValue == "off" || sValue == "0")
+        {
+            bValue = false;
+            return true;
+        }
+        return false;
+    }
+
+    bool FromString(const std::string& sValue, std::string& str)
+    {
+        str = sValue;
+        return true;
+    }
+
+    //enough digits that what is written reads back the same, without 0.8 turning in to 0.80000000000000004
+    template<typename T> std::string ToString(const T& value)
+    {
+        std::ostringstream os;
+        os << std::setprecision(15) << value;
+        return os.str();
+    }
+
+    std::string ToString(const bool& bValue)
+    {
+        return bValue ? "true" : "false";
+    }
+}
+
+Config::Config() : m_sPath(DEFAULT_PATH), m_bPathGiven(false)
+{
+    m_vSettings.push_back({"source", false, "An LTC source: an ALSA device, file:<wav file> or pa:<PortAudio index>, then @<channel>. May be given more than once. "
+                                            "No sources uses pa:0",
+                           [this](const std::string& sValue){ vSources.push_back(sValue); return true;},
+                           [this](){
+                                std::string sJoined;
+                                for(const auto& sSource : vSources)
+                                {
+                                    sJoined += (sJoined.empty() ? "" : " ")+sSource;
+                                }
+                                return sJoined;
+                            }});
+    Bind("combine", bCombine, false, "Combine the offsets of all the sources that agree rather than following one");
+    Bind("sample_rate", nSampleRate, MIN_SAMPLE_RATE, MAX_SAMPLE_RATE, false, "Capture sample rate, Hz");
+    Bind("channels", nChannels, 1UL, MAX_CHANNELS, false, "Channels opened on each device, at least one more than the highest LTC channel is always opened");
+    Bind("decoder.queue", nDecoderQueue, 2, MAX_DECODER_QUEUE, false, "Frames each decoder can hold between audio blocks");
+    Bind("capture.buffer", nCaptureBuffer, AudioSource::BUFFER_AUTO, MAX_CAPTURE_BUFFER, false, "Frames per capture block, 0 to tune it automatically");
+    Bind("capture.latency", dCaptureLatency, 0.0, MAX_LATENCY, false, "Suggested capture latency, seconds. 0 for the device default");
+    BindChoice("decode.wakeup", eWakeup, {"notify", "deadline"}, false, "How the decode stage waits for audio");
+    Bind("decode.watermark", nWatermark, 1UL, static_cast<unsigned long>(LtcSource::CAPTURE_QUEUE_SIZE), false, "Blocks queued for the decode stage before the capture stage wakes it");
+    Bind("decode.slack_us", nSlackUs, 0LL, MAX_SLACK_US, false, "How long after a block is due the decode stage wakes up for it, deadline wakeup only");
+    Bind("realtime", bRealtime, false, "Lock memory and run every stage SCHED_FIFO");
+    for(int i = 0; i < Pipeline::STAGES; i++)
+    {
+        Bind(STR_STAGE[i]+".priority", stage[i].nPriority, 0, MAX_PRIORITY, false, "SCHED_FIFO priority of the "+STR_STAGE[i]+" stage, 0 for the default");
+        Bind(STR_STAGE[i]+".cpu", stage[i].nCpu, -1, CPU_SETSIZE-1, false, "Core the "+STR_STAGE[i]+" stage runs on, -1 for any");
+    }
+    Bind("recorder.path", sRecorderPath, false, "Ring file every decoded frame is recorded in, empty for none");
+    Bind("recorder.capacity", nRecorderCapacity, 1ULL, MAX_RECORDER_CAPACITY, false, "Frames the recorder holds");
+    Bind("metrics.endpoint", sMetricsEndpoint, false, "Localhost TCP port or unix:<path> the metrics are served on, empty for none");
+    Bind("daemon", bDaemon, false, "Detach from the terminal and run in the background");
+    Bind("pid_file", sPidFile, false, "File the process id is written to, empty for none");
+    Bind("control.socket", sControlSocket, false, "Unix socket the client can be queried and steered on, empty for none");
+
+    Bind("servo.window", servo.nWindow, static_cast<size_t>(2), MAX_WINDOW, true, "Frames in each regression");
+    Bind("servo.step_threshold", servo.dStepThreshold, 0.0, MAX_STEP_THRESHOLD, true, "Average offset, seconds, above which the clock is stepped rather than slewed");
+    Bind("servo.slew_ppm", servo.dSlewPPM, 0.0, MAX_PPM, true, "Frequency error within which the offset is corrected");
+    Bind("servo.sync_ppm", servo.dSyncPPM, 0.0, MAX_PPM, true, "Frequency error within which the clock is called synced");
+    Bind("servo.sync_intercept", servo.dSyncIntercept, 0.0, MAX_STEP_THRESHOLD, true, "Regression intercept, seconds, within which the clock is called synced");
+    Bind("select.tolerance", dSelectTolerance, 0.0, MAX_STEP_THRESHOLD, true, "Disagreement, seconds, allowed between sources before one is called a falseticker");
+    Bind("metrics.interval", dMetricsInterval, MIN_METRICS_INTERVAL, MAX_METRICS_INTERVAL, true, "Seconds between the metrics being logged");
+    BindChoice("log.level", eLogLevel, {"trace", "debug", "info", "warn", "error", "critical"}, true, "Lowest level the pipeline threads log at");
+}
+
+template<typename T> void Config::Bind(const std::string& sKey, T& value, bool bLive, const std::string& sHelp)
+{
+    m_vSettings.push_back({sKey, bLive, sHelp, [&value](const std::string& sValue){ return FromString(sValue, value);}, [&value](){ return ToString(value);}});
+}
+
+template<typename T> void Config::Bind(const std::string& sKey, T& value, T min, T max, bool bLive, const std::string& sHelp)
+{
+    m_vSettings.push_back({sKey, bLive, sHelp,
+                           [&value, min, max](const std::string& sValue){
+                                T read;
+                                if(FromString(sValue, read) == false || read < min || read > max)
+                                {
+                                    return false;
+                                }
+                                value = read;
+                                return true;
+                            },
+                           [&value](){ return ToString(value);},
+                           "from "+ToString(min)+" to "+ToString(max)});
+}
+
+template<typename E> void Config::BindChoice(const std::string& sKey, E& eValue, const std::vector<std::string>& vChoices, bool bLive, const std::string& sHelp)
+{
+    std::string sChoices;
+    for(const auto& sChoice : vChoices)
+    {
+        sChoices += (sChoices.empty() ? "" : "|")+sChoice;
+    }
+
+    m_vSettings.push_back({sKey, bLive, sHelp+": "+sChoices,
+                           [&eValue, vChoices](const std::string& sValue){
+                                auto itChoice = std::find(vChoices.begin(), vChoices.end(), sValue);
+                                if(itChoice == vChoices.end())
+                                {
+                                    return false;
+                                }
+                                eValue = static_cast<E>(itChoice-vChoices.begin());
+                                return true;
+                            },
+                           [&eValue, vChoices](){ return static_cast<size_t>(eValue) < vChoices.size() ? vChoices[eValue] : std::to_string(eValue);}});
+}
+
+bool Config::Load(int argc, char* argv[])
+{
+    static const std::string CONFIG = "--config=";
+
+    m_vArgs.assign(argv+1, argv+argc);
+    for(const auto& sArg : m_vArgs)
+    {
+        if(sArg.compare(0, CONFIG.size(), CONFIG) == 0)
+        {
+            m_sPath = sArg.substr(CONFIG.size());
+            m_bPathGiven = true;
+        }
+    }
+    return ReadFile(!m_bPathGiven) && ReadArgs();
+}
+
+bool Config::Reload()
+{
+    Config fresh;
+    fresh.m_sPath = m_sPath;
+    fresh.m_bPathGiven = m_bPathGiven;
+    fresh.m_vArgs = m_vArgs;
+    if(fresh.ReadFile(!m_bPathGiven) == false || fresh.ReadArgs() == false)
+    {
+        pmlLog(pml::LOG_ERROR) << "Config\tReload of " << m_sPath << " failed. Settings left as they were";
+        return false;
+    }
+
+    for(size_t i = 0; i < m_vSettings.size(); i++)
+    {
+        auto sOld = m_vSettings[i].get();
+        auto sNew = fresh.m_vSettings[i].get();
+        if(sNew == sOld)
+        {
+            continue;
+        }
+        if(m_vSettings[i].bLive)
+        {
+            m_vSettings[i].set(sNew);
+            pmlLog() << "Config\t" << m_vSettings[i].sKey << " changed from " << sOld << " to " << sNew;
+        }
+        else
+        {
+            pmlLog(pml::LOG_WARN) << "Config\t" << m_vSettings[i].sKey << " changed to " << sNew << " but won't be used until restarted";
+        }
+    }
+    return true;
+}
+
+bool Config::ReadFile(bool bMissingOk)
+{
+    std::ifstream ifs(m_sPath);
+    if(ifs.is_open() == false)
+    {
+        if(bMissingOk)
+        {
+            return true;
+        }
+        pmlLog(pml::LOG_ERROR) << "Config\tCould not open " << m_sPath;
+        return false;
+    }
+
+    std::string sSection;
+    std::string sLine;
+    for(size_t nLine = 1; std::getline(ifs, sLine); nLine++)
+    {
+        sLine = Trim(sLine.substr(0, sLine.find('#')));
+        if(sLine.empty())
+        {
+            continue;
+        }
+
+        std::string sWhere = m_sPath+":"+std::to_string(nLine);
+        if(sLine.front() == '[' && sLine.back() == ']')
+        {
+            sSection = Trim(sLine.substr(1, sLine.size()-2));
+            continue;
+        }
+
+        auto nEquals = sLine.find('=');
+        if(nEquals == std::string::npos)
+        {
+            pmlLog(pml::LOG_ERROR) << "Config\t" << sWhere << "\tExpected key = value";
+            return false;
+        }
+        auto sKey = Trim(sLine.substr(0, nEquals));
+        if(Set(sSection.empty() ? sKey : sSection+"."+sKey, Trim(sLine.substr(nEquals+1)), sWhere) == false)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Config::ReadArgs()
+{
+    std::vector<std::string> vArgSources;
+    for(const auto& sArg : m_vArgs)
+    {
+        if(sArg.compare(0, 2, "--") != 0)
+        {
+            vArgSources.push_back(sArg);
+            continue;
+        }
+
+        auto nEquals = sArg.find('=');
+        auto sKey = sArg.substr(2, nEquals == std::string::npos ? std::string::npos : nEquals-2);
+        if(sKey == "config")
+        {
+            continue;
+        }
+        if(Set(sKey, nEquals == std::string::npos ? "true" : sArg.substr(nEquals+1), "command line") == false)
+        {
+            return false;
+        }
+    }
+
+    if(vArgSources.empty() == false)
+    {
+        vSources = vArgSources;
+    }
+    return true;
+}
+
+bool Config::Set(const std::string& sKey, const std::string& sValue, const std::string& sWhere)
+{
+    auto itSetting = std::find_if(m_vSettings.begin(), m_vSettings.end(), [&sKey](const setting& s){ return s.sKey == sKey;});
+    if(itSetting == m_vSettings.end())
+    {
+        pmlLog(pml::LOG_ERROR) << "Config\t" << sWhere << "\tUnknown setting " << sKey;
+        return false;
+    }
+    if(itSetting->set(sValue) == false)
+    {
+        pmlLog(pml::LOG_ERROR) << "Config\t" << sWhere << "\t'" << sValue << "' is not a valid " << sKey
+                               << (itSetting->sRange.empty() ? std::string() : ": it must be "+itSetting->sRange);
+        return false;
+    }
+    return true;
+}
+
+void Config::Log() const
+{
+    for(const auto& s : m_vSettings)
+    {
+        pmlLog() << "Config\t" << s.sKey << "=" << s.get();
+    }
+}
+
+void Config::Usage(std::ostream& os)
+{
+    Config defaults;
+    os << "ltcclient [--config=<path>] [--<key>=<value>...] [source...]" << std::endl;
+    os << "ltcclient generate [device] [fps] [smpte|bbc|tve|mtd] [--<key>=<value>...]" << std::endl;
+    os << "ltcclient probe [seconds] [scan]" << std::endl << std::endl;
+    os << "Settings are read from " << DEFAULT_PATH << " if it exists, as key = value lines. Those marked * are taken up again on SIGHUP" << std::endl;
+    for(const auto& s : defaults.m_vSettings)
+    {
+        os << "  " << (s.bLive ? "* " : "  ") << std::left << std::setw(24) << s.sKey << s.sHelp << (s.sRange.empty() ? "" : ", "+s.sRange)
+           << ". Default: " << s.get() << std::endl;
+    }
+}
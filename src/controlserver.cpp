@@ -0,0 +1,332 @@
+#include "controlserver.h"
+#include "pipeline.h"
+#include "log.h"
+#include "utils.h"
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+
+namespace
+{
+    const int POLL_MS = 500;            //how often the server thread checks whether it should stop
+    const int IDLE_TIMEOUT_MS = 30000;  //a client that sends nothing for this long is dropped so others can connect
+    const size_t MAX_LINE = 256;
+    const int BACKLOG = 4;
+    const mode_t SOCKET_MODE = 0660;    //our user and group only
+
+    std::string Quote(const std::string& str)
+    {
+        std::string sQuoted("\"");
+        for(char c : str)
+        {
+            if(c == '"' || c == '\\')
+            {
+                sQuoted += '\\';
+            }
+            sQuoted += (static_cast<unsigned char>(c) < 0x20 ? ' ' : c);
+        }
+        return sQuoted+"\"";
+    }
+
+    std::string ToTimecode(const LTCFrame& frame)
+    {
+        std::ostringstream ss;
+        ss << std::setfill('0') << std::setw(2) << (frame.hours_tens*10 + frame.hours_units) << ":"
+           << std::setw(2) << (frame.mins_tens*10 + frame.mins_units) << ":"
+           << std::setw(2) << (frame.secs_tens*10 + frame.secs_units) << (frame.dfbit ? ";" : ":")
+           << std::setw(2) << (frame.frame_tens*10 + frame.frame_units);
+        return ss.str();
+    }
+
+    std::string Error(const std::string& sError)
+    {
+        return "{\"ok\":false,\"error\":"+Quote(sError)+"}";
+    }
+}
+
+ControlServer::ControlServer(Pipeline& pipeline) :
+    m_pipeline(pipeline),
+    m_nListen(-1),
+    m_bRun(false)
+{
+
+}
+
+ControlServer::~ControlServer()
+{
+    Stop();
+}
+
+bool ControlServer::Start(const std::string& sPath)
+{
+    m_nListen = Listen(sPath);
+    if(m_nListen < 0)
+    {
+        return false;
+    }
+    pmlLog() << "ControlServer\tListening on " << sPath;
+
+    m_bRun = true;
+    m_thServer = std::thread(&ControlServer::ServerThread, this);
+    return true;
+}
+
+void ControlServer::Stop()
+{
+    if(m_bRun)
+    {
+        m_bRun = false;
+        m_thServer.join();
+    }
+    if(m_nListen >= 0)
+    {
+        close(m_nListen);
+        m_nListen = -1;
+    }
+    if(m_sPath.empty() == false)
+    {
+        unlink(m_sPath.c_str());
+        m_sPath.clear();
+    }
+}
+
+int ControlServer::Listen(const std::string& sPath)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(sPath.empty() || sPath.size() >= sizeof(addr.sun_path))
+    {
+        pmlLog(pml::LOG_ERROR) << "ControlServer\tInvalid socket path '" << sPath << "'";
+        return -1;
+    }
+    strncpy(addr.sun_path, sPath.c_str(), sizeof(addr.sun_path)-1);
+
+    int nError(0);
+    int nSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(nSocket >= 0)
+    {
+        unlink(sPath.c_str());  //left behind if we were killed last time
+        nError = bind(nSocket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        if(nError == 0)
+        {
+            m_sPath = sPath;
+            nError = chmod(sPath.c_str(), SOCKET_MODE);
+        }
+    }
+
+    if(nSocket < 0 || nError != 0 || listen(nSocket, BACKLOG) != 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "ControlServer\tFailed to listen on " << sPath << ": " << strerror(errno);
+        if(nSocket >= 0)
+        {
+            close(nSocket);
+        }
+        return -1;
+    }
+    return nSocket;
+}
+
+void ControlServer::ServerThread()
+{
+    pollfd pfd;
+    pfd.fd = m_nListen;
+    pfd.events = POLLIN;
+    while(m_bRun)
+    {
+        if(poll(&pfd, 1, POLL_MS) <= 0 || (pfd.revents & POLLIN) == 0)
+        {
+            continue;
+        }
+        int nClient = accept4(m_nListen, nullptr, nullptr, SOCK_CLOEXEC);
+        if(nClient >= 0)
+        {
+            if(IsAllowed(nClient))
+            {
+                Serve(nClient);
+            }
+            close(nClient);
+        }
+    }
+}
+
+bool ControlServer::IsAllowed(int nClient) const
+{
+    //the socket's mode should already have kept anyone else out, but it is briefly open to them between bind and chmod
+    ucred cred;
+    socklen_t nLength = sizeof(cred);
+    if(getsockopt(nClient, SOL_SOCKET, SO_PEERCRED, &cred, &nLength) != 0)
+    {
+        pmlLog(pml::LOG_WARN) << "ControlServer\tCould not tell who connected: " << strerror(errno);
+        return false;
+    }
+    if(cred.uid != 0 && cred.uid != geteuid() && cred.gid != getegid())
+    {
+        pmlLog(pml::LOG_WARN) << "ControlServer\tRefused connection from pid " << cred.pid << " uid " << cred.uid;
+        return false;
+    }
+    return true;
+}
+
+void ControlServer::Serve(int nClient)
+{
+    std::string sBuffer;
+    char buffer[256];
+    pollfd pfd;
+    pfd.fd = nClient;
+    pfd.events = POLLIN;
+    int nIdleMs(0);
+    while(m_bRun && nIdleMs < IDLE_TIMEOUT_MS)
+    {
+        int nReady = poll(&pfd, 1, POLL_MS);
+        if(nReady < 0 && errno != EINTR)
+        {
+            return;
+        }
+        if(nReady <= 0)
+        {
+            nIdleMs += POLL_MS;
+            continue;
+        }
+        nIdleMs = 0;
+
+        ssize_t nRead = recv(nClient, buffer, sizeof(buffer), 0);
+        if(nRead <= 0)
+        {
+            return;
+        }
+        sBuffer.append(buffer, nRead);
+
+        for(auto nEnd = sBuffer.find('\n'); nEnd != std::string::npos; nEnd = sBuffer.find('\n'))
+        {
+            std::string sReply = Execute(sBuffer.substr(0, nEnd))+"\n";
+            sBuffer.erase(0, nEnd+1);
+            if(send(nClient, sReply.data(), sReply.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(sReply.size()))
+            {
+                return;
+            }
+        }
+        if(sBuffer.size() > MAX_LINE)
+        {
+            std::string sReply = Error("line too long")+"\n";
+            send(nClient, sReply.data(), sReply.size(), MSG_NOSIGNAL);
+            return;
+        }
+    }
+}
+
+std::string ControlServer::Execute(const std::string& sLine)
+{
+    std::istringstream is(sLine);
+    std::string sCommand;
+    std::string sArgument;
+    is >> sCommand >> sArgument;
+
+    if(sCommand == "status")
+    {
+        return Status();
+    }
+    if(sCommand == "source")
+    {
+        return PinSource(sArgument);
+    }
+    if(sCommand == "relock")
+    {
+        pmlLog(pml::LOG_WARN) << "ControlServer\tRelock";
+        m_pipeline.Relock();
+        return "{\"ok\":true}";
+    }
+    if(sCommand == "pause" || sCommand == "resume")
+    {
+        if(m_pipeline.IsDisciplinePaused() != (sCommand == "pause"))
+        {
+            pmlLog(pml::LOG_WARN) << "ControlServer\tClock discipline " << (sCommand == "pause" ? "paused" : "resumed");
+            m_pipeline.PauseDiscipline(sCommand == "pause");
+        }
+        return "{\"ok\":true,\"paused\":"+std::string(m_pipeline.IsDisciplinePaused() ? "true" : "false")+"}";
+    }
+    if(sCommand == "help")
+    {
+        return "{\"ok\":true,\"commands\":[\"status\",\"source <index|name|auto>\",\"relock\",\"pause\",\"resume\"]}";
+    }
+    return Error("unknown command '"+sCommand+"'");
+}
+
+std::string ControlServer::Status() const
+{
+    auto state = m_pipeline.GetState();
+    size_t nActive = m_pipeline.GetActiveSource();
+    size_t nPinned = m_pipeline.GetPinnedSource();
+
+    std::ostringstream os;
+    os << std::setprecision(10);    //enough for microseconds in an offset of hours
+    os << "{\"ok\":true";
+    if(state.nFrames != 0)
+    {
+        os << ",\"timecode\":" << Quote(ToTimecode(state.frame))
+           << ",\"ltc\":" << Quote(ConvertTimeToIsoString(std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(state.nLtcNs)))))
+           << ",\"fps\":" << state.dFPS
+           << ",\"offset\":" << state.dOffset
+           << ",\"ppm\":" << state.dPPM
+           << ",\"level\":" << state.fVolume;
+    }
+    os << ",\"frames\":" << state.nFrames
+       << ",\"locked\":" << (m_pipeline.IsLocked() ? "true" : "false")
+       << ",\"synced\":" << (state.bSynced ? "true" : "false")
+       << ",\"paused\":" << (m_pipeline.IsDisciplinePaused() ? "true" : "false")
+       << ",\"combined\":" << (state.bCombined ? "true" : "false")
+       << ",\"active\":" << Quote(m_pipeline.GetSource(nActive).GetName())
+       << ",\"pinned\":" << (nPinned < m_pipeline.GetSourceCount() ? Quote(m_pipeline.GetSource(nPinned).GetName()) : std::string("null"))
+       << ",\"sources\":[";
+    for(size_t i = 0; i < m_pipeline.GetSourceCount(); i++)
+    {
+        const LtcSource& source(m_pipeline.GetSource(i));
+        os << (i == 0 ? "" : ",") << "{\"name\":" << Quote(source.GetName())
+           << ",\"offset\":" << source.GetOffset()
+           << ",\"jitter\":" << source.GetJitter();
+        if(m_pipeline.GetSourceCount() > 1)
+        {   //the selector only runs with more than one
+            os << ",\"state\":" << Quote(SourceSelector::STR_STATE[m_pipeline.GetSourceState(i)]);
+        }
+        os << "}";
+    }
+    os << "]}";
+    return os.str();
+}
+
+std::string ControlServer::PinSource(const std::string& sSource)
+{
+    size_t nSource = Pipeline::NO_SOURCE;
+    if(sSource.empty())
+    {
+        return Error("source needs an index, a name or auto");
+    }
+    if(sSource != "auto")
+    {
+        char* pEnd(nullptr);
+        unsigned long nIndex = strtoul(sSource.c_str(), &pEnd, 10);
+        nSource = (*pEnd == '\0') ? nIndex : Pipeline::NO_SOURCE;
+        for(size_t i = 0; nSource == Pipeline::NO_SOURCE && i < m_pipeline.GetSourceCount(); i++)
+        {
+            if(m_pipeline.GetSource(i).GetName() == sSource)
+            {
+                nSource = i;
+            }
+        }
+        if(nSource >= m_pipeline.GetSourceCount())
+        {
+            return Error("no source '"+sSource+"'");
+        }
+    }
+
+    m_pipeline.PinSource(nSource);
+    pmlLog(pml::LOG_WARN) << "ControlServer\t" << (nSource == Pipeline::NO_SOURCE ? std::string("Source chosen by the selector") : "Source pinned to "+m_pipeline.GetSource(nSource).GetName());
+    return "{\"ok\":true,\"pinned\":"+(nSource == Pipeline::NO_SOURCE ? std::string("null") : Quote(m_pipeline.GetSource(nSource).GetName()))+"}";
+}
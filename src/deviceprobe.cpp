@@ -0,0 +1,414 @@
+#include "deviceprobe.h"
+#include "portaudio.h"
+#include <alsa/asoundlib.h>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+
+const std::vector<unsigned long> DeviceProbe::SAMPLE_RATES = {44100, 48000, 88200, 96000, 176400, 192000};
+const std::vector<unsigned long> DeviceProbe::BUFFER_SIZES = {64, 128, 256, 512, 1024, 2048, 4096, 8192};
+
+namespace
+{
+    const std::chrono::milliseconds POLL_INTERVAL(5);  //the block times come from when they were queued so polling adds no error to them
+
+    std::string Escape(const std::string& str)
+    {
+        std::string sEscaped;
+        for(char c : str)
+        {
+            switch(c)
+            {
+                case '"':
+                    sEscaped += "\\\"";
+                    break;
+                case '\\':
+                    sEscaped += "\\\\";
+                    break;
+                case '\n':
+                    sEscaped += "\\n";
+                    break;
+                case '\t':
+                    sEscaped += "\\t";
+                    break;
+                default:
+                    if(static_cast<unsigned char>(c) >= 0x20)
+                    {
+                        sEscaped += c;
+                    }
+            }
+        }
+        return sEscaped;
+    }
+
+    template<typename T> void WriteArray(std::ostream& os, const std::vector<T>& vValues)
+    {
+        os << "[";
+        for(size_t i = 0; i < vValues.size(); i++)
+        {
+            os << (i ? ", " : "") << vValues[i];
+        }
+        os << "]";
+    }
+
+    //the rate the client would be run at if the device has it
+    unsigned long PickRate(const std::vector<unsigned long>& vRates)
+    {
+        auto itRate = std::find_if(vRates.begin(), vRates.end(), [](unsigned long nRate){ return nRate == DeviceProbe::PREFERRED_RATE;});
+        return itRate != vRates.end() ? *itRate : vRates.front();
+    }
+
+    //ALSA's hints come back as strings that must be freed
+    std::string GetHint(const void* pHint, const char* sId)
+    {
+        char* pValue = snd_device_name_get_hint(pHint, sId);
+        if(pValue == nullptr)
+        {
+            return std::string();
+        }
+        std::string sValue(pValue);
+        free(pValue);
+        std::replace(sValue.begin(), sValue.end(), '\n', ' ');
+        return sValue;
+    }
+}
+
+DeviceProbe::DeviceProbe(std::chrono::milliseconds duration, bool bScan) :
+    m_duration(duration),
+    m_bScan(bScan)
+{
+}
+
+void DeviceProbe::Run()
+{
+    m_vDevices.clear();
+    if(Pa_Initialize() == paNoError)
+    {
+        FindPortAudio();
+        for(auto& device : m_vDevices)
+        {
+            Measure(device);
+        }
+        Pa_Terminate();
+    }
+
+    size_t nPortAudio = m_vDevices.size();
+    FindAlsa();
+    for(size_t i = nPortAudio; i < m_vDevices.size(); i++)
+    {
+        Measure(m_vDevices[i]);
+    }
+}
+
+void DeviceProbe::FindPortAudio()
+{
+    for(PaDeviceIndex nDevice = 0; nDevice < Pa_GetDeviceCount(); nDevice++)
+    {
+        const PaDeviceInfo* pInfo = Pa_GetDeviceInfo(nDevice);
+        if(pInfo == nullptr || pInfo->maxInputChannels <= 0)
+        {
+            continue;
+        }
+
+        deviceprobe device;
+        device.eBackend = LtcSource::PORTAUDIO;
+        device.sDevice = "pa:"+std::to_string(nDevice);
+        device.sName = pInfo->name ? pInfo->name : "";
+        const PaHostApiInfo* pApi = Pa_GetHostApiInfo(pInfo->hostApi);
+        device.sHostApi = (pApi && pApi->name) ? pApi->name : "";
+        device.nMaxChannels = pInfo->maxInputChannels;
+        device.dDefaultLowLatency = pInfo->defaultLowInputLatency;
+        device.dDefaultHighLatency = pInfo->defaultHighInputLatency;
+
+        //the same as AudioInput opens
+        PaStreamParameters params;
+        params.device = nDevice;
+        params.channelCount = std::min(pInfo->maxInputChannels, 2);
+        params.sampleFormat = paFloat32;
+        params.suggestedLatency = pInfo->defaultLowInputLatency;
+        params.hostApiSpecificStreamInfo = nullptr;
+        for(auto nRate : SAMPLE_RATES)
+        {
+            if(Pa_IsFormatSupported(&params, nullptr, nRate) == paFormatIsSupported)
+            {
+                device.vSampleRates.push_back(nRate);
+            }
+        }
+
+        //PortAudio has no way to ask about buffer sizes short of opening a stream. It is never started
+        if(device.vSampleRates.empty() == false)
+        {
+            unsigned long nRate = PickRate(device.vSampleRates);
+            for(auto nFrames : BUFFER_SIZES)
+            {
+                PaStream* pStream(nullptr);
+                if(Pa_OpenStream(&pStream, &params, nullptr, nRate, nFrames, paNoFlag, nullptr, nullptr) == paNoError)
+                {
+                    device.vBufferSizes.push_back(nFrames);
+                    Pa_CloseStream(pStream);
+                }
+            }
+        }
+        m_vDevices.push_back(device);
+    }
+}
+
+void DeviceProbe::FindAlsa()
+{
+    void** ppHints(nullptr);
+    if(snd_device_name_hint(-1, "pcm", &ppHints) != 0)
+    {
+        return;
+    }
+
+    for(void** ppHint = ppHints; *ppHint != nullptr; ppHint++)
+    {
+        auto sIo = GetHint(*ppHint, "IOID");   //none means both
+        auto sName = GetHint(*ppHint, "NAME");
+        if(sIo == "Output" || sName.empty() || sName == "null")
+        {
+            continue;
+        }
+
+        deviceprobe device;
+        device.eBackend = LtcSource::ALSA;
+        device.sDevice = sName;
+        device.sName = GetHint(*ppHint, "DESC");
+        device.sHostApi = "ALSA";
+
+        snd_pcm_t* pPcm(nullptr);
+        int nError = snd_pcm_open(&pPcm, sName.c_str(), SND_PCM_STREAM_CAPTURE, SND_PCM_NONBLOCK);
+        if(nError < 0)
+        {
+            device.sError = snd_strerror(nError);
+            m_vDevices.push_back(device);
+            continue;
+        }
+
+        snd_pcm_hw_params_t* pParams(nullptr);
+        snd_pcm_hw_params_malloc(&pParams);
+        snd_pcm_hw_params_any(pPcm, pParams);
+        if(snd_pcm_hw_params_test_access(pPcm, pParams, SND_PCM_ACCESS_MMAP_INTERLEAVED) != 0)
+        {   //AlsaInput only captures by mmap
+            device.sError = "no mmap interleaved access";
+        }
+        else
+        {
+            unsigned int nChannels(0);
+            snd_pcm_hw_params_get_channels_max(pParams, &nChannels);
+            device.nMaxChannels = nChannels;
+            for(auto nRate : SAMPLE_RATES)
+            {
+                if(snd_pcm_hw_params_test_rate(pPcm, pParams, nRate, 0) == 0)
+                {
+                    device.vSampleRates.push_back(nRate);
+                }
+            }
+            for(auto nFrames : BUFFER_SIZES)
+            {
+                if(snd_pcm_hw_params_test_period_size(pPcm, pParams, nFrames, 0) == 0)
+                {
+                    device.vBufferSizes.push_back(nFrames);
+                }
+            }
+        }
+        snd_pcm_hw_params_free(pParams);
+        snd_pcm_close(pPcm);
+        m_vDevices.push_back(device);
+    }
+    snd_device_name_free_hint(ppHints);
+}
+
+void DeviceProbe::Measure(deviceprobe& device)
+{
+    if(device.sError.empty() == false)
+    {
+        return;
+    }
+    if(device.vSampleRates.empty())
+    {
+        device.sError = "no supported sample rate";
+        return;
+    }
+
+    device.nSampleRate = PickRate(device.vSampleRates);
+    unsigned long nChannels = m_bScan ? std::max(device.nMaxChannels, 1UL) : 1;
+    for(unsigned long nChannel = 0; nChannel < nChannels; nChannel++)
+    {
+        if(Capture(device, static_cast<unsigned char>(nChannel), nChannel == 0) == false)
+        {
+            break;
+        }
+    }
+}
+
+bool DeviceProbe::Capture(deviceprobe& device, unsigned char nChannel, bool bTime)
+{
+    SpscQueue<audioblock> queue(LtcSource::CAPTURE_QUEUE_SIZE);
+    unsigned char nChannels = static_cast<unsigned char>(std::max(std::min(device.nMaxChannels, 2UL), static_cast<unsigned long>(nChannel)+1));
+
+    std::unique_ptr<AudioSource> pInput;
+    if(device.eBackend == LtcSource::ALSA)
+    {
+        pInput = std::make_unique<AlsaInput>(device.sDevice, device.nSampleRate, nChannels, queue);
+    }
+    else
+    {
+        pInput = std::make_unique<AudioInput>(strtoul(device.sDevice.c_str()+3, nullptr, 10), device.nSampleRate, nChannels, queue);
+    }
+    pInput->SetChannel(nChannel);
+    if(pInput->Init() == false)
+    {
+        device.sError = "could not capture from channel "+std::to_string(nChannel);
+        return false;
+    }
+
+    LtcDecoder ltc(device.nSampleRate);
+    ltc.SetCorrelationLock(true);
+    channelscan scan;
+    scan.nChannel = nChannel;
+    LtcDecoder::frameCallback onFrame = [&ltc, &scan](std::chrono::microseconds){
+        scan.nFrames++;
+        scan.dFPS = ltc.GetFPS();
+        scan.dVolume = ltc.GetVolume();
+    };
+
+    //the time between blocks is compared with how much audio each block holds
+    unsigned long long nIntervals(0);
+    double dSum(0.0);
+    double dSumSq(0.0);
+    double dMax(0.0);
+    std::chrono::steady_clock::time_point tpLast;
+
+    audioblock block;
+    std::chrono::steady_clock::time_point tpQueued;
+    auto tpEnd = std::chrono::steady_clock::now()+m_duration;
+    unsigned long long nBlocks(0);
+    while(std::chrono::steady_clock::now() < tpEnd)
+    {
+        std::this_thread::sleep_for(POLL_INTERVAL);
+        while(queue.Pop(block, tpQueued))
+        {
+            if(nBlocks > SETTLE_BLOCKS)
+            {
+                double dInterval = std::chrono::duration<double>(tpQueued-tpLast).count();
+                double dError = dInterval-static_cast<double>(block.frame.second.size())/static_cast<double>(device.nSampleRate);
+                nIntervals++;
+                dSum += dInterval;
+                dSumSq += dError*dError;
+                dMax = std::max(dMax, std::fabs(dError));
+            }
+            tpLast = tpQueued;
+            nBlocks++;
+
+            ltc.DecodeLtc(block.frame, onFrame);
+        }
+    }
+    device.vChannels.push_back(scan);
+
+    if(bTime)
+    {
+        device.bMeasured = true;
+        device.nBufferSize = pInput->GetBufferSize();
+        device.dInputLatency = pInput->GetInputLatency();
+        device.nBlocks = nBlocks;
+        device.dInterval = nIntervals ? dSum/static_cast<double>(nIntervals) : 0.0;
+        device.dJitter = nIntervals ? std::sqrt(dSumSq/static_cast<double>(nIntervals)) : 0.0;
+        device.dMaxJitter = dMax;
+        device.nOverflows = pInput->GetOverflowCount();
+        device.nDiscontinuities = pInput->GetDiscontinuityCount();
+    }
+    return true;
+}
+
+std::string DeviceProbe::GetRecommended() const
+{
+    //prefer a device that is carrying LTC, then the lowest latency, then the steadiest
+    const deviceprobe* pBest(nullptr);
+    unsigned char nBestChannel(0);
+    bool bBestLtc(false);
+    for(const auto& device : m_vDevices)
+    {
+        if(device.bMeasured == false || device.nBlocks == 0)
+        {
+            continue;
+        }
+        auto itLtc = std::find_if(device.vChannels.begin(), device.vChannels.end(), [](const channelscan& scan){ return scan.nFrames > 0;});
+        bool bLtc = itLtc != device.vChannels.end();
+        if(pBest == nullptr || bLtc > bBestLtc ||
+           (bLtc == bBestLtc && (device.dInputLatency < pBest->dInputLatency ||
+                                 (device.dInputLatency == pBest->dInputLatency && device.dJitter < pBest->dJitter))))
+        {
+            pBest = &device;
+            bBestLtc = bLtc;
+            nBestChannel = bLtc ? itLtc->nChannel : 0;
+        }
+    }
+    return pBest ? pBest->sDevice+"@"+std::to_string(nBestChannel) : std::string();
+}
+
+void DeviceProbe::WriteJson(std::ostream& os) const
+{
+    os << "{" << std::endl;
+    os << "  \"devices\": [";
+    for(size_t i = 0; i < m_vDevices.size(); i++)
+    {
+        const deviceprobe& device(m_vDevices[i]);
+        os << (i ? "," : "") << std::endl << "    {" << std::endl;
+        os << "      \"backend\": \"" << (device.eBackend == LtcSource::ALSA ? "alsa" : "portaudio") << "\"," << std::endl;
+        os << "      \"device\": \"" << Escape(device.sDevice) << "\"," << std::endl;
+        os << "      \"name\": \"" << Escape(device.sName) << "\"," << std::endl;
+        os << "      \"host_api\": \"" << Escape(device.sHostApi) << "\"," << std::endl;
+        os << "      \"max_input_channels\": " << device.nMaxChannels << "," << std::endl;
+        if(device.eBackend == LtcSource::PORTAUDIO)
+        {
+            os << "      \"default_low_latency\": " << device.dDefaultLowLatency << "," << std::endl;
+            os << "      \"default_high_latency\": " << device.dDefaultHighLatency << "," << std::endl;
+        }
+        os << "      \"sample_rates\": ";
+        WriteArray(os, device.vSampleRates);
+        os << "," << std::endl << "      \"buffer_sizes\": ";
+        WriteArray(os, device.vBufferSizes);
+        if(device.bMeasured)
+        {
+            os << "," << std::endl << "      \"measured\": {"
+               << "\"sample_rate\": " << device.nSampleRate
+               << ", \"buffer_size\": " << device.nBufferSize
+               << ", \"input_latency\": " << device.dInputLatency
+               << ", \"blocks\": " << device.nBlocks
+               << ", \"interval\": " << device.dInterval
+               << ", \"jitter\": " << device.dJitter
+               << ", \"max_jitter\": " << device.dMaxJitter
+               << ", \"overflows\": " << device.nOverflows
+               << ", \"discontinuities\": " << device.nDiscontinuities << "}";
+        }
+        if(device.vChannels.empty() == false)
+        {
+            os << "," << std::endl << "      \"channels\": [";
+            for(size_t j = 0; j < device.vChannels.size(); j++)
+            {
+                const channelscan& scan(device.vChannels[j]);
+                os << (j ? ", " : "") << "{\"channel\": " << static_cast<int>(scan.nChannel) << ", \"ltc\": " << (scan.nFrames > 0 ? "true" : "false")
+                   << ", \"frames\": " << scan.nFrames << ", \"fps\": " << scan.dFPS << ", \"volume_dbfs\": " << scan.dVolume << "}";
+            }
+            os << "]";
+        }
+        if(device.sError.empty() == false)
+        {
+            os << "," << std::endl << "      \"error\": \"" << Escape(device.sError) << "\"";
+        }
+        os << std::endl << "    }";
+    }
+    os << std::endl << "  ]," << std::endl;
+
+    auto sRecommended = GetRecommended();
+    if(sRecommended.empty())
+    {
+        os << "  \"recommended\": null" << std::endl;
+    }
+    else
+    {
+        os << "  \"recommended\": \"" << Escape(sRecommended) << "\"" << std::endl;
+    }
+    os << "}" << std::endl;
+}
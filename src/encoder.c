@@ -25,10 +25,110 @@
 
 #include "encoder.h"
 
+/**
+ * render the rise-time filtered edge towards each of the two levels.
+ * must be called whenever the levels or the filter change
+ */
+void encoder_update_edges(LTCEncoder *e) {
+	int s;
+	for (s = 0; s < 2; s++) {
+		/* low-pass-filter
+		 * LTC signal should have a rise time of 40 us +/- 10 us.
+		 *
+		 * rise-time means from <10% to >90% of the signal.
+		 * each half-bit starts at 50%, so
+		 * here we need half-of it. (0.000020 sec)
+		 *
+		 * e->cutoff = 1.0 -exp( -1.0 / (sample_rate * .000020 / exp(1.0)) );
+		 */
+		const ltcsnd_sample_t tgtval = s ? e->enc_hi : e->enc_lo;
+		const double tcf =  e->filter_const;
+		ltcsnd_sample_t val = SAMPLE_CENTER;
+		int i;
+		for (i = 0; i < LTC_EDGE_MAX; i++) {
+			const ltcsnd_sample_t prev = val;
+			val = val + tcf * (tgtval - val);
+			e->edge[s][i] = val;
+			if (val == prev) {
+				/* settled: every sample from here on is the same */
+				i++;
+				break;
+			}
+		}
+		e->edge_len[s] = i;
+		for (i = 0; i < e->edge_len[s]; i++) {
+			e->edge_rev[s][i] = e->edge[s][e->edge_len[s]-i-1];
+		}
+	}
+
+	if (e->edge_f) {
+		/* the same filter without the 8 bit quantisation. it never quite settles
+		 * so it is rendered all the way out to the longest half-bit */
+		const double tcf = e->filter_const;
+		double val = 0;
+		int i;
+		for (i = 0; i < e->edge_f_len; i++) {
+			val = (tcf > 0) ? val + tcf * (1.0 - val) : 1.0;
+			e->edge_f[i] = -e->level * val;
+			e->edge_f[e->edge_f_len+i] = e->level * val;
+			e->edge_s16[i] = (short) lrint(-e->level * val * 32767.0);
+			e->edge_s16[e->edge_f_len+i] = (short) lrint(e->level * val * 32767.0);
+		}
+	}
+}
+
+/**
+ * write one filtered half-bit (or whole zero bit) of n float samples
+ */
+static void put_float(const LTCEncoder *e, float *wave, int stride, int n, int state) {
+	const int len = e->edge_f_len;
+	const float * const edge = &e->edge_f[state ? len : 0];
+	const int m = (n+1)>>1;
+	int i;
+	for (i = 0; i < m; i++) {
+		wave[(n-i-1)*stride] = wave[i*stride] = edge[i < len ? i : len-1];
+	}
+}
+
+/**
+ * write one filtered half-bit (or whole zero bit) of n s16 samples
+ */
+static void put_s16(const LTCEncoder *e, short *wave, int stride, int n, int state) {
+	const int len = e->edge_f_len;
+	const short * const edge = &e->edge_s16[state ? len : 0];
+	const int m = (n+1)>>1;
+	int i;
+	for (i = 0; i < m; i++) {
+		wave[(n-i-1)*stride] = wave[i*stride] = edge[i < len ? i : len-1];
+	}
+}
+
+/**
+ * add values to the caller's float or s16 buffer
+ */
+static int addvalues_out(LTCEncoder *e, int n) {
+	if (e->out_offset + n >= e->bufsize) {
+		return 1;
+	}
+
+	if (e->out_format == LTC_ENC_FLOAT) {
+		put_float(e, &((float*)e->out)[e->out_offset * e->out_stride], e->out_stride, n, e->state);
+	} else {
+		put_s16(e, &((short*)e->out)[e->out_offset * e->out_stride], e->out_stride, n, e->state);
+	}
+
+	e->out_offset += n;
+	return 0;
+}
+
 /**
  * add values to the output buffer
  */
 static int addvalues(LTCEncoder *e, int n) {
+	if (e->out_format != LTC_ENC_U8) {
+		return addvalues_out(e, n);
+	}
+
 	const ltcsnd_sample_t tgtval = e->state ? e->enc_hi : e->enc_lo;
 
 	if (e->offset + n >= e->bufsize) {
@@ -39,23 +139,28 @@ static int addvalues(LTCEncoder *e, int n) {
 	}
 
 	ltcsnd_sample_t * const wave = &(e->buf[e->offset]);
-	const double tcf =  e->filter_const;
-	if (tcf > 0) {
-		/* low-pass-filter
-		 * LTC signal should have a rise time of 40 us +/- 10 us.
-		 *
-		 * rise-time means from <10% to >90% of the signal.
-		 * in each call to addvalues() we start at 50%, so
-		 * here we need half-of it. (0.000020 sec)
-		 *
-		 * e->cutoff = 1.0 -exp( -1.0 / (sample_rate * .000020 / exp(1.0)) );
-		 */
-		int i;
-		ltcsnd_sample_t val = SAMPLE_CENTER;
-		int m = (n+1)>>1;
-		for (i = 0 ; i < m ; i++) {
-			val = val + tcf * (tgtval - val);
-			wave[n-i-1] = wave[i] = val;
+	if (e->filter_const > 0) {
+		/* the filtered half-bit is the edge out to the middle, mirrored back to the end.
+		 * the edge only depends on the level it goes to, so it is copied from the ones
+		 * encoder_update_edges() rendered rather than filtered again for every half-bit */
+		const int s = e->state ? 1 : 0;
+		const int len = e->edge_len[s];
+		const ltcsnd_sample_t settled = e->edge[s][len-1];
+		const int m = (n+1)>>1;
+		const int r = n-m;
+
+		if (m <= len) {
+			memcpy(wave, e->edge[s], m);
+		} else {
+			memcpy(wave, e->edge[s], len);
+			memset(wave+len, settled, m-len);
+		}
+
+		if (r <= len) {
+			memcpy(wave+m, e->edge_rev[s]+len-r, r);
+		} else {
+			memset(wave+m, settled, r-len);
+			memcpy(wave+n-len, e->edge_rev[s], len);
 		}
 	} else {
 		/* perfect square wave */
@@ -106,3 +211,41 @@ int encode_byte(LTCEncoder *e, int byte, double speed) {
 
 	return err;
 }
+
+long long encoder_render_offset(LTCEncoder *e, long long halfbit) {
+	return (long long) floor(halfbit * e->samples_per_clock_2 + 0.5);
+}
+
+static void render_values(LTCEncoder *e, enum LTC_ENC_OUTPUT format, void *buf, long long pos, int n, int state) {
+	if (format == LTC_ENC_FLOAT) {
+		put_float(e, &((float*)buf)[pos], 1, n, state);
+	} else {
+		put_s16(e, &((short*)buf)[pos], 1, n, state);
+	}
+}
+
+int encoder_render_frame(LTCEncoder *e, enum LTC_ENC_OUTPUT format, const LTCFrame *f, long long frame, long long base, void *buf, int state) {
+	const unsigned char * const c = (const unsigned char*) f;
+	long long halfbit = frame * 2 * LTC_FRAME_BIT_COUNT;
+	long long pos = encoder_render_offset(e, halfbit);
+	int bit;
+
+	for (bit = 0; bit < LTC_FRAME_BIT_COUNT; bit++) {
+		long long next;
+		state = !state;
+		if ((c[bit>>3] & (1 << (bit&7))) == 0) {
+			next = encoder_render_offset(e, halfbit + 2);
+			render_values(e, format, buf, pos - base, next - pos, state);
+		} else {
+			next = encoder_render_offset(e, halfbit + 1);
+			render_values(e, format, buf, pos - base, next - pos, state);
+			pos = next;
+			state = !state;
+			next = encoder_render_offset(e, halfbit + 2);
+			render_values(e, format, buf, pos - base, next - pos, state);
+		}
+		pos = next;
+		halfbit += 2;
+	}
+	return state;
+}
@@ -0,0 +1,230 @@
+#include "eventrecorder.h"
+#include "log.h"
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const char EventRecorder::MAGIC[8] = {'L','T','C','E','V','R','E','C'};
+
+namespace
+{
+    const std::chrono::seconds FLUSH_INTERVAL(10);
+
+    size_t MapSize(uint64_t nCapacity)
+    {
+        return sizeof(recorderheader) + nCapacity*sizeof(framerecord);
+    }
+
+    //the header's next sequence is shared with whoever else has the file mapped, e.g. the dump tool reading a live file
+    uint64_t LoadNext(const recorderheader* pHeader)
+    {
+        return __atomic_load_n(&pHeader->nNext, __ATOMIC_ACQUIRE);
+    }
+}
+
+EventRecorder::EventRecorder() :
+    m_pHeader(nullptr),
+    m_pRecords(nullptr),
+    m_nMapSize(0)
+{
+
+}
+
+EventRecorder::~EventRecorder()
+{
+    Close();
+}
+
+bool EventRecorder::Open(const std::string& sPath, uint64_t nCapacity)
+{
+    Close();
+    if(nCapacity == 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "EventRecorder\tA recorder with room for no frames makes no sense. Not recording";
+        return false;
+    }
+
+    auto nSlash = sPath.find_last_of('/');
+    if(nSlash != std::string::npos && nSlash != 0 && mkdir(sPath.substr(0, nSlash).c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        pmlLog(pml::LOG_WARN) << "EventRecorder\tFailed to create the directory for " << sPath << ": " << strerror(errno);
+    }
+
+    //we run as root so must not be tricked in to truncating and overwriting some other file through a link planted where the recorder goes
+    int nFd = open(sPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0644);
+    if(nFd < 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "EventRecorder\tFailed to open " << sPath << ": " << strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if(fstat(nFd, &st) != 0 || S_ISREG(st.st_mode) == false || st.st_uid != geteuid() || st.st_nlink != 1)
+    {
+        pmlLog(pml::LOG_ERROR) << "EventRecorder\t" << sPath << " is not a regular file of our own. Not recording";
+        close(nFd);
+        return false;
+    }
+
+    //an existing file is carried on with if it was made with the same layout, otherwise it is started again
+    bool bContinue(false);
+    recorderheader header;
+    if(static_cast<size_t>(st.st_size) == MapSize(nCapacity) && pread(nFd, &header, sizeof(header), 0) == sizeof(header))
+    {
+        bContinue = (memcmp(header.sMagic, MAGIC, sizeof(MAGIC)) == 0 && header.nVersion == VERSION && header.nRecordSize == sizeof(framerecord)
+                     && header.nCapacity == nCapacity);
+    }
+
+    m_nMapSize = MapSize(nCapacity);
+    if(!bContinue && ftruncate(nFd, 0) != 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "EventRecorder\tFailed to truncate " << sPath << ": " << strerror(errno);
+    }
+    if(!bContinue && ftruncate(nFd, m_nMapSize) != 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "EventRecorder\tFailed to size " << sPath << ": " << strerror(errno);
+        close(nFd);
+        return false;
+    }
+
+    void* pMap = mmap(nullptr, m_nMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, nFd, 0);
+    close(nFd);
+    if(pMap == MAP_FAILED)
+    {
+        pmlLog(pml::LOG_ERROR) << "EventRecorder\tFailed to map " << sPath << ": " << strerror(errno);
+        return false;
+    }
+
+    m_pHeader = reinterpret_cast<recorderheader*>(pMap);
+    m_pRecords = reinterpret_cast<framerecord*>(reinterpret_cast<unsigned char*>(pMap)+sizeof(recorderheader));
+    if(!bContinue)
+    {
+        memset(m_pHeader, 0, sizeof(recorderheader));
+        memcpy(m_pHeader->sMagic, MAGIC, sizeof(MAGIC));
+        m_pHeader->nVersion = VERSION;
+        m_pHeader->nRecordSize = sizeof(framerecord);
+        m_pHeader->nCapacity = nCapacity;
+        m_pHeader->nNext = 1;
+    }
+    m_tpFlushed = std::chrono::steady_clock::now();
+
+    pmlLog() << "EventRecorder\t" << (bContinue ? "Continuing " : "Created ") << sPath << " with room for " << nCapacity << " frames";
+    return true;
+}
+
+void EventRecorder::Close()
+{
+    if(m_pHeader)
+    {
+        msync(m_pHeader, m_nMapSize, MS_SYNC);
+        munmap(m_pHeader, m_nMapSize);
+        m_pHeader = nullptr;
+        m_pRecords = nullptr;
+    }
+}
+
+void EventRecorder::Record(framerecord& record)
+{
+    if(m_pHeader == nullptr)
+    {
+        return;
+    }
+    uint64_t nSequence = m_pHeader->nNext;
+    framerecord& slot = m_pRecords[(nSequence-1)%m_pHeader->nCapacity];
+
+    //invalidate the slot first so a crash part way through leaves it recognisably torn. The fence keeps the copy from being seen before the 0
+    __atomic_store_n(&slot.nSequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    record.nSequence = 0;
+    memcpy(&slot, &record, sizeof(framerecord));
+    __atomic_store_n(&slot.nSequence, nSequence, __ATOMIC_RELEASE);
+    record.nSequence = nSequence;
+
+    __atomic_store_n(&m_pHeader->nNext, nSequence+1, __ATOMIC_RELEASE);
+}
+
+void EventRecorder::Flush()
+{
+    if(m_pHeader && std::chrono::steady_clock::now()-m_tpFlushed >= FLUSH_INTERVAL)
+    {
+        msync(m_pHeader, m_nMapSize, MS_ASYNC);
+        m_tpFlushed = std::chrono::steady_clock::now();
+    }
+}
+
+
+EventReader::EventReader() :
+    m_pHeader(nullptr),
+    m_pRecords(nullptr),
+    m_nMapSize(0),
+    m_nSequence(0),
+    m_nEnd(0),
+    m_nSkipped(0)
+{
+
+}
+
+EventReader::~EventReader()
+{
+    if(m_pHeader)
+    {
+        munmap(const_cast<recorderheader*>(m_pHeader), m_nMapSize);
+    }
+}
+
+bool EventReader::Open(const std::string& sPath)
+{
+    int nFd = open(sPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(nFd < 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "EventReader\tFailed to open " << sPath << ": " << strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    recorderheader header;
+    if(fstat(nFd, &st) != 0 || pread(nFd, &header, sizeof(header), 0) != sizeof(header) || memcmp(header.sMagic, EventRecorder::MAGIC, sizeof(header.sMagic)) != 0
+       || header.nVersion != EventRecorder::VERSION || header.nRecordSize != sizeof(framerecord) || header.nCapacity == 0
+       || static_cast<size_t>(st.st_size) != MapSize(header.nCapacity))
+    {
+        pmlLog(pml::LOG_ERROR) << "EventReader\t" << sPath << " is not a recorder file this version can read";
+        close(nFd);
+        return false;
+    }
+
+    m_nMapSize = st.st_size;
+    void* pMap = mmap(nullptr, m_nMapSize, PROT_READ, MAP_SHARED, nFd, 0);
+    close(nFd);
+    if(pMap == MAP_FAILED)
+    {
+        pmlLog(pml::LOG_ERROR) << "EventReader\tFailed to map " << sPath << ": " << strerror(errno);
+        return false;
+    }
+    m_pHeader = reinterpret_cast<const recorderheader*>(pMap);
+    m_pRecords = reinterpret_cast<const framerecord*>(reinterpret_cast<const unsigned char*>(pMap)+sizeof(recorderheader));
+
+    m_nEnd = LoadNext(m_pHeader);
+    m_nSequence = m_nEnd > m_pHeader->nCapacity ? m_nEnd-m_pHeader->nCapacity : 1;
+    return true;
+}
+
+bool EventReader::Next(framerecord& record)
+{
+    while(m_pHeader && m_nSequence < m_nEnd)
+    {
+        const framerecord& slot = m_pRecords[(m_nSequence-1)%m_pHeader->nCapacity];
+        uint64_t nBefore = __atomic_load_n(&slot.nSequence, __ATOMIC_ACQUIRE);
+        memcpy(&record, &slot, sizeof(framerecord));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);     //so the copy is done before the sequence is looked at again
+        if(nBefore == m_nSequence++ && __atomic_load_n(&slot.nSequence, __ATOMIC_RELAXED) == nBefore)
+        {   //the sequence matches before and after the copy so the writer didn't touch it while we read it
+            record.nSequence = nBefore;
+            return true;
+        }
+        m_nSkipped++;
+    }
+    return false;
+}
@@ -0,0 +1,300 @@
+#include "framevalidator.h"
+#include <bitset>
+#include <cstring>
+#include <algorithm>
+#include <initializer_list>
+
+namespace
+{
+    //position of the parity bit in the raw frame. bit 27 for 24 and 30 fps, bit 59 for 25fps
+    const unsigned int PARITY_BYTE_525 = 3;
+    const unsigned int PARITY_BYTE_625 = 7;
+    const unsigned char PARITY_MASK = 0x08;
+
+    //frame rate used for prediction when we don't know the actual rate - the frame count never wraps
+    const int FPS_NO_WRAP = 40;
+
+    //parity is assumed to be in use once enough good frames have had it set. Frames without it count more heavily against
+    const int PARITY_SCORE_MAX = 16;
+    const int PARITY_SCORE_PENALTY = 4;
+
+    //the frame rate is relearnt once another rate has predicted this many frames the learnt one got wrong, with no second boundary the learnt one got right in between
+    const int RELEARN_FPS = 4;
+    const int FPS_CANDIDATES[] = {24, 25, 30};
+
+    int FrameNumber(const LTCFrame& frame)
+    {
+        return frame.frame_units + frame.frame_tens*10;
+    }
+
+    void CopyUserBits(const LTCFrame& from, LTCFrame& to)
+    {
+        to.user1 = from.user1;
+        to.user2 = from.user2;
+        to.user3 = from.user3;
+        to.user4 = from.user4;
+        to.user5 = from.user5;
+        to.user6 = from.user6;
+        to.user7 = from.user7;
+        to.user8 = from.user8;
+    }
+}
+
+FrameValidator::FrameValidator() :
+    m_bLast(false),
+    m_bCandidate(false),
+    m_bReverse(false),
+    m_nFPS(0),
+    m_nOtherFPS(0),
+    m_nOtherFPSCount(0),
+    m_nParityScore(0),
+    m_nRejected(0),
+    m_nCorrected(0)
+{
+
+}
+
+void FrameValidator::Reset()
+{
+    m_bLast = false;
+    m_bCandidate = false;
+    m_bReverse = false;
+    m_nFPS = 0;
+    m_nOtherFPS = 0;
+    m_nOtherFPSCount = 0;
+    m_nParityScore = 0;
+}
+
+FrameValidator::enumResult FrameValidator::Validate(LTCFrame& frame)
+{
+    bool bParity = CheckParity(frame);
+
+    if(m_bLast == false)
+    {   //nothing to predict from yet: need two frames that follow on from each other
+        if(m_bCandidate && Follows(frame, m_candidate))
+        {
+            UpdateParityScore(bParity);
+            m_last = frame;
+            m_bLast = true;
+            m_bCandidate = false;
+            return ACCEPTED;
+        }
+        m_candidate = frame;
+        m_bCandidate = true;
+        m_nRejected++;
+        return REJECTED;
+    }
+
+    LTCFrame predicted;
+    int nFPS = Predict(m_last, frame, predicted, m_bReverse);
+    unsigned int nDiff = CountDifferences(frame, predicted, nFPS);
+
+    if(nDiff == 0)
+    {
+        if(FrameNumber(m_bReverse ? m_last : frame) == 0)
+        {   //the learnt rate got a second boundary right
+            m_nOtherFPSCount = 0;
+        }
+        LearnFPS(nFPS);
+        m_bCandidate = false;
+        if(IsParityInUse() && !bParity)
+        {   //only the parity bit itself is wrong
+            frame = predicted;
+            m_last = frame;
+            m_nCorrected++;
+            return CORRECTED;
+        }
+        UpdateParityScore(bParity);
+        m_last = frame;
+        return ACCEPTED;
+    }
+
+    if(nDiff == 1 && IsParityInUse() && !bParity)
+    {   //single bit error
+        LearnFPS(nFPS);
+        m_bCandidate = false;
+        frame = predicted;
+        m_last = frame;
+        m_nCorrected++;
+        return CORRECTED;
+    }
+
+    if(RelearnFPS(frame))
+    {
+        return Validate(frame);
+    }
+
+    //the frame does not follow on. If it is a genuine jump in timecode then the next frame will follow it
+    if(m_bCandidate && (bParity || !IsParityInUse()) && Follows(frame, m_candidate))
+    {
+        m_last = frame;
+        m_bCandidate = false;
+        return ACCEPTED;
+    }
+
+    m_candidate = frame;
+    m_bCandidate = true;
+    m_last = predicted;    //freewheel so the next frame can still be checked
+    m_nRejected++;
+    return REJECTED;
+}
+
+bool FrameValidator::Follows(const LTCFrame& frame, const LTCFrame& previous)
+{
+    //try the direction we are playing in first, a step the other way sets the direction
+    for(bool bReverse : {m_bReverse, !m_bReverse})
+    {
+        LTCFrame predicted;
+        int nFPS = Predict(previous, frame, predicted, bReverse);
+        if(CountDifferences(frame, predicted, nFPS) == 0)
+        {
+            LearnFPS(nFPS);
+            m_bReverse = bReverse;
+            return true;
+        }
+    }
+    return false;
+}
+
+int FrameValidator::Predict(const LTCFrame& previous, const LTCFrame& frame, LTCFrame& predicted, bool bReverse) const
+{
+    int nFPS = m_nFPS;
+    if(nFPS == 0)
+    {   //frame rate not known yet. If this step looks like the wrap then assume the frame before it in time was the last in the second
+        const LTCFrame& first = bReverse ? previous : frame;
+        int nLast = FrameNumber(bReverse ? frame : previous) + 1;
+        if(FrameNumber(first) == 0 && (nLast == 24 || nLast == 25 || nLast == 30))
+        {
+            nFPS = nLast;
+        }
+        else
+        {
+            nFPS = FPS_NO_WRAP;
+        }
+    }
+
+    Step(previous, frame, predicted, nFPS, bReverse);
+    return nFPS;
+}
+
+void FrameValidator::Step(const LTCFrame& previous, const LTCFrame& frame, LTCFrame& predicted, int nFPS, bool bReverse) const
+{
+    predicted = previous;
+    if(bReverse)
+    {
+        ltc_frame_decrement(&predicted, nFPS, GetStandard(nFPS), LTC_NO_PARITY);
+    }
+    else
+    {
+        ltc_frame_increment(&predicted, nFPS, GetStandard(nFPS), LTC_NO_PARITY);
+    }
+
+    //user bits carry whatever the source puts in them so can't be predicted
+    CopyUserBits(frame, predicted);
+    if(IsParityInUse())
+    {
+        ltc_frame_set_parity(&predicted, GetStandard(nFPS));
+    }
+}
+
+bool FrameValidator::RelearnFPS(const LTCFrame& frame)
+{
+    if(m_nFPS == 0)
+    {
+        return false;
+    }
+
+    for(int nFPS : FPS_CANDIDATES)
+    {
+        if(nFPS == m_nFPS)
+        {
+            continue;
+        }
+        LTCFrame predicted;
+        Step(m_last, frame, predicted, nFPS, m_bReverse);
+        if(CountDifferences(frame, predicted, nFPS) == 0)
+        {
+            m_nOtherFPSCount = (nFPS == m_nOtherFPS) ? m_nOtherFPSCount+1 : 1;
+            m_nOtherFPS = nFPS;
+            if(m_nOtherFPSCount >= RELEARN_FPS)
+            {
+                m_nFPS = nFPS;
+                m_nOtherFPSCount = 0;
+                return true;
+            }
+            return false;
+        }
+    }
+    return false;
+}
+
+void FrameValidator::LearnFPS(int nFPS)
+{
+    if(m_nFPS == 0 && nFPS != FPS_NO_WRAP)
+    {
+        m_nFPS = nFPS;
+    }
+}
+
+void FrameValidator::UpdateParityScore(bool bParity)
+{
+    if(bParity)
+    {
+        m_nParityScore = std::min(m_nParityScore+1, PARITY_SCORE_MAX);
+    }
+    else
+    {
+        m_nParityScore = std::max(m_nParityScore-PARITY_SCORE_PENALTY, -PARITY_SCORE_MAX);
+    }
+}
+
+LTC_TV_STANDARD FrameValidator::GetStandard(int nFPS) const
+{
+    switch(nFPS)
+    {
+        case 24:
+            return LTC_TV_FILM_24;
+        case 25:
+            return LTC_TV_625_50;
+        default:
+            return LTC_TV_525_60;
+    }
+}
+
+bool FrameValidator::CheckParity(const LTCFrame& frame) const
+{
+    //with the parity bit set correctly every frame contains an even number of ones (and zeros)
+    const unsigned char* pFrame = reinterpret_cast<const unsigned char*>(&frame);
+    size_t nOnes = 0;
+    for(size_t i = 0; i < LTC_FRAME_BIT_COUNT/8; i++)
+    {
+        nOnes += std::bitset<8>(pFrame[i]).count();
+    }
+    return (nOnes%2) == 0;
+}
+
+unsigned int FrameValidator::CountDifferences(const LTCFrame& frame, const LTCFrame& predicted, int nFPS) const
+{
+    unsigned char mask[LTC_FRAME_BIT_COUNT/8];
+    memset(mask, 0xFF, sizeof(mask));
+
+    //the parity bit is checked separately so ignore it. If we don't know the frame rate we don't know which bit it is
+    if(m_nFPS == 0 || nFPS != 25)
+    {
+        mask[PARITY_BYTE_525] &= ~PARITY_MASK;
+    }
+    if(m_nFPS == 0 || nFPS == 25)
+    {
+        mask[PARITY_BYTE_625] &= ~PARITY_MASK;
+    }
+
+    const unsigned char* pFrame = reinterpret_cast<const unsigned char*>(&frame);
+    const unsigned char* pPredicted = reinterpret_cast<const unsigned char*>(&predicted);
+
+    unsigned int nDiff = 0;
+    for(size_t i = 0; i < LTC_FRAME_BIT_COUNT/8; i++)
+    {
+        nDiff += std::bitset<8>((pFrame[i]^pPredicted[i])&mask[i]).count();
+    }
+    return nDiff;
+}
@@ -0,0 +1,128 @@
+#include "latencyhistogram.h"
+#include "log.h"
+#include <iomanip>
+#include <algorithm>
+
+LatencyHistogram g_latency[LATENCY_POINTS];
+
+namespace
+{
+    const std::string STR_POINT[LATENCY_POINTS] = {"callback", "queue dwell", "write_float", "read", "DecodeDateAndTime", "Offset::Add", "end to end"};
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency)
+{
+    unsigned long long nNs = latency.count() > 0 ? latency.count() : 0;
+    m_nCounts[ToBucket(nNs)].fetch_add(1, std::memory_order_relaxed);
+
+    unsigned long long nMax = m_nMaxNs.load(std::memory_order_relaxed);
+    while(nNs > nMax && !m_nMaxNs.compare_exchange_weak(nMax, nNs, std::memory_order_relaxed))
+    {
+    }
+}
+
+unsigned int LatencyHistogram::ToBucket(unsigned long long nNs)
+{
+    if(nNs < SUB_BUCKETS)
+    {
+        return nNs;
+    }
+    unsigned int nBit = 63-__builtin_clzll(nNs);
+    if(nBit > MAX_BIT)
+    {
+        return BUCKETS-1;
+    }
+    //the power of two picks the group, the next SUB_BUCKET_BITS bits below the top one pick the bucket within it
+    unsigned int nGroup = nBit-SUB_BUCKET_BITS+1;
+    unsigned int nSub = (nNs >> (nBit-SUB_BUCKET_BITS)) & (SUB_BUCKETS-1);
+    return nGroup*SUB_BUCKETS + nSub;
+}
+
+unsigned long long LatencyHistogram::BucketUpperNs(unsigned int nBucket)
+{
+    if(nBucket < SUB_BUCKETS)
+    {
+        return nBucket;
+    }
+    unsigned int nGroup = nBucket/SUB_BUCKETS;
+    unsigned int nSub = nBucket%SUB_BUCKETS;
+    unsigned int nShift = nGroup-1;
+    return ((static_cast<unsigned long long>(SUB_BUCKETS+nSub+1)) << nShift) - 1;
+}
+
+unsigned long long LatencyHistogram::GetCount() const
+{
+    unsigned long long nCount(0);
+    for(unsigned int i = 0; i < BUCKETS; i++)
+    {
+        nCount += m_nCounts[i].load(std::memory_order_relaxed);
+    }
+    return nCount;
+}
+
+unsigned long long LatencyHistogram::GetPercentileNs(double dPercentile) const
+{
+    //the counts may move on while we walk them but each is read once so the answer is always one that was true at some point near now
+    unsigned long long nCounts[BUCKETS];
+    unsigned long long nTotal(0);
+    for(unsigned int i = 0; i < BUCKETS; i++)
+    {
+        nCounts[i] = m_nCounts[i].load(std::memory_order_relaxed);
+        nTotal += nCounts[i];
+    }
+    if(nTotal == 0)
+    {
+        return 0;
+    }
+
+    unsigned long long nWanted = static_cast<unsigned long long>(dPercentile/100.0*static_cast<double>(nTotal)+0.5);
+    nWanted = std::max(nWanted, 1ULL);
+
+    unsigned long long nSoFar(0);
+    for(unsigned int i = 0; i < BUCKETS; i++)
+    {
+        nSoFar += nCounts[i];
+        if(nSoFar >= nWanted)
+        {   //no point claiming a bucket edge beyond the worst value actually seen
+            return std::min(BucketUpperNs(i), GetMaxNs());
+        }
+    }
+    return GetMaxNs();
+}
+
+void LogLatencyHistograms()
+{
+#ifdef LATENCY_HISTOGRAMS
+    for(int i = 0; i < LATENCY_POINTS; i++)
+    {
+        const LatencyHistogram& histogram(g_latency[i]);
+        pmlLog() << "Latency\t" << STR_POINT[i] << "\tcount=" << histogram.GetCount() << std::fixed << std::setprecision(1)
+                 << "\tp50=" << histogram.GetPercentileNs(50.0)/1000.0 << "us"
+                 << "\tp99=" << histogram.GetPercentileNs(99.0)/1000.0 << "us"
+                 << "\tp99.9=" << histogram.GetPercentileNs(99.9)/1000.0 << "us"
+                 << "\tmax=" << histogram.GetMaxNs()/1000.0 << "us";
+    }
+#else
+    pmlLog(pml::LOG_WARN) << "Latency histograms not built in. Build with LATENCY_HISTOGRAMS defined to enable them";
+#endif
+}
+
+void WriteLatencyMetrics(std::ostream& os)
+{
+#ifdef LATENCY_HISTOGRAMS
+    const double QUANTILES[] = {0.5, 0.99, 0.999};
+
+    os << "# HELP ltcclient_latency_seconds Latency of each timed point on the decode hot path\n# TYPE ltcclient_latency_seconds summary\n";
+    for(int i = 0; i < LATENCY_POINTS; i++)
+    {
+        const LatencyHistogram& histogram(g_latency[i]);
+        for(auto dQuantile : QUANTILES)
+        {
+            os << "ltcclient_latency_seconds{point=\"" << STR_POINT[i] << "\",quantile=\"" << dQuantile << "\"} "
+               << static_cast<double>(histogram.GetPercentileNs(dQuantile*100.0))/1e9 << "\n";
+        }
+        os << "ltcclient_latency_seconds{point=\"" << STR_POINT[i] << "\",quantile=\"1\"} " << static_cast<double>(histogram.GetMaxNs())/1e9 << "\n";
+        os << "ltcclient_latency_seconds_count{point=\"" << STR_POINT[i] << "\"} " << histogram.GetCount() << "\n";
+    }
+#endif
+}
@@ -57,6 +57,8 @@ LTCDecoder* ltc_decoder_create(int apv, int queue_len) {
 	d->frame_start_prev = -1;
 	d->biphase_tic = 0;
 
+	acquisition_init(d, d->snd_to_biphase_period);
+
 	return d;
 }
 
@@ -68,26 +70,29 @@ int ltc_decoder_free(LTCDecoder *d) {
 	return 0;
 }
 
-void ltc_decoder_write(LTCDecoder *d, ltcsnd_sample_t *buf, size_t size, ltc_off_t posinfo) {
-	decode_ltc(d, buf, size, posinfo);
+size_t ltc_decoder_write(LTCDecoder *d, ltcsnd_sample_t *buf, size_t size, ltc_off_t posinfo) {
+	return decode_ltc(d, buf, size, posinfo);
 }
 
 #define LTC_CONVERSION_BUF_SIZE 1024
 
 #define LTCWRITE_TEMPLATE(FN, FORMAT, CONV) \
-void ltc_decoder_write_ ## FN (LTCDecoder *d, FORMAT *buf, size_t size, ltc_off_t posinfo) { \
+size_t ltc_decoder_write_ ## FN (LTCDecoder *d, FORMAT *buf, size_t size, ltc_off_t posinfo) { \
 	ltcsnd_sample_t tmp[LTC_CONVERSION_BUF_SIZE]; \
 	size_t copyStart = 0; \
 	while (copyStart < size) { \
 		int i; \
+		size_t done; \
 		int c = size - copyStart; \
 		c = (c > LTC_CONVERSION_BUF_SIZE) ? LTC_CONVERSION_BUF_SIZE : c; \
 		for (i=0; i < c; i++) { \
 			tmp[i] = CONV; \
 		} \
-		decode_ltc(d, tmp, c, posinfo + (ltc_off_t)copyStart); \
-		copyStart += c; \
+		done = decode_ltc(d, tmp, c, posinfo + (ltc_off_t)copyStart); \
+		copyStart += done; \
+		if (done < (size_t)c) break; \
 	} \
+	return copyStart; \
 }
 
 LTCWRITE_TEMPLATE(float, float, 128 + (buf[copyStart+i] * 127.0))
@@ -110,6 +115,25 @@ int ltc_decoder_read(LTCDecoder* d, LTCFrameExt* frame) {
 	return 0;
 }
 
+int ltc_decoder_read_span(LTCDecoder* d, const LTCFrameExt** frames) {
+	if (!frames) return -1;
+	*frames = &d->queue[d->queue_read_off];
+	if (d->queue_read_off == d->queue_write_off)
+		return 0;
+	if (d->queue_read_off < d->queue_write_off)
+		return d->queue_write_off - d->queue_read_off;
+	return d->queue_len - d->queue_read_off;
+}
+
+void ltc_decoder_read_commit(LTCDecoder* d, int count) {
+	const int pending = ltc_decoder_queue_length(d);
+	if (count > pending)
+		count = pending;
+	if (count <= 0)
+		return;
+	d->queue_read_off = (d->queue_read_off + count) % d->queue_len;
+}
+
 void ltc_decoder_queue_flush(LTCDecoder* d) {
 	while (d->queue_read_off != d->queue_write_off) {
 		d->queue_read_off++;
@@ -118,14 +142,57 @@ void ltc_decoder_queue_flush(LTCDecoder* d) {
 	}
 }
 
+void ltc_decoder_reset(LTCDecoder* d) {
+	decoder_reset(d);
+}
+
 int ltc_decoder_queue_length(LTCDecoder* d) {
 	return (d->queue_write_off - d->queue_read_off + d->queue_len) % d->queue_len;
 }
 
+unsigned long long ltc_decoder_queue_overflows(LTCDecoder* d) {
+	return d->queue_overflows;
+}
+
+void ltc_decoder_set_backpressure(LTCDecoder* d, int enable) {
+	d->queue_backpressure = enable ? 1 : 0;
+}
+
+int ltc_decoder_set_acquisition(LTCDecoder* d, int enable) {
+	if (acquisition_init(d, d->snd_to_biphase_period) == 0) {
+		d->acq_enabled = 0;
+		return enable ? -1 : 0;
+	}
+	d->acq_enabled = enable ? 1 : 0;
+	return 0;
+}
+
+unsigned long long ltc_decoder_acquisition_locks(LTCDecoder* d) {
+	return d->acq_locks;
+}
+
 /* -+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  * Encoder
  */
 
+/* (re)allocate the float and s16 edges to cover a whole bit at the largest
+ * sample-rate/fps the buffer can hold */
+static int alloc_edges(LTCEncoder *e) {
+	free(e->edge_f);
+	free(e->edge_s16);
+	e->edge_f_len = e->bufsize / 80 + 2;
+	e->edge_f = (float*) calloc(2 * e->edge_f_len, sizeof(float));
+	e->edge_s16 = (short*) calloc(2 * e->edge_f_len, sizeof(short));
+	if (!e->edge_f || !e->edge_s16) {
+		free(e->edge_f);
+		free(e->edge_s16);
+		e->edge_f = NULL;
+		e->edge_s16 = NULL;
+		return -1;
+	}
+	return 0;
+}
+
 LTCEncoder* ltc_encoder_create(double sample_rate, double fps, enum LTC_TV_STANDARD standard, int flags) {
 	if (sample_rate < 1)
 		return NULL;
@@ -137,10 +204,12 @@ LTCEncoder* ltc_encoder_create(double sample_rate, double fps, enum LTC_TV_STAND
 	/*-3.0 dBFS default */
 	e->enc_lo = 38;
 	e->enc_hi = 218;
+	e->level = pow(10, -3.0/20.0);
 
 	e->bufsize = 1 + ceil(sample_rate / fps);
 	e->buf = (ltcsnd_sample_t*) calloc(e->bufsize, sizeof(ltcsnd_sample_t));
-	if (!e->buf) {
+	if (!e->buf || alloc_edges(e)) {
+		free(e->buf);
 		free(e);
 		return NULL;
 	}
@@ -153,6 +222,8 @@ LTCEncoder* ltc_encoder_create(double sample_rate, double fps, enum LTC_TV_STAND
 void ltc_encoder_free(LTCEncoder *e) {
 	if (!e) return;
 	if (e->buf) free(e->buf);
+	free(e->edge_f);
+	free(e->edge_s16);
 	free(e);
 }
 
@@ -212,14 +283,18 @@ void ltc_encoder_reset(LTCEncoder *e) {
 }
 
 int ltc_encoder_set_volume(LTCEncoder *e, double dBFS) {
-	if (dBFS > 0)
+	if (!(dBFS <= 0))
 		return -1;
-	double pp = rint(127.0 * pow(10, dBFS/20.0));
+	/* float and s16 output take the level as it is, but it has to be one 8 bit can show too */
+	const double level = pow(10, dBFS/20.0);
+	double pp = rint(127.0 * level);
 	if (pp < 1 || pp > 127)
 		return -1;
+	e->level = level;
 	ltcsnd_sample_t diff = ((ltcsnd_sample_t) pp)&0x7f;
 	e->enc_lo = SAMPLE_CENTER - diff;
 	e->enc_hi = SAMPLE_CENTER + diff;
+	encoder_update_edges(e);
 	return 0;
 }
 
@@ -236,6 +311,7 @@ void ltc_encoder_set_filter(LTCEncoder *e, double rise_time) {
 		e->filter_const = 0;
 	else
 		e->filter_const = 1.0 - exp( -1.0 / (e->sample_rate * rise_time / 2000000.0 / exp(1.0)) );
+	encoder_update_edges(e);
 }
 
 int ltc_encoder_set_bufsize(LTCEncoder *e, double sample_rate, double fps) {
@@ -243,9 +319,10 @@ int ltc_encoder_set_bufsize(LTCEncoder *e, double sample_rate, double fps) {
 	e->offset = 0;
 	e->bufsize = 1 + ceil(sample_rate / fps);
 	e->buf = (ltcsnd_sample_t*) calloc(e->bufsize, sizeof(ltcsnd_sample_t));
-	if (!e->buf) {
+	if (!e->buf || alloc_edges(e)) {
 		return -1;
 	}
+	encoder_update_edges(e);
 	return 0;
 }
 
@@ -260,6 +337,200 @@ void ltc_encoder_encode_frame(LTCEncoder *e) {
 	}
 }
 
+static int encode_frame_to(LTCEncoder *e, enum LTC_ENC_OUTPUT format, void *buf, int stride) {
+	int byte;
+	int err = 0;
+	if (!buf || stride < 1)
+		return -1;
+
+	e->out_format = format;
+	e->out = buf;
+	e->out_stride = stride;
+	e->out_offset = 0;
+	for (byte = 0 ; byte < 10 ; byte++) {
+		err |= encode_byte(e, byte, 1.0);
+	}
+	e->out_format = LTC_ENC_U8;
+	e->out = NULL;
+	return err ? -1 : (int) e->out_offset;
+}
+
+int ltc_encoder_encode_frame_float(LTCEncoder *e, float *buf, int stride) {
+	return encode_frame_to(e, LTC_ENC_FLOAT, buf, stride);
+}
+
+int ltc_encoder_encode_frame_s16(LTCEncoder *e, short *buf, int stride) {
+	return encode_frame_to(e, LTC_ENC_S16, buf, stride);
+}
+
+/* whether a frame flips the biphase state: every bit does once more, every one bit twice */
+static int frame_flips_state(const LTCFrame *f) {
+	const unsigned char * const c = (const unsigned char*) f;
+	unsigned char x = 0;
+	int i;
+	for (i = 0; i < LTC_FRAME_BIT_COUNT/8; i++) {
+		x ^= c[i];
+	}
+	x ^= x >> 4;
+	x ^= x >> 2;
+	x ^= x >> 1;
+	return x & 1;
+}
+
+/* drop-frame counts ten minute blocks of one full 1800 frame minute then nine 1798 frame ones */
+#define DF_FRAMES_PER_MINUTE (30*60 - 2)
+#define DF_FRAMES_PER_10_MINUTES (30*60 + 9*DF_FRAMES_PER_MINUTE)
+#define DAYS_PER_LEAP_CYCLE (4*365 + 1)
+
+static long long frames_per_day(const LTCFrame *f, int fps) {
+	return f->dfbit ? 24*6*(long long)DF_FRAMES_PER_10_MINUTES : 24*60*60*(long long)fps;
+}
+
+/* which frame of the day f is, counting as ltc_frame_increment does; -1 if it is not a timecode that counting reaches */
+static long long frame_of_day(const LTCFrame *f, int fps) {
+	if (f->hours_units > 9 || f->mins_units > 9 || f->secs_units > 9 || f->frame_units > 9)
+		return -1;
+	if (f->dfbit && fps != 30)
+		return -1;
+
+	const int hours  = f->hours_units + f->hours_tens*10;
+	const int mins   = f->mins_units  + f->mins_tens*10;
+	const int secs   = f->secs_units  + f->secs_tens*10;
+	const int frames = f->frame_units + f->frame_tens*10;
+	if (hours > 23 || mins > 59 || secs > 59 || frames >= fps)
+		return -1;
+
+	const long long minute = hours*60 + mins;
+	if (!f->dfbit)
+		return (minute*60 + secs)*fps + frames;
+
+	const long long block = (minute/10) * DF_FRAMES_PER_10_MINUTES;
+	if (minute%10 == 0)
+		return block + secs*30 + frames;
+	if (secs == 0 && frames < 2)
+		return -1;
+	return block + 30*60 + (minute%10 - 1)*DF_FRAMES_PER_MINUTE + secs*30 + frames - 2;
+}
+
+/* the inverse of frame_of_day */
+static void set_frame_of_day(LTCFrame *f, long long n, int fps) {
+	long long minute;
+	int in_minute;
+	if (f->dfbit) {
+		minute = (n / DF_FRAMES_PER_10_MINUTES) * 10;
+		n %= DF_FRAMES_PER_10_MINUTES;
+		if (n >= 30*60) {
+			n -= 30*60;
+			minute += 1 + n / DF_FRAMES_PER_MINUTE;
+			n = n % DF_FRAMES_PER_MINUTE + 2;
+		}
+		in_minute = n;
+	} else {
+		minute = n / (60*fps);
+		in_minute = n % (60*fps);
+	}
+
+	const int hours  = minute / 60;
+	const int mins   = minute % 60;
+	const int secs   = in_minute / fps;
+	const int frames = in_minute % fps;
+	f->hours_tens  = hours/10;
+	f->hours_units = hours%10;
+	f->mins_tens   = mins/10;
+	f->mins_units  = mins%10;
+	f->secs_tens   = secs/10;
+	f->secs_units  = secs%10;
+	f->frame_tens  = frames/10;
+	f->frame_units = frames%10;
+}
+
+/* move the date in the user bits on by days midnights, with the calendar ltc_frame_increment uses */
+static void advance_date(LTCFrame *f, long long days) {
+	int years  = f->user5 + f->user6*10;
+	int months = f->user3 + f->user4*10;
+	int mday   = f->user1 + f->user2*10;
+	if (months < 1 || months > 12)
+		return;
+
+	unsigned char dpm[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
+	if ((years%4) == 0)
+		dpm[1] = 29;
+	if (years < 100 && mday >= 1 && mday <= dpm[months-1]) {
+		/* from a real date every four years has the one leap day, and years wrap at 100 which keeps years%4 */
+		years = (years + 4*(days / DAYS_PER_LEAP_CYCLE)) % 100;
+		days %= DAYS_PER_LEAP_CYCLE;
+	}
+
+	for (; days > 0; days--) {
+		dpm[1] = (years%4) == 0 ? 29 : 28;
+		mday++;
+		if (mday > dpm[months-1]) {
+			mday = 1;
+			months++;
+			if (months > 12) {
+				months = 1;
+				years = (years+1)%100;
+			}
+		}
+	}
+
+	f->user6 = years/10;
+	f->user5 = years%10;
+	f->user4 = months/10;
+	f->user3 = months%10;
+	f->user2 = mday/10;
+	f->user1 = mday%10;
+}
+
+static long long render_to(LTCEncoder *e, enum LTC_ENC_OUTPUT format, SMPTETimecode *start, long long first, long long count, void *buf) {
+	if (!start || !buf || first < 0 || count < 0)
+		return -1;
+
+	const int fps = rint(e->fps);
+	/* the encoder's frame carries the flag bits reinit set up, only the time and date are replaced */
+	LTCFrame f = e->f;
+	ltc_time_to_frame(&f, start, e->standard, e->flags);
+
+	/* with parity kept every frame leaves the state as it found it, so the first frame of the
+	 * segment is worked out from its number. Without parity the state has to be followed through
+	 * every frame before it, as does a start timecode that is out of range */
+	int state = 0;
+	long long frame;
+	const long long start_of_day = frame_of_day(&f, fps);
+	if (start_of_day < 0 || (e->flags & LTC_NO_PARITY)) {
+		for (frame = 0; frame < first; frame++) {
+			state ^= frame_flips_state(&f);
+			ltc_frame_increment(&f, fps, e->standard, e->flags);
+		}
+	} else if (first > 0) {
+		const long long day = frames_per_day(&f, fps);
+		set_frame_of_day(&f, (start_of_day + first) % day, fps);
+		if (e->flags & LTC_USE_DATE) {
+			advance_date(&f, (start_of_day + first) / day);
+		}
+		ltc_frame_set_parity(&f, e->standard);
+	}
+
+	const long long base = ltc_encoder_render_offset(e, first);
+	for (frame = first; frame < first + count; frame++) {
+		state = encoder_render_frame(e, format, &f, frame, base, buf, state);
+		ltc_frame_increment(&f, fps, e->standard, e->flags);
+	}
+	return ltc_encoder_render_offset(e, first + count) - base;
+}
+
+long long ltc_encoder_render_offset(LTCEncoder *e, long long frame) {
+	return encoder_render_offset(e, frame * 2 * LTC_FRAME_BIT_COUNT);
+}
+
+long long ltc_encoder_render_float(LTCEncoder *e, SMPTETimecode *start, long long first, long long count, float *buf) {
+	return render_to(e, LTC_ENC_FLOAT, start, first, count, buf);
+}
+
+long long ltc_encoder_render_s16(LTCEncoder *e, SMPTETimecode *start, long long first, long long count, short *buf) {
+	return render_to(e, LTC_ENC_S16, start, first, count, buf);
+}
+
 void ltc_encoder_get_timecode(LTCEncoder *e, SMPTETimecode *t) {
 	ltc_frame_to_time(t, &e->f, e->flags);
 }
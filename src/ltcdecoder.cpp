@@ -3,6 +3,8 @@
 #include <algorithm>
 #include "log.h"
 #include "utils.h"
+#include "latencyhistogram.h"
+#include "asynclog.h"
 #include <cmath>
 
 
@@ -10,13 +12,22 @@ const std::string LtcDecoder::STR_MODE[4] = {"Not specified","8-bit","Date","Pag
 const std::string LtcDecoder::STR_DATE_MODE[5] = {"Unknown","SMPTE","BBC","TVE","MTD"};
 
 
-LtcDecoder::LtcDecoder() :
-    m_pDecoder(ltc_decoder_create(APV, 32)),
+LtcDecoder::LtcDecoder(unsigned long nSampleRate, int nQueueSize, bool bBackPressure) :
+    m_dSampleRate(static_cast<double>(nSampleRate)),
+    m_pDecoder(ltc_decoder_create(static_cast<int>(nSampleRate/INITIAL_FPS), std::max(nQueueSize, 2))),   //one slot is always kept free so need at least 2
+    m_nQueueSize(std::max(nQueueSize, 2)),
+    m_bBackPressure(bBackPressure),
     m_nTotal(0),
+    m_nFrameStartSample(0),
+    m_nFrameEndSample(0),
+    m_dVolume(0.0),
+    m_dEdgeJitter(0.0),
     m_nFPS(0),
     m_nLastFrame(0),
-    m_nDateMode(UNKNOWN)
+    m_nDateMode(UNKNOWN),
+    m_dFPS(0.0)
 {
+    ltc_decoder_set_backpressure(m_pDecoder, m_bBackPressure ? 1 : 0);
 }
 
 LtcDecoder::~LtcDecoder()
@@ -24,29 +35,119 @@ LtcDecoder::~LtcDecoder()
     ltc_decoder_free(m_pDecoder);
 }
 
+unsigned long long LtcDecoder::GetOverflowCount() const
+{
+    return ltc_decoder_queue_overflows(m_pDecoder);
+}
+
+void LtcDecoder::Discontinuity(unsigned long nLost)
+{
+    ltc_decoder_queue_flush(m_pDecoder);
+    ltc_decoder_reset(m_pDecoder);
+    m_validator.Reset();
+    m_nTotal += nLost;
+}
+
+bool LtcDecoder::SetCorrelationLock(bool bEnable)
+{
+    return ltc_decoder_set_acquisition(m_pDecoder, bEnable ? 1 : 0) == 0;
+}
+
+unsigned long long LtcDecoder::GetCorrelationLockCount() const
+{
+    return ltc_decoder_acquisition_locks(m_pDecoder);
+}
+
 
-std::pair<bool, std::chrono::microseconds> LtcDecoder::DecodeLtc(const timedframe& frame)
+size_t LtcDecoder::DecodeLtc(const timedframe& frame, const frameCallback& onFrame)
 {
-   std::pair<bool, std::chrono::microseconds> decode(false, std::chrono::microseconds(0));
+    size_t nDecoded(0);
+
+    if(m_bBackPressure == false)
+    {
+        LATENCY_START(tpWrite);
+        ltc_decoder_write_float(m_pDecoder, frame.second.data(), frame.second.size(), m_nTotal);
+        LATENCY_END(LATENCY_WRITE_FLOAT, tpWrite);
+        nDecoded = ReadFrames(frame, onFrame);
+    }
+    else
+    {   //the decoder stops writing when its queue is full so keep emptying it until the whole block has been used
+        size_t nDone = 0;
+        while(nDone < frame.second.size())
+        {
+            LATENCY_START(tpWrite);
+            nDone += ltc_decoder_write_float(m_pDecoder, frame.second.data()+nDone, frame.second.size()-nDone, m_nTotal+nDone);
+            LATENCY_END(LATENCY_WRITE_FLOAT, tpWrite);
+            nDecoded += ReadFrames(frame, onFrame);
+        }
+    }
+    m_nTotal += frame.second.size();
+    return nDecoded;
+}
 
-    ltc_decoder_write_float(m_pDecoder, frame.second.data(), frame.second.size(), m_nTotal);
-    while (ltc_decoder_read(m_pDecoder, &m_Frame))
+size_t LtcDecoder::ReadFrames(const timedframe& frame, const frameCallback& onFrame)
+{
+    size_t nDecoded(0);
+    const LTCFrameExt* pFrames;
+    int nFrames;
+    LATENCY_START(tpRead);
+    while((nFrames = ltc_decoder_read_span(m_pDecoder, &pFrames)) > 0)
     {
-        decode.first = true;
-        int nMode = WorkoutUserMode();
+        LATENCY_END(LATENCY_READ, tpRead);   //work on the frames in place in the decoder's queue rather than copying each one out
+        for(int i = 0; i < nFrames; i++)
+        {
+            const LTCFrameExt& ext = pFrames[i];
+            m_Frame = ext.ltc;
+
+            if(m_validator.Validate(m_Frame) == FrameValidator::REJECTED)
+            {   //parity and prediction say this frame is bad so don't let it get to the offset calculation
+                continue;
+            }
+
+            int nMode = WorkoutUserMode();
+
+            LATENCY_START(tpDateTime);
+            auto offset = DecodeDateAndTime(nMode, frame.first, ext.off_start);
+            LATENCY_END(LATENCY_DATE_TIME, tpDateTime);
+            m_tpFrameEnd = frame.first + DoubleToMicro(static_cast<double>(ext.off_end-m_nTotal)/m_dSampleRate);
 
-        decode.second = DecodeDateAndTime(nMode, frame.first, m_Frame.off_start);
+            m_sFrameStart = std::to_string(ext.off_end - ext.off_start);
+            m_sFrameEnd = std::to_string(ext.off_end);  // -> use this or the above and a timestamp to work out exactly when we got this bit of LTC
+            m_sAmpltitude = std::to_string(ext.volume);
+            m_dVolume = ext.volume;
+            m_dEdgeJitter = EdgeJitter(ext);
+            m_nFrameStartSample = ext.off_start;
+            m_nFrameEndSample = ext.off_end;
 
-        m_sFrameStart = std::to_string(m_Frame.off_end - m_Frame.off_start);
-        m_sFrameEnd = std::to_string(m_Frame.off_end);  // -> use this or the above and a timestamp to work out exactly when we got this bit of LTC
-        m_sAmpltitude = std::to_string(m_Frame.volume);
 
+            CreateRaw();
 
-        CreateRaw();
+            onFrame(offset);
+            nDecoded++;
+        }
+        ltc_decoder_read_commit(m_pDecoder, nFrames);
+#ifdef LATENCY_HISTOGRAMS
+        tpRead = std::chrono::steady_clock::now();
+#endif
+    }
+    return nDecoded;
+}
 
+double LtcDecoder::EdgeJitter(const LTCFrameExt& ext) const
+{
+    double dMean(0.0);
+    for(int i = 0; i < LTC_FRAME_BIT_COUNT; i++)
+    {
+        dMean += ext.biphase_tics[i];
     }
-    m_nTotal += frame.second.size();
-    return decode;
+    dMean /= LTC_FRAME_BIT_COUNT;
+
+    double dVariance(0.0);
+    for(int i = 0; i < LTC_FRAME_BIT_COUNT; i++)
+    {
+        dVariance += (ext.biphase_tics[i]-dMean)*(ext.biphase_tics[i]-dMean);
+    }
+    return std::sqrt(dVariance/LTC_FRAME_BIT_COUNT);
 }
 
 const std::string& LtcDecoder::GetFrameStart() const
@@ -90,95 +191,95 @@ void LtcDecoder::CreateRaw()
     std::string sRaw;
     std::string str;
 
-    str = std::bitset<4>(m_Frame.ltc.frame_units).to_string();
+    str = std::bitset<4>(m_Frame.frame_units).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<4>(m_Frame.ltc.user1).to_string();
+    str = std::bitset<4>(m_Frame.user1).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<2>(m_Frame.ltc.frame_tens).to_string();
+    str = std::bitset<2>(m_Frame.frame_tens).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<1>(m_Frame.ltc.dfbit).to_string();
+    str = std::bitset<1>(m_Frame.dfbit).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<1>(m_Frame.ltc.col_frame).to_string();
+    str = std::bitset<1>(m_Frame.col_frame).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<4>(m_Frame.ltc.user2).to_string();
+    str = std::bitset<4>(m_Frame.user2).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<4>(m_Frame.ltc.secs_units).to_string();
+    str = std::bitset<4>(m_Frame.secs_units).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<4>(m_Frame.ltc.user3).to_string();
+    str = std::bitset<4>(m_Frame.user3).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<3>(m_Frame.ltc.secs_tens).to_string();
+    str = std::bitset<3>(m_Frame.secs_tens).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<1>(m_Frame.ltc.biphase_mark_phase_correction).to_string();
+    str = std::bitset<1>(m_Frame.biphase_mark_phase_correction).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<4>(m_Frame.ltc.user4).to_string();
+    str = std::bitset<4>(m_Frame.user4).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<4>(m_Frame.ltc.mins_units).to_string();
+    str = std::bitset<4>(m_Frame.mins_units).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<4>(m_Frame.ltc.user5).to_string();
+    str = std::bitset<4>(m_Frame.user5).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<3>(m_Frame.ltc.mins_tens).to_string();
+    str = std::bitset<3>(m_Frame.mins_tens).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<1>(m_Frame.ltc.binary_group_flag_bit0).to_string();
+    str = std::bitset<1>(m_Frame.binary_group_flag_bit0).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<4>(m_Frame.ltc.user6).to_string();
+    str = std::bitset<4>(m_Frame.user6).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<4>(m_Frame.ltc.hours_units).to_string();
+    str = std::bitset<4>(m_Frame.hours_units).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<4>(m_Frame.ltc.user7).to_string();
+    str = std::bitset<4>(m_Frame.user7).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<2>(m_Frame.ltc.hours_tens).to_string();
+    str = std::bitset<2>(m_Frame.hours_tens).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<1>(m_Frame.ltc.binary_group_flag_bit1).to_string();
+    str = std::bitset<1>(m_Frame.binary_group_flag_bit1).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<1>(m_Frame.ltc.binary_group_flag_bit2).to_string();
+    str = std::bitset<1>(m_Frame.binary_group_flag_bit2).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<4>(m_Frame.ltc.user8).to_string();
+    str = std::bitset<4>(m_Frame.user8).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
     sRaw+= " ";
-    str = std::bitset<16>(m_Frame.ltc.sync_word).to_string();
+    str = std::bitset<16>(m_Frame.sync_word).to_string();
     std::reverse(str.begin(), str.end());
     sRaw+=str;
 
@@ -188,13 +289,13 @@ void LtcDecoder::CreateRaw()
 
 int LtcDecoder::WorkoutUserMode()
 {
-    int nbit0 = m_Frame.ltc.binary_group_flag_bit0;
-    int nbit1 = m_Frame.ltc.binary_group_flag_bit1;
-    int nbit2 = m_Frame.ltc.binary_group_flag_bit2;
+    int nbit0 = m_Frame.binary_group_flag_bit0;
+    int nbit1 = m_Frame.binary_group_flag_bit1;
+    int nbit2 = m_Frame.binary_group_flag_bit2;
     if(m_nFPS == 24)
     {
-        nbit0 = m_Frame.ltc.biphase_mark_phase_correction;
-        nbit2 = m_Frame.ltc.binary_group_flag_bit0;
+        nbit0 = m_Frame.biphase_mark_phase_correction;
+        nbit2 = m_Frame.binary_group_flag_bit0;
     }
 
     int nMode = nbit0+(nbit2*2);
@@ -209,7 +310,7 @@ std::chrono::microseconds LtcDecoder::DecodeDateAndTime(int nUserMode, std::chro
 {
     //work out the time we received this frame
     double diff = startSample-m_nTotal;
-    diff /= 48000.0;    //@todo the actual sample rate
+    diff /= m_dSampleRate;
     tp += DoubleToMicro(diff);
 
 
@@ -259,7 +360,7 @@ std::chrono::microseconds LtcDecoder::DecodeDateAndTime(int nUserMode, std::chro
     //convert frame to milliseconds
     if(m_nFPS != 0)
     {
-        if(m_Frame.ltc.dfbit == 0)
+        if(m_Frame.dfbit == 0)
         {
             m_dFPS = m_nFPS+1;
         }
@@ -276,7 +377,7 @@ std::chrono::microseconds LtcDecoder::DecodeDateAndTime(int nUserMode, std::chro
     }
     auto difference = std::chrono::duration_cast<std::chrono::microseconds>(m_tp-tp);
 
-   // pmlLog() << "Frame At: " << ConvertTimeToIsoString(tp) << "\tLTC: " << ConvertTimeToIsoString(m_tp)<< "\tOffset: " << difference.count();
+    logAsync(pml::LOG_TRACE, "Frame At: ", tp, "\tLTC: ", m_tp, "\tOffset: ", difference.count());
 
     return difference;
 }
@@ -287,7 +388,7 @@ bool LtcDecoder::DecodeDateAndTime(SMPTETimecode& stime, int nDateMode)
     switch(nDateMode)
     {
         case SMPTE:
-            ltc_frame_to_time(&stime, &m_Frame.ltc, 1);
+            ltc_frame_to_time(&stime, &m_Frame, 1);
             break;
         case BBC:
             ltc_frame_to_time_bbc(stime);
@@ -309,10 +410,10 @@ bool LtcDecoder::DecodeDateAndTime(SMPTETimecode& stime, int nDateMode)
 
 void LtcDecoder::ltc_frame_to_time_only(SMPTETimecode& stime)
 {
-    stime.hours = m_Frame.ltc.hours_units + m_Frame.ltc.hours_tens*10;
-    stime.mins  = m_Frame.ltc.mins_units  + m_Frame.ltc.mins_tens*10;
-    stime.secs  = m_Frame.ltc.secs_units  + m_Frame.ltc.secs_tens*10;
-    stime.frame = m_Frame.ltc.frame_units + m_Frame.ltc.frame_tens*10;
+    stime.hours = m_Frame.hours_units + m_Frame.hours_tens*10;
+    stime.mins  = m_Frame.mins_units  + m_Frame.mins_tens*10;
+    stime.secs  = m_Frame.secs_units  + m_Frame.secs_tens*10;
+    stime.frame = m_Frame.frame_units + m_Frame.frame_tens*10;
 
     if(stime.frame == 0 && m_nLastFrame != 0)
     {
@@ -324,22 +425,22 @@ void LtcDecoder::ltc_frame_to_time_only(SMPTETimecode& stime)
 
 void LtcDecoder::ltc_frame_to_time_bbc(SMPTETimecode& stime)
 {
-   stime.years = m_Frame.ltc.user6 + m_Frame.ltc.user8*10;
-   stime.months = m_Frame.ltc.user3;
-   if((m_Frame.ltc.user4&0x4)!=0)
+   stime.years = m_Frame.user6 + m_Frame.user8*10;
+   stime.months = m_Frame.user3;
+   if((m_Frame.user4&0x4)!=0)
    {
         stime.months += 10;
    }
-    stime.days = m_Frame.ltc.user2 + (m_Frame.ltc.user4&0x3)*10;
+    stime.days = m_Frame.user2 + (m_Frame.user4&0x3)*10;
 
     sprintf(stime.timezone,"+0");
 }
 
 void LtcDecoder::ltc_frame_to_time_tve(SMPTETimecode& stime)
 {
-    stime.years  = m_Frame.ltc.user6 + m_Frame.ltc.user7*10;
-    stime.months = m_Frame.ltc.user4 + m_Frame.ltc.user5*10;
-    stime.days   = m_Frame.ltc.user2 + m_Frame.ltc.user3*10;
+    stime.years  = m_Frame.user6 + m_Frame.user7*10;
+    stime.months = m_Frame.user4 + m_Frame.user5*10;
+    stime.days   = m_Frame.user2 + m_Frame.user3*10;
 
     sprintf(stime.timezone,"+0");
 }
@@ -347,11 +448,11 @@ void LtcDecoder::ltc_frame_to_time_tve(SMPTETimecode& stime)
 
 void LtcDecoder::ltc_frame_to_time_mtd(SMPTETimecode& stime)
 {
-    stime.years  = m_Frame.ltc.user2 + m_Frame.ltc.user1*10;
-    stime.months = m_Frame.ltc.user4 + m_Frame.ltc.user3*10;
-    stime.days   = m_Frame.ltc.user6 + m_Frame.ltc.user5*10;
+    stime.years  = m_Frame.user2 + m_Frame.user1*10;
+    stime.months = m_Frame.user4 + m_Frame.user3*10;
+    stime.days   = m_Frame.user6 + m_Frame.user5*10;
 
-    switch((m_Frame.ltc.user7 & 0x3))
+    switch((m_Frame.user7 & 0x3))
     {
         case 0:
         case 3:
@@ -373,12 +474,12 @@ const std::string& LtcDecoder::GetMode() const
 
 bool LtcDecoder::IsColourFlagSet() const
 {
-    return (m_Frame.ltc.col_frame!=0);
+    return (m_Frame.col_frame!=0);
 }
 
 bool LtcDecoder::IsClockFlagSet() const
 {
-    return (m_Frame.ltc.binary_group_flag_bit1!=0);
+    return (m_Frame.binary_group_flag_bit1!=0);
 }
 
 
@@ -0,0 +1,380 @@
+#include "ltcgenerator.h"
+#include "ltcdecoder.h"
+#include "log.h"
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <cstdio>
+#include <algorithm>
+
+const double LtcGenerator::DEFAULT_VOLUME = -18.0;
+
+namespace
+{
+    const long long NS_PER_SECOND = 1000000000LL;
+    const long long NS_PER_DAY = 86400LL*NS_PER_SECOND;
+
+    const double ERROR_SMOOTHING = 16.0;
+
+    int paGeneratorCallback(const void *input, void *output, unsigned long frameCount, const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void *userData)
+    {
+        if(userData)
+        {
+            reinterpret_cast<LtcGenerator*>(userData)->Callback(reinterpret_cast<float*>(output), frameCount, timeInfo, statusFlags);
+        }
+        return 0;
+    }
+
+    long long ToNs(const std::chrono::system_clock::time_point& tp)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+    }
+
+    //offset of local time from UTC at the given time
+    long long LocalOffsetNs(long long nUtcNs)
+    {
+        time_t t = nUtcNs/NS_PER_SECOND;
+        std::tm local;
+        localtime_r(&t, &local);
+        return static_cast<long long>(local.tm_gmtoff)*NS_PER_SECOND;
+    }
+}
+
+LtcGenerator::LtcGenerator(unsigned long nDevice, unsigned long nSampleRate, unsigned char nChannels, double dFPS, int nDateMode) :
+    m_nDevice(nDevice),
+    m_nSampleRate(nSampleRate),
+    m_nChannels(nChannels),
+    m_nDateMode(nDateMode),
+    m_dVolume(DEFAULT_VOLUME),
+    m_bThreadConfigured(false),
+    m_nRateNum(25),
+    m_nRateDen(1),
+    m_nFPS(25),
+    m_bDropFrame(false),
+    m_eStandard(LTC_TV_625_50),
+    m_index(25, false),
+    m_pEncoder(nullptr),
+    m_bPaInitialized(false),
+    m_pStream(nullptr),
+    m_nFramePos(0),
+    m_nDayNs(0),
+    m_nFrame(0),
+    m_bSynced(false),
+    m_nLocalOffsetNs(0),
+    m_dErrorNs(0.0),
+    m_dErrorUs(0.0),
+    m_nResyncs(0),
+    m_nCorrections(0),
+    m_nUnderflows(0),
+    m_nEncodeFailures(0)
+{
+    if(std::fabs(dFPS-29.97) < 0.01)
+    {
+        m_nRateNum = 30000;
+        m_nRateDen = 1001;
+        m_nFPS = 30;
+        m_bDropFrame = true;
+        m_eStandard = LTC_TV_525_60;
+    }
+    else
+    {
+        m_nFPS = static_cast<int>(std::lround(dFPS));
+        if(m_nFPS != 24 && m_nFPS != 25 && m_nFPS != 30)
+        {
+            pmlLog(pml::LOG_WARN) << "LtcGenerator\t" << dFPS << "fps not supported. Using 25";
+            m_nFPS = 25;
+        }
+        m_nRateNum = m_nFPS;
+        m_eStandard = (m_nFPS == 25) ? LTC_TV_625_50 : (m_nFPS == 24 ? LTC_TV_FILM_24 : LTC_TV_525_60);
+    }
+    m_index = TimecodeIndex(m_nFPS, m_bDropFrame);
+}
+
+LtcGenerator::~LtcGenerator()
+{
+    CloseStream();
+    if(m_pEncoder)
+    {
+        ltc_encoder_free(m_pEncoder);
+    }
+    if(m_bPaInitialized)
+    {
+        Pa_Terminate();
+    }
+}
+
+void LtcGenerator::CloseStream()
+{
+    if(m_pStream)
+    {
+        Pa_AbortStream(m_pStream);
+        PaError err = Pa_CloseStream(m_pStream);
+        if(err != paNoError)
+        {
+            pmlLog(pml::LOG_ERROR) << "LtcGenerator\tFailed to stop PortAudio stream: " << Pa_GetErrorText(err);
+        }
+        m_pStream = nullptr;
+    }
+}
+
+bool LtcGenerator::Init()
+{
+    m_pEncoder = ltc_encoder_create(m_nSampleRate, static_cast<double>(m_nRateNum)/static_cast<double>(m_nRateDen), m_eStandard,
+                                    m_nDateMode == LtcDecoder::SMPTE ? LTC_USE_DATE : 0);
+    if(m_pEncoder == nullptr || ltc_encoder_set_volume(m_pEncoder, m_dVolume) != 0)
+    {
+        pmlLog(pml::LOG_CRITICAL) << "LtcGenerator\tCould not create LTC encoder at " << m_dVolume << "dBFS";
+        return false;
+    }
+    //allocated here so the callback never has to
+    m_vFrame.reserve(ltc_encoder_get_buffersize(m_pEncoder));
+    Service();
+
+    if(Pa_Initialize() != paNoError)
+    {
+        pmlLog(pml::LOG_CRITICAL) << "LtcGenerator\tCould not initialize PortAudio";
+        return false;
+    }
+    m_bPaInitialized = true;
+
+    PaStreamParameters outputParameters;
+    const PaDeviceInfo* pInfo = Pa_GetDeviceInfo(m_nDevice);
+    if(pInfo && pInfo->maxOutputChannels < m_nChannels)
+    {
+        m_nChannels = pInfo->maxOutputChannels;
+        pmlLog() << "LtcGenerator\tOutput channels changed to " << static_cast<int>(m_nChannels);
+    }
+    outputParameters.channelCount = m_nChannels;
+    outputParameters.device = m_nDevice;
+    outputParameters.sampleFormat = paFloat32;
+    outputParameters.suggestedLatency = pInfo ? pInfo->defaultLowOutputLatency : 0.0;
+    outputParameters.hostApiSpecificStreamInfo = NULL;
+
+    pmlLog() << "LtcGenerator\tAttempt to open " << static_cast<int>(m_nChannels) << " channel OUTPUT stream on device " << m_nDevice << " at "
+             << m_nRateNum << "/" << m_nRateDen << "fps";
+    PaError err = Pa_OpenStream(&m_pStream, 0, &outputParameters, m_nSampleRate, paFramesPerBufferUnspecified, paNoFlag, paGeneratorCallback,
+                                reinterpret_cast<void*>(this));
+    if(err == paNoError)
+    {
+        err = Pa_StartStream(m_pStream);
+        if(err == paNoError)
+        {
+            const PaStreamInfo* pStreamInfo = Pa_GetStreamInfo(m_pStream);
+            if(pStreamInfo)
+            {
+                pmlLog() << "LtcGenerator\tStreamInfo: Output Latency " << pStreamInfo->outputLatency << " Sample Rate " << pStreamInfo->sampleRate;
+            }
+            return true;
+        }
+    }
+    pmlLog(pml::LOG_ERROR) << "LtcGenerator\tFailed to open device " << m_nDevice << " " << Pa_GetErrorText(err);
+    m_pStream = nullptr;
+    return false;
+}
+
+long long LtcGenerator::FrameStartNs(long long nDayNs, long long nFrame) const
+{
+    //split so nothing overflows however large the numbers get
+    return nDayNs + (nFrame/m_nRateNum)*m_nRateDen*NS_PER_SECOND + (nFrame%m_nRateNum)*m_nRateDen*NS_PER_SECOND/m_nRateNum;
+}
+
+long long LtcGenerator::FrameAt(long long nTodNs) const
+{
+    long long nPeriodNs = m_nRateDen*NS_PER_SECOND;
+    return (nTodNs/nPeriodNs)*m_nRateNum + (nTodNs%nPeriodNs)*m_nRateNum/nPeriodNs;
+}
+
+void LtcGenerator::Resync(long long nDacNs)
+{
+    m_nDayNs = nDacNs - (nDacNs%NS_PER_DAY);
+    m_nFrame = FrameAt(nDacNs-m_nDayNs);
+    RenderFrame();
+
+    long long nIntoFrame = nDacNs - FrameStartNs(m_nDayNs, m_nFrame);
+    m_nFramePos = std::min(static_cast<size_t>(nIntoFrame*static_cast<long long>(m_nSampleRate)/NS_PER_SECOND), m_vFrame.size());
+    m_dErrorNs = 0.0;
+    m_bSynced = true;
+    m_nResyncs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LtcGenerator::SetFrameTime(long long nFrame)
+{
+    SMPTETimecode stime;
+    memset(&stime, 0, sizeof(stime));
+
+    m_index.ToTimecode(nFrame, stime, 0);
+
+    //the day is already in local time
+    time_t tDay = m_nDayNs/NS_PER_SECOND;
+    std::tm date;
+    gmtime_r(&tDay, &date);
+    stime.years = date.tm_year%100;
+    stime.months = date.tm_mon+1;
+    stime.days = date.tm_mday;
+
+    long long nZoneMinutes = m_nLocalOffsetNs.load(std::memory_order_relaxed)/NS_PER_SECOND/60;
+    int nZone = static_cast<int>(std::llabs(nZoneMinutes)%(24*60));
+    snprintf(stime.timezone, sizeof(stime.timezone), "%c%02d%02d", nZoneMinutes < 0 ? '-' : '+', nZone/60, nZone%60);
+
+    ltc_encoder_set_timecode(m_pEncoder, &stime);
+    if(m_nDateMode == LtcDecoder::SMPTE)
+    {   //libltc has put the date and timezone in the user bits
+        return;
+    }
+
+    //the other formats are the reverse of what LtcDecoder reads
+    LTCFrame frame;
+    ltc_encoder_get_frame(m_pEncoder, &frame);
+    switch(m_nDateMode)
+    {
+        case LtcDecoder::BBC:
+            frame.user6 = stime.years%10;
+            frame.user8 = stime.years/10;
+            frame.user3 = stime.months%10;
+            frame.user2 = stime.days%10;
+            frame.user4 = (stime.days/10) | (stime.months >= 10 ? 0x4 : 0);
+            break;
+        case LtcDecoder::TVE:
+            frame.user6 = stime.years%10;
+            frame.user7 = stime.years/10;
+            frame.user4 = stime.months%10;
+            frame.user5 = stime.months/10;
+            frame.user2 = stime.days%10;
+            frame.user3 = stime.days/10;
+            break;
+        case LtcDecoder::MTD:
+            frame.user2 = stime.years%10;
+            frame.user1 = stime.years/10;
+            frame.user4 = stime.months%10;
+            frame.user3 = stime.months/10;
+            frame.user6 = stime.days%10;
+            frame.user5 = stime.days/10;
+            frame.user7 = (nZoneMinutes == 60 || nZoneMinutes == 120) ? nZoneMinutes/60 : 0;
+            break;
+    }
+    ltc_frame_set_parity(&frame, m_eStandard);
+    ltc_encoder_set_frame(m_pEncoder, &frame);
+}
+
+void LtcGenerator::RenderFrame()
+{
+    SetFrameTime(m_nFrame);
+
+    //straight to float at the configured level: within the capacity reserved in Init so nothing is allocated here
+    m_vFrame.resize(m_vFrame.capacity());
+    int nSize = ltc_encoder_encode_frame_float(m_pEncoder, m_vFrame.data(), 1);
+    if(nSize > 0)
+    {
+        m_vFrame.resize(nSize);
+    }
+    else
+    {   //a frame's worth of silence keeps the stream in step with the clock: an empty frame would leave the callback nothing to play
+        m_vFrame.assign(std::min(static_cast<size_t>(m_nSampleRate*m_nRateDen/m_nRateNum), m_vFrame.capacity()), 0.0f);
+        m_nEncodeFailures.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_nFramePos = 0;
+}
+
+void LtcGenerator::Callback(float* pBuffer, size_t nFrameCount, const PaStreamCallbackTimeInfo* pTimeInfo, int nFlags)
+{
+    if(m_bThreadConfigured == false)
+    {
+        ConfigureThread("generator", m_config, true);  //on PortAudio's callback thread so mustn't log with pmlLog
+        m_bThreadConfigured = true;
+    }
+    if(nFlags & paOutputUnderflow)
+    {
+        m_nUnderflows.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    //when the first sample of this buffer will leave the DAC, by the system clock in local time
+    long long nNowNs = ToNs(std::chrono::system_clock::now());
+    long long nDacNs = nNowNs + m_nLocalOffsetNs.load(std::memory_order_relaxed);
+    if(pTimeInfo->outputBufferDacTime > 0.0)
+    {
+        nDacNs += static_cast<long long>((pTimeInfo->outputBufferDacTime-pTimeInfo->currentTime)*1e9);
+    }
+
+    if(m_bSynced == false)
+    {
+        Resync(nDacNs);
+    }
+
+    //where the stream thinks it is against where the DAC says it is. More than half a frame out (a clock step or lost buffers) and we start again
+    double dSampleNs = 1e9/static_cast<double>(m_nSampleRate);
+    long long nStreamNs = FrameStartNs(m_nDayNs, m_nFrame) + static_cast<long long>(m_nFramePos*dSampleNs);
+    long long nErrorNs = nStreamNs - nDacNs;
+    if(std::llabs(nErrorNs) > m_nRateDen*NS_PER_SECOND/m_nRateNum/2)
+    {
+        Resync(nDacNs);
+        nErrorNs = 0;
+    }
+    m_dErrorNs += (static_cast<double>(nErrorNs)-m_dErrorNs)/ERROR_SMOOTHING;
+    m_dErrorUs.store(m_dErrorNs/1000.0, std::memory_order_relaxed);
+    m_error.Add(std::chrono::nanoseconds(std::llabs(nErrorNs)));
+
+    //the DAC and system clocks drift apart so pull the stream back a sample at a time: repeat one if we are ahead, skip one if behind
+    int nAdjust(0);
+    if(m_dErrorNs > dSampleNs)
+    {
+        nAdjust = 1;
+        m_dErrorNs -= dSampleNs;
+    }
+    else if(m_dErrorNs < -dSampleNs)
+    {
+        nAdjust = -1;
+        m_dErrorNs += dSampleNs;
+    }
+    if(nAdjust != 0)
+    {
+        m_nCorrections.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    for(size_t i = 0; i < nFrameCount; i++)
+    {
+        if(nAdjust < 0)
+        {
+            m_nFramePos++;
+            nAdjust = 0;
+        }
+        if(m_nFramePos >= m_vFrame.size())
+        {
+            m_nFrame++;
+            if(FrameStartNs(m_nDayNs, m_nFrame) >= m_nDayNs+NS_PER_DAY)
+            {   //midnight
+                m_nDayNs += NS_PER_DAY;
+                m_nFrame = 0;
+            }
+            RenderFrame();
+        }
+
+        float dSample = m_vFrame[m_nFramePos];
+        if(nAdjust > 0)
+        {
+            nAdjust = 0;
+        }
+        else
+        {
+            m_nFramePos++;
+        }
+        for(unsigned char nChannel = 0; nChannel < m_nChannels; nChannel++)
+        {
+            pBuffer[i*m_nChannels+nChannel] = dSample;
+        }
+    }
+}
+
+void LtcGenerator::Service()
+{
+    //a change (daylight saving) shows up in the callback as a jump of more than half a frame so it resyncs
+    m_nLocalOffsetNs.store(LocalOffsetNs(ToNs(std::chrono::system_clock::now())), std::memory_order_relaxed);
+}
+
+void LtcGenerator::LogMetrics()
+{
+    auto nCount = m_error.nCount.load(std::memory_order_relaxed);
+    auto nMean = nCount ? m_error.nTotalNs.load(std::memory_order_relaxed)/nCount : 0;
+    pmlLog() << "LtcGenerator\talignment error=" << GetAlignmentErrorUs() << "us\tmean |error|=" << nMean/1000 << "us\tmax |error|=" << m_error.TakeMaxNs()/1000
+             << "us\tcorrections=" << m_nCorrections.load(std::memory_order_relaxed) << "\tresyncs=" << m_nResyncs.load(std::memory_order_relaxed)
+             << "\tunderflows=" << m_nUnderflows.load(std::memory_order_relaxed) << "\tencode failures=" << m_nEncodeFailures.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,283 @@
+#include "ltcsource.h"
+#include "log.h"
+#include "latencyhistogram.h"
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    const double OFFSET_SMOOTHING = 8.0;    //frames, for the offset and jitter the selector goes on
+
+    long long ToNs(std::chrono::steady_clock::time_point tp)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+    }
+
+    //a file's audio can wait for the decoder to be read, so its frames need never be overwritten
+    bool IsFile(LtcSource::enumBackend eBackend, const std::string& sDevice)
+    {
+        return eBackend == LtcSource::ALSA && sDevice.compare(0, AlsaInput::FILE_PREFIX.size(), AlsaInput::FILE_PREFIX) == 0;
+    }
+}
+
+LtcSource::LtcSource(enumBackend eBackend, const std::string& sDevice, unsigned char nChannel, unsigned long nSampleRate, unsigned char nChannels,
+                     int nDecoderQueue) :
+    m_eBackend(eBackend),
+    m_sDevice(sDevice),
+    m_nChannel(nChannel),
+    m_nSampleRate(nSampleRate),
+    m_nChannels(std::max(nChannels, static_cast<unsigned char>(nChannel+1))),
+    m_sName(sDevice+"@"+std::to_string(nChannel)),
+    m_qCapture(CAPTURE_QUEUE_SIZE, CAPTURE_WATERMARK),
+    m_qDecoded(DECODE_QUEUE_SIZE),
+    m_qPool(POOL_SIZE),
+    m_ltc(nSampleRate, nDecoderQueue, IsFile(eBackend, sDevice)),
+    m_eWakeup(WAKE_DEADLINE),
+    m_nSlackUs(DEADLINE_SLACK_US),
+    m_nCaptureFrames(AudioSource::BUFFER_AUTO),
+    m_dCaptureLatency(0.0),
+    m_bRun(false),
+    m_bActive(false),
+    m_bRelock(false),
+    m_dSmoothed(0.0),
+    m_dJitterSq(0.0),
+    m_dLastFPS(0.0),
+    m_nLastFrameNs(0),
+    m_dOffset(0.0),
+    m_dJitter(0.0),
+    m_nFramesDecoded(0),
+    m_nDecoderOverflows(0),
+    m_nCorrelationLocks(0),
+    m_nDiscontinuities(0),
+    m_nRejected(0),
+    m_nCorrected(0),
+    m_dVolume(0.0),
+    m_nLastFramesDecoded(0),
+    m_nLastDecoderOverflows(0),
+    m_nLastCorrelationLocks(0),
+    m_nLastDiscontinuities(0)
+{
+    if(m_ltc.SetCorrelationLock(true) == false)
+    {
+        pmlLog(pml::LOG_WARN) << "LtcSource\t" << m_sName << "\tCorrelation lock can't run at " << nSampleRate << "Hz";
+    }
+}
+
+LtcSource::~LtcSource()
+{
+    Stop();
+}
+
+void LtcSource::SetDecodeWakeup(enumWakeup eWakeup, size_t nWatermark, long long nSlackUs)
+{
+    m_eWakeup = eWakeup;
+    m_nSlackUs = nSlackUs;
+    m_qCapture.SetWatermark(nWatermark);
+}
+
+void LtcSource::SetCaptureBuffer(unsigned long nFrames, double dLatency)
+{
+    m_nCaptureFrames = nFrames;
+    m_dCaptureLatency = dLatency;
+}
+
+void LtcSource::FillPool()
+{
+    //big enough for the largest block the capture stage will ask for, and written to so every page is faulted in (and locked) now
+    size_t nFrames = std::max(static_cast<unsigned long>(AudioSource::AUTO_BUFFER_MAX), m_nCaptureFrames);
+    for(size_t i = 0; i < POOL_SIZE; i++)
+    {
+        aframe af(nFrames, 0.0f);
+        af.clear();
+        m_qPool.Push(std::move(af));
+    }
+}
+
+bool LtcSource::Start(const threadconfig& capture, const threadconfig& decode)
+{
+    if(m_eBackend == ALSA)
+    {
+        m_pInput = std::make_unique<AlsaInput>(m_sDevice, m_nSampleRate, m_nChannels, m_qCapture);
+    }
+    else
+    {
+        m_pInput = std::make_unique<AudioInput>(strtoul(m_sDevice.c_str(), nullptr, 10), m_nSampleRate, m_nChannels, m_qCapture);
+    }
+    m_pInput->SetChannel(m_nChannel);
+    m_pInput->SetBufferPool(&m_qPool);
+    m_pInput->SetBufferSize(m_nCaptureFrames);
+    m_pInput->SetLatency(m_dCaptureLatency);
+    m_pInput->SetThreadConfig(capture);
+
+    FillPool();
+
+    m_config = decode;
+    m_bRun = true;
+    m_thDecode = std::thread(&LtcSource::DecodeThread, this);
+
+    pmlLog(pml::LOG_TRACE) << "LtcSource\t" << m_sName << "\tStart audio input";
+    if(m_pInput->Init() == false)
+    {
+        pmlLog(pml::LOG_ERROR) << "LtcSource\t" << m_sName << "\tCould not start capture";
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+void LtcSource::Stop()
+{
+    //stop the audio first so nothing more gets pushed in to the decode thread
+    m_pInput.reset();
+
+    if(m_bRun)
+    {
+        m_bRun = false;
+        m_qCapture.Wake();
+        m_thDecode.join();
+    }
+}
+
+void LtcSource::Service()
+{
+    if(m_pInput)
+    {
+        m_pInput->Tune();
+    }
+}
+
+std::chrono::steady_clock::time_point LtcSource::GetLastFrameTime() const
+{
+    return std::chrono::steady_clock::time_point(std::chrono::nanoseconds(m_nLastFrameNs.load(std::memory_order_acquire)));
+}
+
+void LtcSource::DecodeThread()
+{
+    ConfigureThread("decode", m_config);
+
+    bool bDiscontinuity(false);
+    bool bRestart(true);
+    audioblock block;
+    std::chrono::steady_clock::time_point tpQueued;
+
+    //made once here rather than for every block so the decode loop never allocates
+    LtcDecoder::frameCallback onFrame = [this, &bDiscontinuity, &bRestart, &tpQueued](std::chrono::microseconds offset){
+        TrackOffset(static_cast<double>(offset.count())/1e6, bRestart || m_ltc.GetFPS() != m_dLastFPS);
+        m_dLastFPS = m_ltc.GetFPS();
+        bRestart = false;
+        m_nLastFrameNs.store(ToNs(tpQueued), std::memory_order_release);
+
+        if(m_bActive.load(std::memory_order_acquire))
+        {
+            decodedframe decoded;
+            decoded.offset = offset;
+            decoded.dFPS = m_ltc.GetFPS();
+            decoded.tpCaptured = tpQueued;
+            decoded.tpFrameEnd = m_ltc.GetFrameEndTime();
+            decoded.tpLtc = m_ltc.GetTime();
+            decoded.nFrameStart = m_ltc.GetFrameStartSample();
+            decoded.nFrameEnd = m_ltc.GetFrameEndSample();
+            decoded.frame = m_ltc.GetFrame();
+            decoded.fVolume = m_ltc.GetVolume();
+            decoded.dEdgeJitter = m_ltc.GetEdgeJitter()/static_cast<double>(m_nSampleRate);
+            decoded.nRejected = m_ltc.GetRejectedCount();
+            decoded.bDiscontinuity = bDiscontinuity;
+            if(m_qDecoded.Push(std::move(decoded)))
+            {   //a frame the estimate stage never sees would shift its regression, so until one gets through the next is a discontinuity
+                bDiscontinuity = false;
+            }
+        }
+        m_nFramesDecoded.fetch_add(1, std::memory_order_relaxed);
+    };
+
+    while(m_bRun)
+    {
+        if(m_eWakeup == WAKE_DEADLINE)
+        {
+            m_qCapture.WaitForNext(m_nSlackUs);
+        }
+        else
+        {
+            m_qCapture.Wait();
+        }
+        while(m_qCapture.Pop(block, tpQueued))
+        {
+            m_wakeup.Add(std::chrono::steady_clock::now()-tpQueued);
+            LATENCY_RECORD(LATENCY_QUEUE_DWELL, std::chrono::steady_clock::now()-tpQueued);
+            if(block.bDiscontinuity)
+            {   //the estimate stage needs telling along with the next frame we pass on
+                m_ltc.Discontinuity(block.nLost);
+                m_nDiscontinuities.fetch_add(1, std::memory_order_relaxed);
+                bDiscontinuity = true;
+                bRestart = true;
+            }
+            else if(m_bRelock.exchange(false, std::memory_order_acq_rel))
+            {   //no samples lost, but the same as far as the decoder and the estimate stage are concerned
+                m_ltc.Discontinuity(0);
+                bDiscontinuity = true;
+                bRestart = true;
+            }
+
+            m_ltc.DecodeLtc(block.frame, onFrame);
+            m_nDecoderOverflows.store(m_ltc.GetOverflowCount(), std::memory_order_relaxed);
+            m_nCorrelationLocks.store(m_ltc.GetCorrelationLockCount(), std::memory_order_relaxed);
+            m_nRejected.store(m_ltc.GetRejectedCount(), std::memory_order_relaxed);
+            m_nCorrected.store(m_ltc.GetCorrectedCount(), std::memory_order_relaxed);
+            m_dVolume.store(m_ltc.GetVolume(), std::memory_order_relaxed);
+
+            m_stats.Add(std::chrono::steady_clock::now()-tpQueued);
+
+            //hand the buffer back so the capture stage need not allocate another
+            m_qPool.Push(std::move(block.frame.second));
+        }
+    }
+}
+
+void LtcSource::TrackOffset(double dOffset, bool bRestart)
+{
+    if(bRestart)
+    {
+        m_dSmoothed = dOffset;
+        m_dJitterSq = 0.0;
+    }
+    else
+    {   //exponentially weighted, as NTP does for a peer's offset and jitter
+        double dDiff = dOffset-m_dSmoothed;
+        m_dSmoothed += dDiff/OFFSET_SMOOTHING;
+        m_dJitterSq += (dDiff*dDiff-m_dJitterSq)/OFFSET_SMOOTHING;
+    }
+    m_dOffset.store(m_dSmoothed, std::memory_order_relaxed);
+    m_dJitter.store(std::sqrt(m_dJitterSq), std::memory_order_relaxed);
+}
+
+void LtcSource::LogEvents()
+{
+    auto nFrames = m_nFramesDecoded.load(std::memory_order_relaxed);
+    if(m_nLastFramesDecoded == 0 && nFrames != 0)
+    {
+        pmlLog() << "LtcSource\t" << m_sName << "\tLocked to LTC";
+    }
+    m_nLastFramesDecoded = nFrames;
+
+    auto nOverflows = m_nDecoderOverflows.load(std::memory_order_relaxed);
+    if(nOverflows != m_nLastDecoderOverflows)
+    {
+        pmlLog(pml::LOG_WARN) << "LtcSource\t" << m_sName << "\tDecoder queue overflowed: " << (nOverflows-m_nLastDecoderOverflows) << " frames lost";
+        m_nLastDecoderOverflows = nOverflows;
+    }
+
+    auto nDiscontinuities = m_nDiscontinuities.load(std::memory_order_relaxed);
+    if(nDiscontinuities != m_nLastDiscontinuities)
+    {
+        pmlLog(pml::LOG_WARN) << "LtcSource\t" << m_sName << "\tAudio discontinuity: samples lost " << (nDiscontinuities-m_nLastDiscontinuities) << " time(s). Decoder reset";
+        m_nLastDiscontinuities = nDiscontinuities;
+    }
+
+    auto nLocks = m_nCorrelationLocks.load(std::memory_order_relaxed);
+    if(nLocks != m_nLastCorrelationLocks)
+    {
+        pmlLog() << "LtcSource\t" << m_sName << "\tAcquired LTC sync word by correlation";
+        m_nLastCorrelationLocks = nLocks;
+    }
+}
@@ -1,23 +1,35 @@
 #include <iostream>
-#include "audioinput.h"
-#include "ltcdecoder.h"
-#include <mutex>
-#include <condition_variable>
+#include "pipeline.h"
+#include "metricsserver.h"
+#include "controlserver.h"
+#include "asynclog.h"
+#include "ltcgenerator.h"
+#include <thread>
 #include <chrono>
 #include <sstream>
 #include <iomanip>
 #include "log.h"
 #include <sys/time.h>
 #include <cstring>
-#include "offset.h"
+#include <cerrno>
 #include "utils.h"
+#include "latencyhistogram.h"
+#include "config.h"
+#include "deviceprobe.h"
 #include <signal.h>
 #include <execinfo.h>
 #include <unistd.h>
+#include <atomic>
+#include <fstream>
 
 using namespace std;
 
-bool g_bRun = true;
+std::atomic<bool> g_bRun(true);     //lock free so it may be written by the signal handler while the main loop reads it
+static_assert(ATOMIC_BOOL_LOCK_FREE == 2, "g_bRun must be lock free to be set from a signal handler");
+volatile sig_atomic_t g_bDumpLatency = false;
+volatile sig_atomic_t g_bReload = false;
+
+static const std::chrono::seconds GENERATOR_METRICS_INTERVAL(10);
 
 static void sig(int signo)
 {
@@ -39,14 +51,16 @@ static void sig(int signo)
         case SIGTERM:
         case SIGINT:
 	    case SIGQUIT:
-            {
-                if (g_bRun)
-                {
-                    pmlLog(pml::LOG_WARN)  << "User abort" << std::endl;
-                }
-                g_bRun = false;
-            }
+            //logged by the main loop once it sees this
+            g_bRun = false;
 	    break;
+        case SIGUSR1:
+            //the histograms are logged from the main loop as logging is not safe in a signal handler
+            g_bDumpLatency = true;
+            break;
+        case SIGHUP:
+            g_bReload = true;
+            break;
         }
 
 }
@@ -57,66 +71,240 @@ void init_signals()
     signal (SIGINT, sig);
     signal (SIGSEGV, sig);
     signal (SIGQUIT, sig);
+    signal (SIGUSR1, sig);
+    signal (SIGHUP, sig);
 }
 
+//generate [device] [fps] [smpte|bbc|tve|mtd]: output LTC from the system clock rather than decoding it. The sample rate and channels come from
+//the config, which Config::Load has read from the same command line
+static int RunGenerator(int argc, char* argv[], const Config& config)
+{
+    std::vector<std::string> vArgs;
+    for(int i = 2; i < argc; i++)
+    {
+        if(std::string(argv[i]).compare(0, 2, "--") != 0)
+        {
+            vArgs.push_back(argv[i]);
+        }
+    }
+    unsigned long nDevice = vArgs.size() > 0 ? strtoul(vArgs[0].c_str(), nullptr, 10) : 0;
+    double dFPS = vArgs.size() > 1 ? strtod(vArgs[1].c_str(), nullptr) : 25.0;
+    int nDateMode = LtcDecoder::SMPTE;
+    if(vArgs.size() > 2)
+    {
+        const std::string& sMode(vArgs[2]);
+        nDateMode = (sMode == "bbc") ? LtcDecoder::BBC : (sMode == "tve") ? LtcDecoder::TVE : (sMode == "mtd") ? LtcDecoder::MTD : LtcDecoder::SMPTE;
+    }
+
+    LtcGenerator generator(nDevice, config.nSampleRate, static_cast<unsigned char>(config.nChannels), dFPS, nDateMode);
+    if(generator.Init() == false)
+    {
+        return -1;
+    }
+
+    auto tpMetrics = std::chrono::steady_clock::now();
+    while(g_bRun)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        generator.Service();
+        if(std::chrono::steady_clock::now()-tpMetrics >= GENERATOR_METRICS_INTERVAL)
+        {
+            generator.LogMetrics();
+            tpMetrics = std::chrono::steady_clock::now();
+        }
+    }
+    pmlLog(pml::LOG_WARN) << "User abort";
+    return 0;
+}
 
-int main()
+//<device>[@channel], where the device is an ALSA device name or pa:<index>
+static void AddSource(Pipeline& pipeline, const std::string& sSource)
 {
-    init_signals();
+    static const std::string PA_PREFIX = "pa:";
+
+    std::string sDevice(sSource);
+    unsigned char nChannel(0);
+    auto nAt = sDevice.rfind('@');
+    if(nAt != std::string::npos)
+    {
+        nChannel = static_cast<unsigned char>(strtoul(sDevice.c_str()+nAt+1, nullptr, 10));
+        sDevice = sDevice.substr(0, nAt);
+    }
+
+    if(sDevice.compare(0, PA_PREFIX.size(), PA_PREFIX) == 0)
+    {
+        pipeline.AddSource(LtcSource::PORTAUDIO, sDevice.substr(PA_PREFIX.size()), nChannel);
+    }
+    else
+    {
+        pipeline.AddSource(LtcSource::ALSA, sDevice, nChannel);
+    }
+}
+
+//probe [seconds] [scan]: list every capture device and what it can do as JSON. scan looks for LTC on every channel rather than just the first
+static int RunProbe(int argc, char* argv[])
+{
+    double dSeconds = argc > 2 ? strtod(argv[2], nullptr) : 2.0;
+    bool bScan = argc > 3 && std::string(argv[3]) == "scan";
+
+    DeviceProbe probe(std::chrono::milliseconds(static_cast<long long>(dSeconds*1000.0)), bScan);
+    probe.Run();
+    probe.WriteJson(std::cout);
+    return 0;
+}
+
+//detaches from the terminal. The working directory is kept so relative paths in the config still work, and the log output, which goes to stdout,
+//is left open for whatever started us to collect
+static bool Daemonise(const std::string& sPidFile)
+{
+    if(daemon(1, 1) != 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "Could not run as a daemon: " << strerror(errno);
+        return false;
+    }
+    if(sPidFile.empty() == false)
+    {
+        std::ofstream ofs(sPidFile, std::ios::trunc);
+        if(!(ofs << getpid() << std::endl))
+        {
+            pmlLog(pml::LOG_ERROR) << "Could not write pid file " << sPidFile;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void RemovePidFile(const Config& config)
+{
+    if(config.bDaemon && config.sPidFile.empty() == false)
+    {
+        unlink(config.sPidFile.c_str());
+    }
+}
 
+int main(int argc, char* argv[])
+{
+    init_signals();
 
-    std::mutex mainMutex;
-    std::condition_variable mainCv;
+    if(argc > 1 && std::string(argv[1]) == "probe")
+    {   //before any log output is added so stdout is nothing but the JSON
+        return RunProbe(argc, argv);
+    }
 
     pml::LogStream::AddOutput(std::make_unique<pml::LogOutput>());
 
-    pmlLog(pml::LOG_TRACE) << "Create audio input";
-    AudioInput ai(0, 48000, 2, mainCv);
+    if(argc > 1 && std::string(argv[1]) == "generate")
+    {   //the generator's own arguments are taken for sources, which it has no use for
+        Config config;
+        if(config.Load(argc-1, argv+1) == false)
+        {
+            return -1;
+        }
+        AsyncLog::Get().SetLevel(pml::LOG_INFO);
+        AsyncLog::Get().Start();
+        int nResult = RunGenerator(argc, argv, config);
+        AsyncLog::Get().Stop();
+        return nResult;
+    }
+
+    if(argc > 1 && (std::string(argv[1]) == "--help" || std::string(argv[1]) == "-h"))
+    {
+        Config::Usage(std::cout);
+        return 0;
+    }
 
-    pmlLog(pml::LOG_TRACE) << "Start audio input";
-    if(ai.Init() == false)
+    Config config;
+    if(config.Load(argc, argv) == false)
+    {
+        return -1;
+    }
+    //before any thread is started, as only the thread that forks carries on in the child
+    if(config.bDaemon && Daemonise(config.sPidFile) == false)
     {
         return -1;
     }
+    config.Log();
 
+    //the estimate and clock stages log through the async ring. LOG_TRACE would add a line for every decoded frame
+    AsyncLog::Get().SetLevel(config.eLogLevel);
+    AsyncLog::Get().Start();
 
-    LtcDecoder ltc;
-    Offset data;
+    pmlLog(pml::LOG_TRACE) << "Create pipeline";
+    //with more than one source the clock follows whichever the selector picks, or with combine set all those that agree
+    Pipeline pipeline(config.nSampleRate, static_cast<unsigned char>(config.nChannels), config.nDecoderQueue);
+    for(const auto& sSource : config.vSources)
+    {
+        AddSource(pipeline, sSource);
+    }
+    if(config.vSources.empty())
+    {
+        pipeline.AddSource(LtcSource::PORTAUDIO, "0");
+    }
+    pipeline.SetCombine(config.bCombine);
+    pipeline.SetSelectTolerance(config.dSelectTolerance);
+    pipeline.SetServo(config.servo);
+    pipeline.SetDecodeWakeup(config.eWakeup, config.nWatermark, config.nSlackUs);
+    pipeline.SetCaptureBuffer(config.nCaptureBuffer, config.dCaptureLatency);
+    for(int i = 0; i < Pipeline::STAGES; i++)
+    {
+        pipeline.SetStageConfig(static_cast<Pipeline::enumStage>(i), config.stage[i]);
+    }
+    pipeline.SetRealtime(config.bRealtime);
+    pipeline.SetRecorder(config.sRecorderPath, config.nRecorderCapacity);
+    if(pipeline.Start() == false)
+    {
+        AsyncLog::Get().Stop();
+        RemovePidFile(config);
+        return -1;
+    }
 
-    pmlLog(pml::LOG_TRACE) << "Start loop";
-    bool bLocked(false);
-    bool bSynced(false);
+    MetricsServer metrics(pipeline);
+    if(config.sMetricsEndpoint.empty() == false)
+    {
+        metrics.Start(config.sMetricsEndpoint);
+    }
+    ControlServer control(pipeline);
+    if(config.sControlSocket.empty() == false)
+    {
+        control.Start(config.sControlSocket);
+    }
 
+    pmlLog(pml::LOG_TRACE) << "Start loop";
+    auto tpMetrics = std::chrono::steady_clock::now();
     while(g_bRun)
     {
-        std::unique_lock<std::mutex> lk(mainMutex);
-        mainCv.wait(lk, [&ai]{ return ai.IsReady();});
-        do
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        pipeline.Service();
+        pipeline.LogDecoderEvents();
+        if(std::chrono::steady_clock::now()-tpMetrics >= std::chrono::duration<double>(config.dMetricsInterval))
+        {
+            pipeline.LogMetrics();
+            tpMetrics = std::chrono::steady_clock::now();
+        }
+        if(g_bDumpLatency)
         {
-            auto decode = ltc.DecodeLtc(ai.GetNextFrame());
-            if(decode.first)
+            g_bDumpLatency = false;
+            LogLatencyHistograms();
+        }
+        if(g_bReload)
+        {   //only the live settings change, which can all be handed to a running pipeline
+            g_bReload = false;
+            if(config.Reload())
             {
-                if(bLocked == false)
-                {
-                    pmlLog() << "Locked to LTC";
-                    bLocked = true;
-                }
-
-                auto crashed = data.Add(decode.second, 0, ltc.GetFPS());
-
-                if(data.IsSynced() && !bSynced)
-                {
-                    pmlLog() << "Synced to LTC";
-                    bSynced =true;
-                }
-                else if(!data.IsSynced() && bSynced)
-                {
-                    pmlLog(pml::LOG_WARN) << "Lost sync to LTC";
-                    bSynced = false;
-                }
+                AsyncLog::Get().SetLevel(config.eLogLevel);
+                pipeline.SetSelectTolerance(config.dSelectTolerance);
+                pipeline.SetServo(config.servo);
             }
-        }while(ai.RemoveFrame());
+        }
     }
 
+    pmlLog(pml::LOG_WARN) << "User abort";
+
+    control.Stop();
+    metrics.Stop();
+    pipeline.Stop();
+    AsyncLog::Get().Stop();
+    RemovePidFile(config);
     return 0;
 }
@@ -0,0 +1,197 @@
+#include "metricsserver.h"
+#include "pipeline.h"
+#include "log.h"
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+const std::string MetricsServer::UNIX_PREFIX = "unix:";
+
+namespace
+{
+    const int POLL_MS = 500;       //how often the server thread checks whether it should stop
+    const int REQUEST_TIMEOUT_MS = 1000;
+    const int BACKLOG = 4;
+}
+
+MetricsServer::MetricsServer(const Pipeline& pipeline) :
+    m_pipeline(pipeline),
+    m_nListen(-1),
+    m_bRun(false)
+{
+
+}
+
+MetricsServer::~MetricsServer()
+{
+    Stop();
+}
+
+bool MetricsServer::Start(const std::string& sEndpoint)
+{
+    m_nListen = Listen(sEndpoint);
+    if(m_nListen < 0)
+    {
+        return false;
+    }
+    pmlLog() << "MetricsServer\tListening on " << sEndpoint;
+
+    m_bRun = true;
+    m_thServer = std::thread(&MetricsServer::ServerThread, this);
+    return true;
+}
+
+void MetricsServer::Stop()
+{
+    if(m_bRun)
+    {
+        m_bRun = false;
+        m_thServer.join();
+    }
+    if(m_nListen >= 0)
+    {
+        close(m_nListen);
+        m_nListen = -1;
+    }
+    if(m_sUnixPath.empty() == false)
+    {
+        unlink(m_sUnixPath.c_str());
+        m_sUnixPath.clear();
+    }
+}
+
+int MetricsServer::Listen(const std::string& sEndpoint)
+{
+    int nSocket(-1);
+    int nError(0);
+    if(sEndpoint.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0)
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::string sPath = sEndpoint.substr(UNIX_PREFIX.size());
+        if(sPath.empty() || sPath.size() >= sizeof(addr.sun_path))
+        {
+            pmlLog(pml::LOG_ERROR) << "MetricsServer\tInvalid socket path '" << sPath << "'";
+            return -1;
+        }
+        strncpy(addr.sun_path, sPath.c_str(), sizeof(addr.sun_path)-1);
+
+        nSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(nSocket >= 0)
+        {
+            unlink(sPath.c_str());  //left behind if we were killed last time
+            nError = bind(nSocket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+            if(nError == 0)
+            {
+                m_sUnixPath = sPath;
+            }
+        }
+    }
+    else
+    {
+        unsigned long nPort = strtoul(sEndpoint.c_str(), nullptr, 10);
+        if(nPort == 0 || nPort > 65535)
+        {
+            pmlLog(pml::LOG_ERROR) << "MetricsServer\tInvalid port '" << sEndpoint << "'";
+            return -1;
+        }
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(nPort));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        nSocket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(nSocket >= 0)
+        {
+            int nReuse(1);
+            setsockopt(nSocket, SOL_SOCKET, SO_REUSEADDR, &nReuse, sizeof(nReuse));
+            nError = bind(nSocket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        }
+    }
+
+    if(nSocket < 0 || nError != 0 || listen(nSocket, BACKLOG) != 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "MetricsServer\tFailed to listen on " << sEndpoint << ": " << strerror(errno);
+        if(nSocket >= 0)
+        {
+            close(nSocket);
+        }
+        return -1;
+    }
+    return nSocket;
+}
+
+void MetricsServer::ServerThread()
+{
+    pollfd pfd;
+    pfd.fd = m_nListen;
+    pfd.events = POLLIN;
+    while(m_bRun)
+    {
+        if(poll(&pfd, 1, POLL_MS) <= 0 || (pfd.revents & POLLIN) == 0)
+        {
+            continue;
+        }
+        int nClient = accept4(m_nListen, nullptr, nullptr, SOCK_CLOEXEC);
+        if(nClient >= 0)
+        {
+            Serve(nClient);
+            close(nClient);
+        }
+    }
+}
+
+void MetricsServer::Serve(int nClient)
+{
+    //we answer any request with the metrics so only need to wait for the end of the request headers, or give up if they never come
+    std::string sRequest;
+    char buffer[1024];
+    pollfd pfd;
+    pfd.fd = nClient;
+    pfd.events = POLLIN;
+    while(sRequest.find("\r\n\r\n") == std::string::npos && sRequest.find("\n\n") == std::string::npos)
+    {
+        if(poll(&pfd, 1, REQUEST_TIMEOUT_MS) <= 0)
+        {
+            return;
+        }
+        ssize_t nRead = recv(nClient, buffer, sizeof(buffer), 0);
+        if(nRead <= 0)
+        {
+            return;
+        }
+        sRequest.append(buffer, nRead);
+    }
+
+    std::ostringstream ssBody;
+    m_pipeline.WriteMetrics(ssBody);
+    std::string sBody = ssBody.str();
+
+    std::ostringstream ssResponse;
+    ssResponse << "HTTP/1.0 200 OK\r\n"
+               << "Content-Type: text/plain; version=0.0.4\r\n"
+               << "Content-Length: " << sBody.size() << "\r\n"
+               << "Connection: close\r\n\r\n"
+               << sBody;
+    std::string sResponse = ssResponse.str();
+
+    size_t nSent = 0;
+    while(nSent < sResponse.size())
+    {
+        ssize_t nWritten = send(nClient, sResponse.data()+nSent, sResponse.size()-nSent, MSG_NOSIGNAL);
+        if(nWritten <= 0)
+        {
+            return;
+        }
+        nSent += nWritten;
+    }
+}
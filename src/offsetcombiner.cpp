@@ -0,0 +1,195 @@
+#include "offsetcombiner.h"
+#include <cmath>
+#include <algorithm>
+
+const double OffsetCombiner::NOISE_FLOOR_DBFS = -48.0;  //the decoder works on 8 bit samples
+const double OffsetCombiner::EDGE_RISE_TIME = 25e-6;    //SMPTE 12M
+const double OffsetCombiner::MIN_DEVIATION = 1e-6;      //offsets are only measured to the microsecond
+
+namespace
+{
+    const double SHARE_SMOOTHING = 16.0;    //frames
+
+    long long ToNs(std::chrono::system_clock::time_point tp)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+    }
+}
+
+OffsetCombiner::OffsetCombiner(size_t nSources) :
+    m_nSources(std::min(nSources, static_cast<size_t>(64))),
+    m_vSlots(SLOTS),
+    m_nNewestNs(0),
+    m_nFrameNs(40000000),
+    m_nEmittedNs(0),
+    m_pContribution(new contribution[std::max(m_nSources, static_cast<size_t>(1))])
+{
+    for(auto& s : m_vSlots)
+    {
+        s.vOffset.resize(m_nSources, 0.0);
+        s.vWeight.resize(m_nSources, 0.0);
+    }
+}
+
+double OffsetCombiner::Weight(const decodedframe& frame) const
+{
+    double dSnr = std::pow(10.0, (frame.fVolume-NOISE_FLOOR_DBFS)/20.0);
+    double dNoise = dSnr > 0.0 ? EDGE_RISE_TIME/(2.0*dSnr) : EDGE_RISE_TIME;
+    return 1.0/(frame.dEdgeJitter*frame.dEdgeJitter + dNoise*dNoise + MIN_DEVIATION*MIN_DEVIATION);
+}
+
+void OffsetCombiner::Add(size_t nSource, const decodedframe& frame, std::chrono::steady_clock::time_point tpQueued, uint64_t nParticipants)
+{
+    if(nSource >= m_nSources)
+    {
+        return;
+    }
+    if(frame.dFPS > 0.0)
+    {
+        m_nFrameNs = static_cast<long long>(1e9/frame.dFPS);
+    }
+
+    long long nLtcNs = ToNs(frame.tpLtc);
+    if(nLtcNs <= m_nEmittedNs)
+    {
+        if(m_nEmittedNs-nLtcNs < static_cast<long long>(SLOTS)*m_nFrameNs)
+        {   //too late, that frame time has already gone on
+            return;
+        }
+        Reset();    //the LTC has gone back
+    }
+
+    //the same frame from sources that share a generator says the same time. Allow a little either way for sources that are each a frame out
+    slot* pSlot(nullptr);
+    slot* pFree(nullptr);
+    slot* pOldest(nullptr);
+    for(auto& s : m_vSlots)
+    {
+        if(s.bUsed == false)
+        {
+            pFree = pFree ? pFree : &s;
+        }
+        else if(std::llabs(s.nLtcNs-nLtcNs) < m_nFrameNs/2)
+        {
+            pSlot = &s;
+        }
+        else if(pOldest == nullptr || s.nLtcNs < pOldest->nLtcNs)
+        {
+            pOldest = &s;
+        }
+    }
+
+    if(pSlot == nullptr)
+    {
+        pSlot = pFree ? pFree : pOldest;    //every slot is waiting on a source that has gone quiet, so give up on the oldest
+        pSlot->bUsed = true;
+        pSlot->nLtcNs = nLtcNs;
+        pSlot->frame = frame;
+        pSlot->tpQueued = tpQueued;
+        pSlot->nHave = 0;
+    }
+    else
+    {
+        pSlot->frame.bDiscontinuity |= frame.bDiscontinuity;
+        pSlot->frame.tpCaptured = std::min(pSlot->frame.tpCaptured, frame.tpCaptured);
+        pSlot->tpQueued = std::min(pSlot->tpQueued, tpQueued);
+    }
+    pSlot->nParticipants = nParticipants;
+    pSlot->nHave |= (1ULL << nSource);
+    pSlot->vOffset[nSource] = static_cast<double>(frame.offset.count())/1e6;
+    pSlot->vWeight[nSource] = Weight(frame);
+
+    m_nNewestNs = std::max(m_nNewestNs, nLtcNs);
+}
+
+bool OffsetCombiner::Next(decodedframe& combined, std::chrono::steady_clock::time_point& tpQueued)
+{
+    slot* pOldest(nullptr);
+    for(auto& s : m_vSlots)
+    {
+        if(s.bUsed && (pOldest == nullptr || s.nLtcNs < pOldest->nLtcNs))
+        {
+            pOldest = &s;
+        }
+    }
+    if(pOldest == nullptr)
+    {
+        return false;
+    }
+
+    //frame times are passed on in order, so if the oldest is still waiting so is everything else
+    bool bComplete = (pOldest->nHave & pOldest->nParticipants) == pOldest->nParticipants;
+    if(!bComplete && pOldest->nLtcNs > m_nNewestNs - MAX_WAIT*m_nFrameNs)
+    {
+        return false;
+    }
+
+    Combine(*pOldest, combined);
+    tpQueued = pOldest->tpQueued;
+    m_nEmittedNs = pOldest->nLtcNs;
+    pOldest->bUsed = false;
+    return true;
+}
+
+void OffsetCombiner::Combine(slot& s, decodedframe& combined)
+{
+    double dTotal(0.0);
+    double dSum(0.0);
+    double dPlain(0.0);
+    size_t nCount(0);
+    for(size_t i = 0; i < m_nSources; i++)
+    {
+        if(s.nHave & (1ULL << i))
+        {
+            dTotal += s.vWeight[i];
+            dSum += s.vWeight[i]*s.vOffset[i];
+            dPlain += s.vOffset[i];
+            nCount++;
+        }
+    }
+    //every frame too weak to give a weight to means a plain average
+    double dOffset = dTotal > 0.0 ? dSum/dTotal : dPlain/static_cast<double>(nCount);
+
+    for(size_t i = 0; i < m_nSources; i++)
+    {
+        contribution& c(m_pContribution[i]);
+        bool bHave = (s.nHave & (1ULL << i)) != 0;
+        double dShare = bHave ? (dTotal > 0.0 ? s.vWeight[i]/dTotal : 1.0/static_cast<double>(nCount)) : 0.0;
+        c.dShare.store(c.dShare.load(std::memory_order_relaxed) + (dShare-c.dShare.load(std::memory_order_relaxed))/SHARE_SMOOTHING, std::memory_order_relaxed);
+        if(bHave)
+        {
+            double dResidual = s.vOffset[i]-dOffset;
+            c.dResidualSq.store(c.dResidualSq.load(std::memory_order_relaxed) + (dResidual*dResidual-c.dResidualSq.load(std::memory_order_relaxed))/SHARE_SMOOTHING,
+                                std::memory_order_relaxed);
+            c.nCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    combined = s.frame;
+    combined.offset = std::chrono::microseconds(std::llround(dOffset*1e6));
+}
+
+void OffsetCombiner::Reset()
+{
+    for(auto& s : m_vSlots)
+    {
+        s.bUsed = false;
+    }
+    m_nNewestNs = 0;
+    m_nEmittedNs = 0;
+}
+
+double OffsetCombiner::GetShare(size_t nSource) const
+{
+    return nSource < m_nSources ? m_pContribution[nSource].dShare.load(std::memory_order_relaxed) : 0.0;
+}
+
+unsigned long long OffsetCombiner::GetContributions(size_t nSource) const
+{
+    return nSource < m_nSources ? m_pContribution[nSource].nCount.load(std::memory_order_relaxed) : 0;
+}
+
+double OffsetCombiner::GetResidual(size_t nSource) const
+{
+    return nSource < m_nSources ? std::sqrt(m_pContribution[nSource].dResidualSq.load(std::memory_order_relaxed)) : 0.0;
+}
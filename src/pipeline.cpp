@@ -0,0 +1,697 @@
+#include "pipeline.h"
+#include "log.h"
+#include "latencyhistogram.h"
+#include "asynclog.h"
+#include <cstdlib>
+#include <algorithm>
+#include <iomanip>
+#include <cstring>
+
+const std::string Pipeline::STR_STAGE[STAGES] = {"capture", "decode", "estimate", "clock"};
+
+namespace
+{
+    const std::chrono::milliseconds SOURCE_TIMEOUT(500);   //a source that has decoded nothing for this long is no longer valid
+    const std::chrono::milliseconds SLEW_CHECK(1000);      //how often the clock thread looks to see whether a slew has finished
+}
+
+Pipeline::Pipeline(unsigned long nSampleRate, unsigned char nChannels, int nDecoderQueue) :
+    m_nSampleRate(nSampleRate),
+    m_nChannels(nChannels),
+    m_nDecoderQueue(nDecoderQueue),
+    m_nActive(0),
+    m_nParticipants(0),
+    m_bCombine(false),
+    m_nFailovers(0),
+    m_nPinned(NO_SOURCE),
+    m_nTruechimers(0),
+    m_nFalsetickers(0),
+    m_bRelock(false),
+    m_bPaused(false),
+    m_qClock(CLOCK_QUEUE_SIZE),
+    m_qServo(SERVO_QUEUE_SIZE),
+    m_offset(m_clock),
+    m_nRecorderCapacity(EventRecorder::DEFAULT_CAPACITY),
+    m_eWakeup(LtcSource::WAKE_DEADLINE),
+    m_nWatermark(LtcSource::CAPTURE_WATERMARK),
+    m_nSlackUs(LtcSource::DEADLINE_SLACK_US),
+    m_bRealtime(false),
+    m_nCaptureFrames(AudioSource::BUFFER_AUTO),
+    m_dCaptureLatency(0.0),
+    m_bRun(false),
+    m_bSynced(false),
+    m_dOffset(0.0),
+    m_dPPM(0.0)
+{
+
+}
+
+Pipeline::~Pipeline()
+{
+    Stop();
+}
+
+void Pipeline::AddSource(LtcSource::enumBackend eBackend, const std::string& sDevice, unsigned char nChannel)
+{
+    if(m_vSources.size() == MAX_SOURCES)
+    {
+        pmlLog(pml::LOG_ERROR) << "Pipeline\tNo more than " << MAX_SOURCES << " sources. " << sDevice << "@" << static_cast<int>(nChannel) << " left out";
+        return;
+    }
+    m_vSources.push_back(std::make_unique<LtcSource>(eBackend, sDevice, nChannel, m_nSampleRate, m_nChannels, m_nDecoderQueue));
+}
+
+void Pipeline::SetServo(const servoconfig& config)
+{
+    if(m_bRun == false)
+    {
+        m_offset.SetConfig(config);
+    }
+    else if(m_qServo.Push(servoconfig(config)) == false)
+    {
+        pmlLog(pml::LOG_WARN) << "Pipeline\tServo settings not applied: the estimate thread has not taken up the last ones yet";
+    }
+}
+
+bool Pipeline::PinSource(size_t nSource)
+{
+    if(nSource != NO_SOURCE && nSource >= m_vSources.size())
+    {
+        return false;
+    }
+    m_nPinned.store(nSource, std::memory_order_release);
+    return true;
+}
+
+SourceSelector::enumState Pipeline::GetSourceState(size_t nSource) const
+{
+    if(nSource >= MAX_SOURCES)
+    {
+        return SourceSelector::INVALID;
+    }
+    if(m_nTruechimers.load(std::memory_order_relaxed) & (1ULL << nSource))
+    {
+        return SourceSelector::TRUECHIMER;
+    }
+    if(m_nFalsetickers.load(std::memory_order_relaxed) & (1ULL << nSource))
+    {
+        return SourceSelector::FALSETICKER;
+    }
+    return SourceSelector::INVALID;
+}
+
+void Pipeline::Relock()
+{
+    for(auto& pSource : m_vSources)
+    {
+        pSource->Relock();
+    }
+    m_bRelock.store(true, std::memory_order_release);
+}
+
+bool Pipeline::IsLocked() const
+{
+    auto state = m_state.Read();
+    return state.nFrames != 0 && std::chrono::steady_clock::now()-std::chrono::steady_clock::time_point(std::chrono::nanoseconds(state.nQueuedNs)) < SOURCE_TIMEOUT;
+}
+
+void Pipeline::SetStageConfig(enumStage eStage, const threadconfig& config)
+{
+    if(eStage < STAGES)
+    {
+        m_config[eStage] = config;
+    }
+}
+
+void Pipeline::SetDecodeWakeup(LtcSource::enumWakeup eWakeup, size_t nWatermark, long long nSlackUs)
+{
+    m_eWakeup = eWakeup;
+    m_nWatermark = nWatermark;
+    m_nSlackUs = nSlackUs;
+}
+
+void Pipeline::SetCaptureBuffer(unsigned long nFrames, double dLatency)
+{
+    m_nCaptureFrames = nFrames;
+    m_dCaptureLatency = dLatency;
+}
+
+void Pipeline::ApplyRealtime()
+{
+    LockMemory();
+
+    const int nPriority[STAGES] = {RT_PRIORITY_CAPTURE, RT_PRIORITY_DECODE, RT_PRIORITY_ESTIMATE, RT_PRIORITY_CLOCK};
+    for(int i = 0; i < STAGES; i++)
+    {
+        if(m_config[i].nPriority == 0)
+        {
+            m_config[i].nPriority = nPriority[i];
+        }
+        pmlLog() << "Pipeline\t" << STR_STAGE[i] << "\tpriority=" << m_config[i].nPriority << "\tcpu=" << m_config[i].nCpu;
+    }
+}
+
+bool Pipeline::Start()
+{
+    if(m_vSources.empty())
+    {
+        pmlLog(pml::LOG_ERROR) << "Pipeline\tNo LTC sources";
+        return false;
+    }
+    if(m_bRealtime)
+    {
+        ApplyRealtime();
+    }
+    if(m_sRecorderPath.empty() == false)
+    {   //carry on without it if it can't be opened
+        m_recorder.Open(m_sRecorderPath, m_nRecorderCapacity);
+    }
+
+    m_nActive = 0;
+    m_nParticipants = 1;
+    m_vSources[0]->SetActive(true);
+    if(m_bCombine && m_vSources.size() > 1)
+    {
+        m_pCombiner = std::make_unique<OffsetCombiner>(m_vSources.size());
+    }
+
+    m_bRun = true;
+    m_thClock = std::thread(&Pipeline::ClockThread, this);
+    m_thEstimate = std::thread(&Pipeline::EstimateThread, this);
+
+    //a source that can't be opened is left out and the selector will never pick it, but there must be at least one
+    size_t nStarted(0);
+    for(auto& pSource : m_vSources)
+    {
+        pSource->SetDecodeWakeup(m_eWakeup, m_nWatermark, m_nSlackUs);
+        pSource->SetCaptureBuffer(m_nCaptureFrames, m_dCaptureLatency);
+        if(pSource->Start(m_config[CAPTURE], m_config[DECODE]))
+        {
+            nStarted++;
+        }
+    }
+    if(nStarted == 0)
+    {
+        Stop();
+        return false;
+    }
+    pmlLog() << "Pipeline\t" << nStarted << " of " << m_vSources.size() << " LTC sources started";
+    return true;
+}
+
+void Pipeline::Stop()
+{
+    //stop the audio and decoding first so nothing more gets pushed in to the pipeline
+    for(auto& pSource : m_vSources)
+    {
+        pSource->Stop();
+    }
+
+    if(m_bRun)
+    {
+        m_bRun = false;
+        for(auto& pSource : m_vSources)
+        {
+            pSource->GetDecoded().Wake();
+        }
+        m_qClock.Wake();
+
+        m_thEstimate.join();
+        m_thClock.join();
+    }
+}
+
+void Pipeline::EstimateThread()
+{
+    ConfigureThread(STR_STAGE[ESTIMATE], m_config[ESTIMATE]);
+
+    estimatestate state;
+    state.nSteps = m_clock.GetStepCount();
+    size_t nSource(m_nActive.load(std::memory_order_acquire));
+
+    decodedframe decoded;
+    std::chrono::steady_clock::time_point tpQueued;
+    while(m_bRun)
+    {
+        if(m_bRelock.exchange(false, std::memory_order_acq_rel))
+        {   //the sources will pass their next frames on as discontinuities so all that is left to forget is the servo's own state
+            m_offset.Reset();
+            if(m_pCombiner)
+            {
+                m_pCombiner->Reset();
+            }
+            state.bAwaitStep = false;
+        }
+
+        size_t nActive = m_nActive.load(std::memory_order_acquire);
+        if(nActive != nSource && m_pCombiner)
+        {   //the new source was already one of those being combined so nothing changes but which queue we wait on
+            nSource = nActive;
+            state.bFailover = true;
+        }
+        else if(nActive != nSource)
+        {   //anything the new source still has queued is from the last time it was active so is stale. The regression starts again so the
+            //difference between the two sources' offsets isn't taken for a frequency error, but the frequency is kept and there is no step:
+            //the selector only fails over to a source that agrees with the others so the servo just slews to it
+            SpscQueue<decodedframe>& stale(m_vSources[nActive]->GetDecoded());
+            while(stale.Pop(decoded, tpQueued))
+            {
+            }
+            m_offset.Discontinuity();
+            nSource = nActive;
+            state.bFailover = true;
+        }
+
+        SpscQueue<decodedframe>& queue(m_vSources[nSource]->GetDecoded());
+        queue.Wait();
+
+        servoconfig servo;
+        while(m_qServo.Pop(servo, tpQueued))
+        {
+            m_offset.SetConfig(servo);
+            logAsync(pml::LOG_INFO, "Pipeline\tServo: window=", servo.nWindow, " frames\tstep threshold=", servo.dStepThreshold, "s\tslew within=",
+                     servo.dSlewPPM, "ppm");
+        }
+        if(m_pCombiner)
+        {   //woken by the active source, by when the others will have given the same frame or will have by the next time
+            uint64_t nParticipants = m_nParticipants.load(std::memory_order_acquire);
+            for(size_t i = 0; i < m_vSources.size(); i++)
+            {
+                SpscQueue<decodedframe>& source(m_vSources[i]->GetDecoded());
+                while(source.Pop(decoded, tpQueued))
+                {
+                    if(nParticipants & (1ULL << i))
+                    {
+                        m_pCombiner->Add(i, decoded, tpQueued, nParticipants);
+                    }
+                }
+            }
+            while(m_pCombiner->Next(decoded, tpQueued))
+            {
+                Estimate(decoded, tpQueued, nSource, framerecord::FLAG_COMBINED, state);
+            }
+        }
+        else
+        {
+            while(queue.Pop(decoded, tpQueued))
+            {
+                Estimate(decoded, tpQueued, nSource, 0, state);
+                if(m_nActive.load(std::memory_order_acquire) != nSource)
+                {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void Pipeline::Estimate(const decodedframe& decoded, std::chrono::steady_clock::time_point tpQueued, size_t nSource, unsigned char nFlags, estimatestate& state)
+{
+    m_wakeup[ESTIMATE].Add(std::chrono::steady_clock::now()-tpQueued);
+    if(state.bAwaitStep)
+    {   //offsets measured before the clock was stepped are meaningless afterwards so throw them away
+        if(m_clock.GetStepCount() == state.nSteps || decoded.tpCaptured < m_clock.GetLastStepTime())
+        {
+            RecordFrame(decoded, clockcommand(), nFlags | framerecord::FLAG_DISCARDED, nSource);
+            return;
+        }
+        state.bAwaitStep = false;
+    }
+
+    if(decoded.bDiscontinuity)
+    {
+        m_offset.Discontinuity();
+    }
+
+    bool bPaused = m_bPaused.load(std::memory_order_acquire);
+    if(state.bPaused && !bPaused)
+    {   //the servo went on as if the commands it gave while paused had been carried out, so none of what it thinks now can be trusted
+        m_offset.Reset();
+    }
+    state.bPaused = bPaused;
+
+    LATENCY_RECORD(LATENCY_END_TO_END, std::chrono::system_clock::now()-decoded.tpFrameEnd);
+    LATENCY_START(tpAdd);
+    auto command = m_offset.Add(decoded.offset, 0, decoded.dFPS);
+    LATENCY_END(LATENCY_OFFSET_ADD, tpAdd);
+    m_dOffset.store(static_cast<double>(decoded.offset.count())/1e6, std::memory_order_relaxed);
+    m_dPPM.store(m_offset.GetPPM(), std::memory_order_relaxed);
+    m_bSynced.store(m_offset.IsSynced(), std::memory_order_relaxed);
+    RecordFrame(decoded, command, nFlags | (decoded.bDiscontinuity ? framerecord::FLAG_DISCONTINUITY : 0) | (m_offset.IsSynced() ? framerecord::FLAG_SYNCED : 0)
+                | (state.bFailover ? framerecord::FLAG_FAILOVER : 0) | (bPaused ? framerecord::FLAG_PAUSED : 0), nSource);
+    state.bFailover = false;
+    state.nFrames++;
+
+    pipelinestate published;
+    published.nFrames = state.nFrames;
+    published.nLtcNs = std::chrono::duration_cast<std::chrono::nanoseconds>(decoded.tpLtc.time_since_epoch()).count();
+    published.nQueuedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(tpQueued.time_since_epoch()).count();
+    published.frame = decoded.frame;
+    published.dFPS = decoded.dFPS;
+    published.dOffset = static_cast<double>(decoded.offset.count())/1e6;
+    published.dPPM = m_offset.GetPPM();
+    published.fVolume = decoded.fVolume;
+    published.nSource = static_cast<uint8_t>(nSource);
+    published.bSynced = m_offset.IsSynced();
+    published.bCombined = (nFlags & framerecord::FLAG_COMBINED) != 0;
+    published.bPaused = bPaused;
+    m_state.Write(published);
+
+    if(command.eType != clockcommand::NONE && !bPaused)
+    {
+        if(command.eType == clockcommand::STEP)
+        {
+            state.nSteps = m_clock.GetStepCount();
+            state.bAwaitStep = true;
+        }
+        m_qClock.Push(std::move(command));
+    }
+
+    if(m_offset.IsSynced() && !state.bSynced)
+    {
+        logAsync(pml::LOG_INFO, "Synced to LTC");
+        state.bSynced =true;
+    }
+    else if(!m_offset.IsSynced() && state.bSynced)
+    {
+        logAsync(pml::LOG_WARN, "Lost sync to LTC");
+        state.bSynced = false;
+    }
+
+    m_stats[ESTIMATE].Add(std::chrono::steady_clock::now()-tpQueued);
+}
+
+void Pipeline::RecordFrame(const decodedframe& decoded, const clockcommand& command, unsigned char nFlags, size_t nSource)
+{
+    if(m_recorder.IsOpen() == false)
+    {
+        return;
+    }
+    framerecord record;
+    record.nLtcNs = std::chrono::duration_cast<std::chrono::nanoseconds>(decoded.tpLtc.time_since_epoch()).count();
+    record.nOffsetUs = decoded.offset.count();
+    record.nCaptureNs = record.nLtcNs - record.nOffsetUs*1000;
+    record.nFrameStart = decoded.nFrameStart;
+    record.nFrameEnd = decoded.nFrameEnd;
+    record.dCommandValue = command.dValue;
+    record.fVolume = decoded.fVolume;
+    record.fFPS = decoded.dFPS;
+    record.fPPM = m_offset.GetPPM();
+    record.nRejected = decoded.nRejected;
+    memcpy(record.raw, &decoded.frame, sizeof(record.raw));
+    record.nCommand = command.eType;
+    record.nFlags = nFlags;
+    record.nSource = static_cast<uint8_t>(nSource);
+    m_recorder.Record(record);
+}
+
+void Pipeline::ClockThread()
+{
+    ConfigureThread(STR_STAGE[CLOCK], m_config[CLOCK]);
+
+    clockcommand command;
+    std::chrono::steady_clock::time_point tpQueued;
+    while(m_bRun)
+    {
+        if(m_clock.IsSlewPending())
+        {   //the servo gives no more commands until the slew has finished, so there would be nothing to wake us to see that it has
+            m_qClock.WaitUntil(std::chrono::steady_clock::now()+SLEW_CHECK);
+        }
+        else
+        {
+            m_qClock.Wait();
+        }
+        while(m_qClock.Pop(command, tpQueued))
+        {
+            m_wakeup[CLOCK].Add(std::chrono::steady_clock::now()-tpQueued);
+            m_clock.Execute(command);
+            m_stats[CLOCK].Add(std::chrono::steady_clock::now()-tpQueued);
+        }
+        //after the commands, or on the next look while a slew runs
+        m_clock.CheckSlew();
+    }
+}
+
+void Pipeline::Service()
+{
+    for(auto& pSource : m_vSources)
+    {
+        pSource->Service();
+    }
+    SelectSource();
+    m_recorder.Flush();
+}
+
+void Pipeline::SelectSource()
+{
+    if(m_vSources.size() < 2)
+    {
+        return;
+    }
+
+    //a source is valid while it is still decoding frames
+    auto tpNow = std::chrono::steady_clock::now();
+    std::vector<sourcesample> vSamples(m_vSources.size());
+    std::vector<SourceSelector::enumState> vBefore(m_vSources.size());
+    for(size_t i = 0; i < m_vSources.size(); i++)
+    {
+        vSamples[i].bValid = m_vSources[i]->IsRunning() && tpNow-m_vSources[i]->GetLastFrameTime() < SOURCE_TIMEOUT;
+        vSamples[i].dOffset = m_vSources[i]->GetOffset();
+        vSamples[i].dJitter = m_vSources[i]->GetJitter();
+        vBefore[i] = m_selector.GetState(i);
+    }
+
+    bool bMajority = m_selector.HasMajority();
+    size_t nActive = m_nActive.load(std::memory_order_relaxed);
+    size_t nSelected = m_selector.Select(vSamples, nActive, tpNow);
+
+    //a source that has been asked for is followed whatever the selector makes of it, but only while it is decoding
+    size_t nPinned = m_nPinned.load(std::memory_order_acquire);
+    bool bPinned = nPinned < m_vSources.size() && vSamples[nPinned].bValid;
+    if(bPinned)
+    {
+        nSelected = nPinned;
+    }
+
+    uint64_t nTruechimers(0);
+    uint64_t nFalsetickers(0);
+    for(size_t i = 0; i < m_vSources.size(); i++)
+    {
+        nTruechimers |= (m_selector.GetState(i) == SourceSelector::TRUECHIMER ? (1ULL << i) : 0);
+        nFalsetickers |= (m_selector.GetState(i) == SourceSelector::FALSETICKER ? (1ULL << i) : 0);
+        if(m_selector.GetState(i) != vBefore[i])
+        {
+            pmlLog(m_selector.GetState(i) == SourceSelector::TRUECHIMER ? pml::LOG_INFO : pml::LOG_WARN) << "Pipeline\tSource " << m_vSources[i]->GetName()
+                   << " is now " << SourceSelector::STR_STATE[m_selector.GetState(i)] << "\toffset=" << vSamples[i].dOffset << "s\tjitter=" << vSamples[i].dJitter << "s";
+        }
+    }
+    if(bMajority != m_selector.HasMajority())
+    {
+        pmlLog(m_selector.HasMajority() ? pml::LOG_INFO : pml::LOG_WARN) << "Pipeline\t" << (m_selector.HasMajority() ? "Sources agree" : "No majority of sources agree");
+    }
+
+    m_nTruechimers.store(nTruechimers, std::memory_order_relaxed);
+    m_nFalsetickers.store(nFalsetickers, std::memory_order_relaxed);
+
+    if(nSelected != nActive && bPinned)
+    {
+        pmlLog() << "Pipeline\tSwitch from " << m_vSources[nActive]->GetName() << " to " << m_vSources[nSelected]->GetName() << " as asked";
+    }
+    else if(nSelected != nActive)
+    {
+        pmlLog(pml::LOG_WARN) << "Pipeline\tFail over from " << m_vSources[nActive]->GetName() << " (" << SourceSelector::STR_STATE[m_selector.GetState(nActive)]
+                              << ") to " << m_vSources[nSelected]->GetName();
+        m_nFailovers.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    //when combining every truechimer is used as long as they are a majority, and the active source always is
+    uint64_t nParticipants = (1ULL << nSelected);
+    for(size_t i = 0; m_pCombiner && m_selector.HasMajority() && i < m_vSources.size(); i++)
+    {
+        if(m_selector.GetState(i) == SourceSelector::TRUECHIMER)
+        {
+            nParticipants |= (1ULL << i);
+        }
+    }
+    if(nSelected == nActive && nParticipants == m_nParticipants.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    if(m_pCombiner)
+    {
+        pmlLog() << "Pipeline\tCombining " << __builtin_popcountll(nParticipants) << " of " << m_vSources.size() << " sources";
+    }
+
+    //sources start queueing frames before the estimate thread is told to look for them. It is woken in case it is asleep waiting for a source
+    //that has gone quiet
+    for(size_t i = 0; i < m_vSources.size(); i++)
+    {
+        if(nParticipants & (1ULL << i))
+        {
+            m_vSources[i]->SetActive(true);
+        }
+    }
+    m_nParticipants.store(nParticipants, std::memory_order_release);
+    m_nActive.store(nSelected, std::memory_order_release);
+    for(size_t i = 0; i < m_vSources.size(); i++)
+    {
+        if((nParticipants & (1ULL << i)) == 0)
+        {
+            m_vSources[i]->SetActive(false);
+        }
+    }
+    m_vSources[nActive]->GetDecoded().Wake();
+}
+
+void Pipeline::LogDecoderEvents()
+{
+    for(auto& pSource : m_vSources)
+    {
+        pSource->LogEvents();
+    }
+}
+
+void Pipeline::LogMetrics()
+{
+    for(size_t i = 0; i < m_vSources.size(); i++)
+    {
+        LtcSource& source(*m_vSources[i]);
+        const AudioSource* pInput = source.GetInput();
+        if(pInput)
+        {
+            pmlLog() << "Pipeline\t" << STR_STAGE[CAPTURE] << "\t" << source.GetName() << "\tbuffer=" << pInput->GetBufferSize() << " frames\tsuggested latency=" << pInput->GetSuggestedLatency()
+                     << "s\tinput latency=" << pInput->GetInputLatency() << "s\toverflows=" << pInput->GetOverflowCount() << "\tdiscontinuities=" << pInput->GetDiscontinuityCount()
+                     << "\tpool misses=" << pInput->GetPoolMisses();
+            LogStage(STR_STAGE[CAPTURE]+"\t"+source.GetName(), source.GetInput()->GetStats(), nullptr);
+        }
+        if(m_pCombiner)
+        {
+            pmlLog() << "Pipeline\tsource\t" << source.GetName() << "\t" << (i == m_nActive.load(std::memory_order_relaxed) ? "active" : "standby")
+                     << "\t" << SourceSelector::STR_STATE[m_selector.GetState(i)] << "\toffset=" << source.GetOffset() << "s\tjitter=" << source.GetJitter() << "s"
+                     << "\tweight=" << m_pCombiner->GetShare(i)*100.0 << "%\tcombined=" << m_pCombiner->GetContributions(i) << "\tresidual=" << m_pCombiner->GetResidual(i) << "s";
+        }
+        else if(m_vSources.size() > 1)
+        {
+            pmlLog() << "Pipeline\tsource\t" << source.GetName() << "\t" << (i == m_nActive.load(std::memory_order_relaxed) ? "active" : "standby")
+                     << "\t" << SourceSelector::STR_STATE[m_selector.GetState(i)] << "\toffset=" << source.GetOffset() << "s\tjitter=" << source.GetJitter() << "s";
+        }
+        LogQueue(STR_STAGE[DECODE]+"\t"+source.GetName(), source.GetCapture());
+        LogStage(STR_STAGE[DECODE]+"\t"+source.GetName(), source.GetStats(), &source.GetWakeupStats());
+        LogQueue(STR_STAGE[ESTIMATE]+"\t"+source.GetName(), source.GetDecoded());
+    }
+    LogStage(STR_STAGE[ESTIMATE], m_stats[ESTIMATE], &m_wakeup[ESTIMATE]);
+    LogQueue(STR_STAGE[CLOCK], m_qClock);
+    LogStage(STR_STAGE[CLOCK], m_stats[CLOCK], &m_wakeup[CLOCK]);
+}
+
+void Pipeline::LogStage(const std::string& sName, stagestats& stats, stagestats* pWakeup)
+{
+    auto nCount = stats.nCount.load(std::memory_order_relaxed);
+    auto nMean = nCount ? stats.nTotalNs.load(std::memory_order_relaxed)/nCount : 0;
+    if(pWakeup == nullptr)
+    {   //the capture stage is woken by the driver not by a queue
+        pmlLog() << "Pipeline\t" << sName << "\tcount=" << nCount << "\tmean=" << nMean/1000 << "us\tmax=" << stats.TakeMaxNs()/1000 << "us";
+    }
+    else
+    {
+        pmlLog() << "Pipeline\t" << sName << "\tcount=" << nCount << "\tmean=" << nMean/1000 << "us\tmax=" << stats.TakeMaxNs()/1000 << "us"
+                 << "\tworst wakeup=" << pWakeup->TakeMaxNs()/1000 << "us";
+    }
+}
+
+template<typename T> void Pipeline::LogQueue(const std::string& sName, const SpscQueue<T>& queue)
+{
+    pmlLog() << "Pipeline\t" << sName << " queue\tdepth=" << queue.Size() << "/" << queue.GetCapacity()
+             << "\tpeak=" << queue.GetHighWatermark() << "\tdropped=" << queue.GetDropped()
+             << "\twakeups=" << queue.GetWakeupCount() << "\tnotified=" << queue.GetNotifyCount();
+}
+
+void Pipeline::WriteMetrics(std::ostream& os) const
+{
+    os << std::setprecision(10);    //enough for microseconds in an offset of hours
+    os << "# HELP ltcclient_locked 1 if the active source has given a frame recently, as the control socket reports it\n# TYPE ltcclient_locked gauge\n"
+       << "ltcclient_locked " << (IsLocked() ? 1 : 0) << "\n";
+    os << "# HELP ltcclient_synced 1 if the servo has the system clock synced to the LTC\n# TYPE ltcclient_synced gauge\n"
+       << "ltcclient_synced " << (m_bSynced.load(std::memory_order_relaxed) ? 1 : 0) << "\n";
+    os << "# HELP ltcclient_offset_seconds Last measured offset of the LTC from the system clock\n# TYPE ltcclient_offset_seconds gauge\n"
+       << "ltcclient_offset_seconds " << m_dOffset.load(std::memory_order_relaxed) << "\n";
+    os << "# HELP ltcclient_frequency_ppm Estimated frequency error of the system clock\n# TYPE ltcclient_frequency_ppm gauge\n"
+       << "ltcclient_frequency_ppm " << m_dPPM.load(std::memory_order_relaxed) << "\n";
+    os << "# HELP ltcclient_clock_steps_total Times the system clock has been stepped\n# TYPE ltcclient_clock_steps_total counter\n"
+       << "ltcclient_clock_steps_total " << m_clock.GetStepCount() << "\n";
+    os << "# HELP ltcclient_source_failovers_total Times the active source has been changed\n# TYPE ltcclient_source_failovers_total counter\n"
+       << "ltcclient_source_failovers_total " << m_nFailovers.load(std::memory_order_relaxed) << "\n";
+    os << "# HELP ltcclient_discipline_paused 1 if the servo's commands are not being carried out\n# TYPE ltcclient_discipline_paused gauge\n"
+       << "ltcclient_discipline_paused " << (m_bPaused.load(std::memory_order_relaxed) ? 1 : 0) << "\n";
+
+    //everything from here on is per source
+    size_t nActive = m_nActive.load(std::memory_order_relaxed);
+    WriteSourceMetrics(os, "ltcclient_source_active", "gauge", "1 if the clock is following this source", [nActive](const LtcSource& source, size_t nSource){ return nSource == nActive ? 1 : 0;});
+    WriteSourceMetrics(os, "ltcclient_source_offset_seconds", "gauge", "Smoothed offset of the source's LTC from the system clock", [](const LtcSource& source, size_t){ return source.GetOffset();});
+    WriteSourceMetrics(os, "ltcclient_source_jitter_seconds", "gauge", "RMS variation of the source's offset", [](const LtcSource& source, size_t){ return source.GetJitter();});
+    if(m_pCombiner)
+    {
+        const OffsetCombiner& combiner(*m_pCombiner);
+        WriteSourceMetrics(os, "ltcclient_source_weight", "gauge", "The source's share of the weight when offsets are combined", [&combiner](const LtcSource&, size_t nSource){ return combiner.GetShare(nSource);});
+        WriteSourceMetrics(os, "ltcclient_source_combined_total", "counter", "Combined offsets the source has been part of", [&combiner](const LtcSource&, size_t nSource){ return combiner.GetContributions(nSource);});
+        WriteSourceMetrics(os, "ltcclient_source_residual_seconds", "gauge", "RMS difference of the source's offset from the combined offset", [&combiner](const LtcSource&, size_t nSource){ return combiner.GetResidual(nSource);});
+    }
+    WriteSourceMetrics(os, "ltcclient_signal_level_dbfs", "gauge", "Level of the signal that carried the last LTC frame", [](const LtcSource& source, size_t){ return source.GetVolume();});
+    WriteSourceMetrics(os, "ltcclient_frames_decoded_total", "counter", "LTC frames decoded", [](const LtcSource& source, size_t){ return source.GetFramesDecoded();});
+    WriteSourceMetrics(os, "ltcclient_frames_rejected_total", "counter", "LTC frames rejected by parity and prediction", [](const LtcSource& source, size_t){ return source.GetRejected();});
+    WriteSourceMetrics(os, "ltcclient_frames_corrected_total", "counter", "LTC frames with a single bit error corrected", [](const LtcSource& source, size_t){ return source.GetCorrected();});
+    WriteSourceMetrics(os, "ltcclient_decoder_overflows_total", "counter", "LTC frames lost because the decoder's queue was full", [](const LtcSource& source, size_t){ return source.GetDecoderOverflows();});
+    WriteSourceMetrics(os, "ltcclient_discontinuities_total", "counter", "Times samples were lost and the decoder reset", [](const LtcSource& source, size_t){ return source.GetDiscontinuities();});
+    WriteSourceMetrics(os, "ltcclient_capture_overflows_total", "counter", "Capture overruns (xruns) reported by the audio device", [](const LtcSource& source, size_t){ return source.GetInput() ? source.GetInput()->GetOverflowCount() : 0ULL;});
+    WriteSourceMetrics(os, "ltcclient_capture_pool_misses_total", "counter", "Capture blocks that had to be allocated", [](const LtcSource& source, size_t){ return source.GetInput() ? source.GetInput()->GetPoolMisses() : 0ULL;});
+
+    os << "# HELP ltcclient_queue_depth Entries waiting in the queue in to each stage\n# TYPE ltcclient_queue_depth gauge\n";
+    for(const auto& pSource : m_vSources)
+    {
+        WriteQueueMetrics(os, STR_STAGE[DECODE], pSource->GetName(), pSource->GetCapture());
+        WriteQueueMetrics(os, STR_STAGE[ESTIMATE], pSource->GetName(), pSource->GetDecoded());
+    }
+    WriteQueueMetrics(os, STR_STAGE[CLOCK], "", m_qClock);
+    os << "# HELP ltcclient_queue_dropped_total Entries dropped because the queue in to a stage was full\n# TYPE ltcclient_queue_dropped_total counter\n";
+    for(const auto& pSource : m_vSources)
+    {
+        os << "ltcclient_queue_dropped_total{stage=\"" << STR_STAGE[DECODE] << "\",source=\"" << pSource->GetName() << "\"} " << pSource->GetCapture().GetDropped() << "\n";
+        os << "ltcclient_queue_dropped_total{stage=\"" << STR_STAGE[ESTIMATE] << "\",source=\"" << pSource->GetName() << "\"} " << pSource->GetDecoded().GetDropped() << "\n";
+    }
+    os << "ltcclient_queue_dropped_total{stage=\"" << STR_STAGE[CLOCK] << "\"} " << m_qClock.GetDropped() << "\n";
+
+    os << "# HELP ltcclient_stage_latency_seconds Time from an item being queued for a stage to the stage finishing with it\n# TYPE ltcclient_stage_latency_seconds summary\n";
+    for(const auto& pSource : m_vSources)
+    {
+        if(pSource->GetInput())
+        {
+            WriteStageMetrics(os, STR_STAGE[CAPTURE], pSource->GetName(), pSource->GetInput()->GetStats());
+        }
+        WriteStageMetrics(os, STR_STAGE[DECODE], pSource->GetName(), pSource->GetStats());
+    }
+    WriteStageMetrics(os, STR_STAGE[ESTIMATE], "", m_stats[ESTIMATE]);
+    WriteStageMetrics(os, STR_STAGE[CLOCK], "", m_stats[CLOCK]);
+
+    WriteLatencyMetrics(os);
+}
+
+template<typename F> void Pipeline::WriteSourceMetrics(std::ostream& os, const std::string& sMetric, const std::string& sType, const std::string& sHelp, F value) const
+{
+    os << "# HELP " << sMetric << " " << sHelp << "\n# TYPE " << sMetric << " " << sType << "\n";
+    for(size_t i = 0; i < m_vSources.size(); i++)
+    {
+        os << sMetric << "{source=\"" << m_vSources[i]->GetName() << "\"} " << value(*m_vSources[i], i) << "\n";
+    }
+}
+
+template<typename T> void Pipeline::WriteQueueMetrics(std::ostream& os, const std::string& sStage, const std::string& sSource, const SpscQueue<T>& queue) const
+{
+    os << "ltcclient_queue_depth{stage=\"" << sStage << "\"" << (sSource.empty() ? "" : ",source=\""+sSource+"\"") << "} " << queue.Size() << "\n";
+}
+
+void Pipeline::WriteStageMetrics(std::ostream& os, const std::string& sStage, const std::string& sSource, const stagestats& stats) const
+{
+    std::string sLabels = "{stage=\""+sStage+"\""+(sSource.empty() ? "" : ",source=\""+sSource+"\"")+"}";
+    os << "ltcclient_stage_latency_seconds_sum" << sLabels << " " << static_cast<double>(stats.nTotalNs.load(std::memory_order_relaxed))/1e9 << "\n"
+       << "ltcclient_stage_latency_seconds_count" << sLabels << " " << stats.nCount.load(std::memory_order_relaxed) << "\n";
+}
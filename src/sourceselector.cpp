@@ -0,0 +1,124 @@
+#include "sourceselector.h"
+#include <algorithm>
+#include <utility>
+
+const double SourceSelector::DEFAULT_TOLERANCE = 0.002;
+const double SourceSelector::JITTER_FACTOR = 4.0;
+const std::chrono::seconds SourceSelector::HOLDOFF(2);
+const std::string SourceSelector::STR_STATE[3] = {"invalid", "truechimer", "falseticker"};
+
+SourceSelector::SourceSelector() :
+    m_dTolerance(DEFAULT_TOLERANCE),
+    m_bMajority(false)
+{
+
+}
+
+double SourceSelector::Distance(const sourcesample& sample) const
+{
+    return std::max(m_dTolerance, JITTER_FACTOR*sample.dJitter);
+}
+
+bool SourceSelector::Intersect(const std::vector<sourcesample>& vSamples, double& dLow, double& dHigh) const
+{
+    //each interval as a lower edge (-1), midpoint (0) and upper edge (+1), sorted so a lower edge comes before an upper one at the same place
+    std::vector<std::pair<double, int>> vEdges;
+    for(const auto& sample : vSamples)
+    {
+        if(sample.bValid)
+        {
+            double dDistance = Distance(sample);
+            vEdges.push_back({sample.dOffset-dDistance, -1});
+            vEdges.push_back({sample.dOffset, 0});
+            vEdges.push_back({sample.dOffset+dDistance, 1});
+        }
+    }
+    std::sort(vEdges.begin(), vEdges.end());
+
+    //the RFC 5905 clock select: allow for more and more falsetickers until the rest agree, but never as many as half
+    int nSources = static_cast<int>(vEdges.size()/3);
+    for(int nAllow = 0; 2*nAllow < nSources; nAllow++)
+    {
+        int nFound = 0;
+        int nChime = 0;
+        for(auto it = vEdges.begin(); it != vEdges.end(); ++it)
+        {
+            nChime -= it->second;
+            if(nChime >= nSources-nAllow)
+            {
+                dLow = it->first;
+                break;
+            }
+            if(it->second == 0)
+            {
+                nFound++;
+            }
+        }
+        nChime = 0;
+        for(auto it = vEdges.rbegin(); it != vEdges.rend(); ++it)
+        {
+            nChime += it->second;
+            if(nChime >= nSources-nAllow)
+            {
+                dHigh = it->first;
+                break;
+            }
+            if(it->second == 0)
+            {
+                nFound++;
+            }
+        }
+        if(nFound <= nAllow && dLow <= dHigh)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t SourceSelector::Select(const std::vector<sourcesample>& vSamples, size_t nActive, std::chrono::steady_clock::time_point tpNow)
+{
+    m_vState.resize(vSamples.size(), INVALID);
+    m_vValidSince.resize(vSamples.size(), tpNow);
+
+    double dLow(0.0);
+    double dHigh(0.0);
+    m_bMajority = Intersect(vSamples, dLow, dHigh);
+
+    for(size_t i = 0; i < vSamples.size(); i++)
+    {
+        if(vSamples[i].bValid == false)
+        {
+            m_vState[i] = INVALID;
+            continue;
+        }
+        if(m_vState[i] == INVALID)
+        {
+            m_vValidSince[i] = tpNow;
+        }
+        //without a majority there is nothing to go on so a falseticker stays one until the sources agree again
+        double dDistance = Distance(vSamples[i]);
+        bool bFalse = m_bMajority ? (vSamples[i].dOffset+dDistance < dLow || vSamples[i].dOffset-dDistance > dHigh) : (m_vState[i] == FALSETICKER);
+        m_vState[i] = bFalse ? FALSETICKER : TRUECHIMER;
+    }
+
+    if(nActive < vSamples.size() && m_vState[nActive] == TRUECHIMER)
+    {
+        return nActive;
+    }
+
+    //fail over to the best source that has been valid long enough. If there is none carry on with the active one
+    size_t nBest = nActive;
+    double dBest(0.0);
+    bool bFound(false);
+    for(size_t i = 0; i < vSamples.size(); i++)
+    {
+        if(m_vState[i] == TRUECHIMER && tpNow-m_vValidSince[i] >= HOLDOFF && (!bFound || Distance(vSamples[i]) < dBest))
+        {
+            nBest = i;
+            dBest = Distance(vSamples[i]);
+            bFound = true;
+        }
+    }
+    return nBest;
+}
@@ -0,0 +1,207 @@
+#include "timecodeindex.h"
+
+namespace
+{
+    const int DAYS_PER_CYCLE = 4*365+1;     //leap year first
+    const int YEARS = 100;
+
+    //drop frame: 10 minute blocks of one 1800 frame minute then nine 1798 frame ones
+    const long long DF_FRAMES_PER_MINUTE = 30*60-2;
+    const long long DF_FRAMES_PER_10_MINUTES = 30*60 + 9*DF_FRAMES_PER_MINUTE;
+
+    struct bcd
+    {
+        unsigned char nTens;
+        unsigned char nUnits;
+    };
+
+    struct tables
+    {
+        bcd digits[100];
+        unsigned short nMonthStart[2][13];  //day of the year each month starts on, normal then leap
+        unsigned char nMonth[2][366];       //month and day of the month for each day of the year
+        unsigned char nDay[2][366];
+        unsigned short nCycleStart[5];      //day each year of a four year cycle starts on
+        long long nDfMinuteStart[10];       //frame each minute of a 10 minute drop frame block starts on
+    };
+
+    constexpr tables MakeTables()
+    {
+        tables t{};
+        for(int i = 0; i < 100; i++)
+        {
+            t.digits[i].nTens = i/10;
+            t.digits[i].nUnits = i%10;
+        }
+
+        const int DAYS_IN_MONTH[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
+        for(int nLeap = 0; nLeap < 2; nLeap++)
+        {
+            int nStart = 0;
+            for(int nMonth = 0; nMonth < 12; nMonth++)
+            {
+                t.nMonthStart[nLeap][nMonth] = nStart;
+                int nDays = DAYS_IN_MONTH[nMonth] + (nMonth == 1 ? nLeap : 0);
+                for(int nDay = 0; nDay < nDays; nDay++)
+                {
+                    t.nMonth[nLeap][nStart+nDay] = nMonth+1;
+                    t.nDay[nLeap][nStart+nDay] = nDay+1;
+                }
+                nStart += nDays;
+            }
+            t.nMonthStart[nLeap][12] = nStart;
+        }
+
+        for(int nYear = 0; nYear < 5; nYear++)
+        {
+            t.nCycleStart[nYear] = nYear == 0 ? 0 : 366 + (nYear-1)*365;
+        }
+
+        for(int nMinute = 0; nMinute < 10; nMinute++)
+        {
+            t.nDfMinuteStart[nMinute] = nMinute == 0 ? 0 : 30*60 + (nMinute-1)*DF_FRAMES_PER_MINUTE;
+        }
+        return t;
+    }
+
+    constexpr tables TABLES = MakeTables();
+    static_assert(TABLES.nMonthStart[0][12] == 365 && TABLES.nMonthStart[1][12] == 366, "calendar table");
+    static_assert(TABLES.nCycleStart[4] == DAYS_PER_CYCLE, "leap cycle table");
+
+    long long Wrap(long long nValue, long long nRange)
+    {
+        nValue %= nRange;
+        return nValue < 0 ? nValue+nRange : nValue;
+    }
+}
+
+TimecodeIndex::TimecodeIndex(unsigned int nFPS, bool bDropFrame) :
+    m_nFPS(nFPS),
+    m_bDropFrame(bDropFrame && nFPS == 30),
+    m_nFramesPerDay(m_bDropFrame ? 24*6*DF_FRAMES_PER_10_MINUTES : 86400LL*nFPS)
+{
+
+}
+
+long long TimecodeIndex::FrameOfDay(int nHours, int nMinutes, int nSeconds, int nFrame) const
+{
+    if(nHours > 23 || nMinutes > 59 || nSeconds > 59 || nFrame >= m_nFPS)
+    {
+        return -1;
+    }
+    if(m_bDropFrame == false)
+    {
+        return ((nHours*60LL + nMinutes)*60 + nSeconds)*m_nFPS + nFrame;
+    }
+
+    int nMinuteInBlock = nMinutes%10;
+    if(nMinuteInBlock != 0 && nSeconds == 0 && nFrame < 2)
+    {   //dropped label
+        return -1;
+    }
+    return (nHours*6LL + nMinutes/10)*DF_FRAMES_PER_10_MINUTES + TABLES.nDfMinuteStart[nMinuteInBlock] + nSeconds*30 + nFrame
+           - (nMinuteInBlock != 0 ? 2 : 0);
+}
+
+long long TimecodeIndex::Day(int nYear, int nMonth, int nDay) const
+{
+    if(nYear >= YEARS || nMonth < 1 || nMonth > 12 || nDay < 1)
+    {
+        return -1;
+    }
+    int nLeap = (nYear%4) == 0 ? 1 : 0;
+    if(TABLES.nMonthStart[nLeap][nMonth-1]+nDay > TABLES.nMonthStart[nLeap][nMonth])
+    {
+        return -1;
+    }
+    return (nYear/4)*DAYS_PER_CYCLE + TABLES.nCycleStart[nYear%4] + TABLES.nMonthStart[nLeap][nMonth-1] + nDay-1;
+}
+
+long long TimecodeIndex::ToIndex(const SMPTETimecode& stime, int nFlags) const
+{
+    long long nFrame = FrameOfDay(stime.hours, stime.mins, stime.secs, stime.frame);
+    if(nFrame < 0 || (nFlags & LTC_USE_DATE) == 0)
+    {
+        return nFrame;
+    }
+    long long nDay = Day(stime.years, stime.months, stime.days);
+    return nDay < 0 ? -1 : nDay*m_nFramesPerDay + nFrame;
+}
+
+long long TimecodeIndex::ToIndex(const LTCFrame& frame, int nFlags) const
+{
+    SMPTETimecode stime;
+    stime.hours = frame.hours_tens*10 + frame.hours_units;
+    stime.mins = frame.mins_tens*10 + frame.mins_units;
+    stime.secs = frame.secs_tens*10 + frame.secs_units;
+    stime.frame = frame.frame_tens*10 + frame.frame_units;
+    stime.years = frame.user6*10 + frame.user5;
+    stime.months = frame.user4*10 + frame.user3;
+    stime.days = frame.user2*10 + frame.user1;
+    return ToIndex(stime, nFlags);
+}
+
+void TimecodeIndex::ToTimecode(long long nIndex, SMPTETimecode& stime, int nFlags) const
+{
+    long long nFrame;
+    if(nFlags & LTC_USE_DATE)
+    {
+        long long nAll = Wrap(nIndex, m_nFramesPerDay*(YEARS/4)*DAYS_PER_CYCLE);
+        long long nDay = nAll/m_nFramesPerDay;
+        nFrame = nAll%m_nFramesPerDay;
+
+        int nInCycle = nDay%DAYS_PER_CYCLE;
+        int nYearInCycle = nInCycle < TABLES.nCycleStart[1] ? 0 : 1 + (nInCycle-TABLES.nCycleStart[1])/365;
+        int nLeap = nYearInCycle == 0 ? 1 : 0;
+        int nDayOfYear = nInCycle - TABLES.nCycleStart[nYearInCycle];
+        stime.years = (nDay/DAYS_PER_CYCLE)*4 + nYearInCycle;
+        stime.months = TABLES.nMonth[nLeap][nDayOfYear];
+        stime.days = TABLES.nDay[nLeap][nDayOfYear];
+    }
+    else
+    {
+        nFrame = Wrap(nIndex, m_nFramesPerDay);
+    }
+
+    long long nLabel = nFrame;
+    if(m_bDropFrame)
+    {   //count the dropped labels back in: 2 for every minute past the first of each 10 minute block
+        long long nRemainder = nFrame%DF_FRAMES_PER_10_MINUTES;
+        nLabel += 18*(nFrame/DF_FRAMES_PER_10_MINUTES) + (nRemainder < 30*60 ? 0 : 2*(1 + (nRemainder-30*60)/DF_FRAMES_PER_MINUTE));
+    }
+    long long nSeconds = nLabel/m_nFPS;
+    stime.frame = nLabel%m_nFPS;
+    stime.secs = nSeconds%60;
+    stime.mins = (nSeconds/60)%60;
+    stime.hours = nSeconds/3600;
+}
+
+void TimecodeIndex::ToFrame(long long nIndex, LTCFrame& frame, LTC_TV_STANDARD eStandard, int nFlags) const
+{
+    SMPTETimecode stime;
+    ToTimecode(nIndex, stime, nFlags);
+
+    frame.hours_tens = TABLES.digits[stime.hours].nTens;
+    frame.hours_units = TABLES.digits[stime.hours].nUnits;
+    frame.mins_tens = TABLES.digits[stime.mins].nTens;
+    frame.mins_units = TABLES.digits[stime.mins].nUnits;
+    frame.secs_tens = TABLES.digits[stime.secs].nTens;
+    frame.secs_units = TABLES.digits[stime.secs].nUnits;
+    frame.frame_tens = TABLES.digits[stime.frame].nTens;
+    frame.frame_units = TABLES.digits[stime.frame].nUnits;
+    frame.dfbit = m_bDropFrame ? 1 : 0;
+
+    if(nFlags & LTC_USE_DATE)
+    {
+        frame.user6 = TABLES.digits[stime.years].nTens;
+        frame.user5 = TABLES.digits[stime.years].nUnits;
+        frame.user4 = TABLES.digits[stime.months].nTens;
+        frame.user3 = TABLES.digits[stime.months].nUnits;
+        frame.user2 = TABLES.digits[stime.days].nTens;
+        frame.user1 = TABLES.digits[stime.days].nUnits;
+    }
+    if((nFlags & LTC_NO_PARITY) == 0)
+    {
+        ltc_frame_set_parity(&frame, eStandard);
+    }
+}
@@ -1,7 +1,35 @@
 #include "utils.h"
+#include "log.h"
+#include "asynclog.h"
 #include <ctime>
 #include <iomanip>
 #include <cmath>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <malloc.h>
+#include <unistd.h>
+
+namespace
+{
+    const size_t STACK_PREFAULT = 256*1024;
+    const long FALLBACK_PAGE_BYTES = 4096;
+
+    void PrefaultStack()
+    {
+        //one write per page is all it takes, and pages are larger than 4k on some kernels
+        long nPageBytes = sysconf(_SC_PAGESIZE);
+        size_t nStep = static_cast<size_t>(nPageBytes > 0 ? nPageBytes : FALLBACK_PAGE_BYTES);
+
+        unsigned char stack[STACK_PREFAULT];
+        volatile unsigned char* pStack = stack;     //volatile so the writes are not optimised away
+        for(size_t i = 0; i < STACK_PREFAULT; i += nStep)
+        {
+            pStack[i] = 0;
+        }
+    }
+}
 
 std::string ConvertTimeToIsoString(std::time_t t, unsigned long nMicro)
 {
@@ -23,3 +51,66 @@ std::chrono::microseconds DoubleToMicro(double dDuration)
     return std::chrono::microseconds(static_cast<long long>(dDuration*1e6));
 
 }
+
+bool ConfigureThread(const std::string& sName, const threadconfig& config, bool bAsyncLog)
+{
+    bool bOk(true);
+
+    pthread_setname_np(pthread_self(), sName.substr(0, 15).c_str());    //names are limited to 16 chars including the terminator
+
+    if(config.nCpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(config.nCpu, &cpus);
+        int nError = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if(nError != 0)
+        {
+            if(bAsyncLog)
+            {
+                logAsync(pml::LOG_ERROR, sName, "\tFailed to pin to cpu ", config.nCpu, ": ", strerror(nError));
+            }
+            else
+            {
+                pmlLog(pml::LOG_ERROR) << sName << "\tFailed to pin to cpu " << config.nCpu << ": " << strerror(nError);
+            }
+            bOk = false;
+        }
+    }
+
+    if(config.nPriority > 0)
+    {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = config.nPriority;
+        int nError = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if(nError != 0)
+        {
+            if(bAsyncLog)
+            {
+                logAsync(pml::LOG_ERROR, sName, "\tFailed to set SCHED_FIFO priority ", config.nPriority, ": ", strerror(nError));
+            }
+            else
+            {
+                pmlLog(pml::LOG_ERROR) << sName << "\tFailed to set SCHED_FIFO priority " << config.nPriority << ": " << strerror(nError);
+            }
+            bOk = false;
+        }
+        PrefaultStack();
+    }
+    return bOk;
+}
+
+bool LockMemory()
+{
+    //keep freed memory in the heap rather than trimming it or using mmap so it stays locked
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        pmlLog(pml::LOG_ERROR) << "Failed to lock memory: " << strerror(errno);
+        return false;
+    }
+    return true;
+}
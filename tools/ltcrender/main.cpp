@@ -0,0 +1,162 @@
+//Renders a run of LTC to a WAV file for use as a test fixture, splitting the work across every core
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "ltc.h"
+
+using namespace std;
+
+namespace
+{
+    const unsigned long SAMPLE_RATE = 48000;
+
+    struct wavheader
+    {
+        char sRiff[4] = {'R','I','F','F'};
+        uint32_t nRiffSize = 0;
+        char sWave[4] = {'W','A','V','E'};
+        char sFmt[4] = {'f','m','t',' '};
+        uint32_t nFmtSize = 16;
+        uint16_t nFormat = 1;
+        uint16_t nChannels = 1;
+        uint32_t nSampleRate = 0;
+        uint32_t nByteRate = 0;
+        uint16_t nBlockAlign = 0;
+        uint16_t nBitsPerSample = 0;
+        char sData[4] = {'d','a','t','a'};
+        uint32_t nDataSize = 0;
+    } __attribute__((packed));
+
+    void Usage(const char* pName)
+    {
+        cerr << "Usage: " << pName << " <output.wav> <hh:mm:ss:ff> <frames> [fps] [yyyy-mm-dd] [float|s16]" << endl
+             << "\tfps is 24, 25 (default), 29.97 (drop frame) or 30. Giving a date puts it in the user bits" << endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 4)
+    {
+        Usage(argv[0]);
+        return -1;
+    }
+
+    SMPTETimecode start;
+    memset(&start, 0, sizeof(start));
+    strcpy(start.timezone, "+0000");
+    int nHours, nMinutes, nSeconds, nFrame;
+    if(sscanf(argv[2], "%d:%d:%d%*[:;.]%d", &nHours, &nMinutes, &nSeconds, &nFrame) != 4)
+    {
+        Usage(argv[0]);
+        return -1;
+    }
+    start.hours = nHours;
+    start.mins = nMinutes;
+    start.secs = nSeconds;
+    start.frame = nFrame;
+
+    long long nFrames = stoll(argv[3]);
+    double dFPS = argc > 4 ? stod(argv[4]) : 25.0;
+    int nFlags = 0;
+    if(argc > 5)
+    {
+        int nYear, nMonth, nDay;
+        if(sscanf(argv[5], "%d-%d-%d", &nYear, &nMonth, &nDay) != 3)
+        {
+            Usage(argv[0]);
+            return -1;
+        }
+        start.years = nYear%100;
+        start.months = nMonth;
+        start.days = nDay;
+        nFlags = LTC_USE_DATE;
+    }
+    bool bFloat = !(argc > 6 && string(argv[6]) == "s16");
+
+    if(dFPS > 29.96 && dFPS < 29.98)
+    {
+        dFPS = 30000.0/1001.0;
+    }
+    LTC_TV_STANDARD eStandard = (dFPS == 25.0) ? LTC_TV_625_50 : (dFPS == 24.0 ? LTC_TV_FILM_24 : LTC_TV_525_60);
+    LTCEncoder* pEncoder = ltc_encoder_create(SAMPLE_RATE, dFPS, eStandard, nFlags);
+    if(pEncoder == nullptr || nFrames <= 0)
+    {
+        Usage(argv[0]);
+        return -1;
+    }
+    ltc_encoder_set_volume(pEncoder, -18.0);
+
+    //the output is sized up front and mapped so every thread renders straight into its own part of it
+    size_t nSampleSize = bFloat ? sizeof(float) : sizeof(short);
+    long long nSamples = ltc_encoder_render_offset(pEncoder, nFrames);
+    size_t nDataSize = nSamples*nSampleSize;
+    if(nDataSize > 0xFFFFFFFFULL - sizeof(wavheader))
+    {
+        cerr << "Too long for a WAV file" << endl;
+        return -1;
+    }
+
+    int nFd = open(argv[1], O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(nFd < 0 || ftruncate(nFd, sizeof(wavheader)+nDataSize) != 0)
+    {
+        cerr << "Failed to create " << argv[1] << ": " << strerror(errno) << endl;
+        return -1;
+    }
+    void* pMap = mmap(nullptr, sizeof(wavheader)+nDataSize, PROT_READ | PROT_WRITE, MAP_SHARED, nFd, 0);
+    close(nFd);
+    if(pMap == MAP_FAILED)
+    {
+        cerr << "Failed to map " << argv[1] << ": " << strerror(errno) << endl;
+        return -1;
+    }
+
+    wavheader header;
+    header.nRiffSize = sizeof(wavheader)-8+nDataSize;
+    header.nFormat = bFloat ? 3 : 1;
+    header.nSampleRate = SAMPLE_RATE;
+    header.nByteRate = SAMPLE_RATE*nSampleSize;
+    header.nBlockAlign = nSampleSize;
+    header.nBitsPerSample = nSampleSize*8;
+    header.nDataSize = nDataSize;
+    memcpy(pMap, &header, sizeof(header));
+    unsigned char* pData = reinterpret_cast<unsigned char*>(pMap)+sizeof(wavheader);
+
+    unsigned int nThreads = std::max(1u, std::thread::hardware_concurrency());
+    long long nPerThread = (nFrames+nThreads-1)/nThreads;
+    vector<thread> vThreads;
+    for(long long nFirst = 0; nFirst < nFrames; nFirst += nPerThread)
+    {
+        long long nCount = std::min(nPerThread, nFrames-nFirst);
+        vThreads.emplace_back([=, &start]()
+        {
+            unsigned char* pSegment = pData + ltc_encoder_render_offset(pEncoder, nFirst)*nSampleSize;
+            if(bFloat)
+            {
+                ltc_encoder_render_float(pEncoder, &start, nFirst, nCount, reinterpret_cast<float*>(pSegment));
+            }
+            else
+            {
+                ltc_encoder_render_s16(pEncoder, &start, nFirst, nCount, reinterpret_cast<short*>(pSegment));
+            }
+        });
+    }
+    for(auto& th : vThreads)
+    {
+        th.join();
+    }
+
+    munmap(pMap, sizeof(wavheader)+nDataSize);
+    ltc_encoder_free(pEncoder);
+
+    cout << "Wrote " << nFrames << " frames, " << nSamples << " samples on " << vThreads.size() << " threads to " << argv[1] << endl;
+    return 0;
+}
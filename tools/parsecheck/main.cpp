@@ -0,0 +1,170 @@
+//Runs a fixed set of generated LTC through the decoder and prints every frame it queues, field by field, on stdout.
+//Build the Current and Reference targets, which use src/decoder.c and the copy in reference/, run both and cmp what they print
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include "ltc.h"
+
+using namespace std;
+
+namespace
+{
+    const double FPS[] = {24.0, 25.0, 29.97, 30.0};
+    const unsigned long SAMPLE_RATES[] = {44100, 48000};
+    enum enumPlay {FORWARD, REVERSE, NOISY, PLAYS};
+    const string STR_PLAY[PLAYS] = {"forward", "reverse", "noisy"};
+
+    const int FRAMES_PER_RUN = 400;
+    const int GAP_EVERY = 97;           //frames between bursts of noise in the signal
+    const size_t MAX_WRITE = 3000;      //samples handed to the decoder at a time are anything up to this
+    const int QUEUE_SIZE = 64;
+    const int NOISE_BLOCKS = 2000;
+    const size_t NOISE_BLOCK = 4096;
+
+    //our own generator so every build, whatever its C library, feeds the decoder exactly the same
+    uint32_t g_nSeed = 12345;
+    uint32_t Random()
+    {
+        g_nSeed = g_nSeed*1103515245u + 12345u;
+        return g_nSeed >> 8;
+    }
+
+    struct counts
+    {
+        unsigned long nFrames = 0;
+        unsigned long nReversed = 0;
+    };
+
+    void Drain(LTCDecoder* pDecoder, counts& total)
+    {
+        LTCFrameExt frame;
+        while(ltc_decoder_read(pDecoder, &frame))
+        {
+            const unsigned char* pRaw = reinterpret_cast<const unsigned char*>(&frame.ltc);
+            cout << hex << setfill('0');
+            for(size_t i = 0; i < sizeof(frame.ltc); i++)
+            {
+                cout << setw(2) << static_cast<int>(pRaw[i]);
+            }
+            cout << dec << setfill(' ') << fixed
+                 << " " << frame.off_start << " " << frame.off_end << " " << setprecision(6) << static_cast<double>(frame.reverse)
+                 << " " << setprecision(3) << frame.volume << " " << static_cast<int>(frame.sample_min) << " " << static_cast<int>(frame.sample_max)
+                 << setprecision(4);
+            for(size_t i = 0; i < LTC_FRAME_BIT_COUNT; i++)
+            {
+                cout << " " << frame.biphase_tics[i];
+            }
+            cout << "\n";
+
+            total.nFrames++;
+            total.nReversed += (frame.reverse != 0);
+        }
+    }
+
+    vector<ltcsnd_sample_t> Generate(unsigned long nSampleRate, double dFPS, int nRun)
+    {
+        LTCEncoder* pEncoder = ltc_encoder_create(nSampleRate, dFPS, dFPS == 25.0 ? LTC_TV_625_50 : (dFPS == 24.0 ? LTC_TV_FILM_24 : LTC_TV_525_60), LTC_USE_DATE);
+        SMPTETimecode start;
+        memset(&start, 0, sizeof(start));
+        strcpy(start.timezone, "+0100");
+        start.years = 26;
+        start.months = 10;
+        start.days = 19;
+        start.hours = nRun;
+        start.mins = 59;
+        start.secs = 50;
+        ltc_encoder_set_timecode(pEncoder, &start);
+
+        vector<ltcsnd_sample_t> vSignal;
+        for(int nFrame = 0; nFrame < FRAMES_PER_RUN; nFrame++)
+        {
+            ltc_encoder_encode_frame(pEncoder);
+            int nLength(0);
+            ltcsnd_sample_t* pBuffer = ltc_encoder_get_bufptr(pEncoder, &nLength, 1);
+            vSignal.insert(vSignal.end(), pBuffer, pBuffer+nLength);
+            ltc_encoder_inc_timecode(pEncoder);
+
+            if(nFrame%GAP_EVERY == 13)
+            {   //the decoder has to find the sync word again afterwards
+                size_t nGap = 500 + Random()%1500;
+                for(size_t i = 0; i < nGap; i++)
+                {
+                    vSignal.push_back(128 + (Random()%64) - 32);
+                }
+            }
+        }
+        ltc_encoder_free(pEncoder);
+        return vSignal;
+    }
+
+    void Decode(const vector<ltcsnd_sample_t>& vSignal, int nApv, counts& total)
+    {
+        LTCDecoder* pDecoder = ltc_decoder_create(nApv, QUEUE_SIZE);
+        ltc_off_t nPos(0);
+        for(size_t i = 0; i < vSignal.size();)
+        {
+            size_t nWrite = std::min<size_t>(1 + Random()%MAX_WRITE, vSignal.size()-i);
+            ltc_decoder_write(pDecoder, const_cast<ltcsnd_sample_t*>(vSignal.data())+i, nWrite, nPos);
+            nPos += nWrite;
+            i += nWrite;
+            Drain(pDecoder, total);
+        }
+        ltc_decoder_free(pDecoder);
+    }
+}
+
+int main()
+{
+    counts total;
+    int nRun(0);
+    for(int nPlay = 0; nPlay < PLAYS; nPlay++)
+    {
+        for(unsigned long nSampleRate : SAMPLE_RATES)
+        {
+            for(double dFPS : FPS)
+            {
+                vector<ltcsnd_sample_t> vSignal = Generate(nSampleRate, dFPS, nRun);
+                if(nPlay == REVERSE)
+                {
+                    reverse(vSignal.begin(), vSignal.end());
+                }
+                else if(nPlay == NOISY)
+                {   //quieter, with noise on top and the odd sample flipped
+                    for(auto& sample : vSignal)
+                    {
+                        int nValue = (static_cast<int>(sample)-128)*(1+(nRun&1))/3 + static_cast<int>(Random()%90) - 45;
+                        if(Random()%500 == 0)
+                        {
+                            nValue = -nValue;
+                        }
+                        sample = static_cast<ltcsnd_sample_t>(std::max(0, std::min(255, nValue+128)));
+                    }
+                }
+                Decode(vSignal, static_cast<int>(nSampleRate/dFPS), total);
+                cerr << STR_PLAY[nPlay] << " " << dFPS << "fps at " << nSampleRate << "Hz: " << total.nFrames << " frames so far" << endl;
+                nRun++;
+            }
+        }
+    }
+
+    //nothing here should ever be taken for a frame
+    LTCDecoder* pDecoder = ltc_decoder_create(1920, QUEUE_SIZE);
+    vector<ltcsnd_sample_t> vNoise(NOISE_BLOCK);
+    for(int nBlock = 0; nBlock < NOISE_BLOCKS; nBlock++)
+    {
+        for(auto& sample : vNoise)
+        {
+            sample = (Random() & 1) ? 200 : 56;
+        }
+        ltc_decoder_write(pDecoder, vNoise.data(), vNoise.size(), static_cast<ltc_off_t>(nBlock)*NOISE_BLOCK);
+        Drain(pDecoder, total);
+    }
+    ltc_decoder_free(pDecoder);
+
+    cerr << total.nFrames << " frames, " << total.nReversed << " of them reversed" << endl;
+    return 0;
+}
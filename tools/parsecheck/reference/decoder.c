@@ -0,0 +1,618 @@
+/*
+   libltc - en+decode linear timecode
+
+   Copyright (C) 2005 Maarten de Boer <mdeboer@iua.upf.es>
+   Copyright (C) 2006-2016 Robin Gareus <robin@gareus.org>
+   Copyright (C) 2008-2009 Jan <jan@geheimwerk.de>
+
+   Binary constant generator macro for endianess conversion
+   by Tom Torfs - donated to the public domain
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The decoder as it was before parse_ltc assembled frames in a shift register, kept unchanged so parsecheck
+ * can compare the two. Only the frame assembly differs from src/decoder.c at the time it was copied
+ */
+
+/** turn a numeric literal into a hex constant
+ *  (avoids problems with leading zeroes)
+ *  8-bit constants max value 0x11111111, always fits in unsigned long
+ */
+#define HEX__(n) 0x##n##LU
+
+/**
+ * 8-bit conversion function
+ */
+#define B8__(x) ((x&0x0000000FLU)?1:0)	\
+	+((x&0x000000F0LU)?2:0)	 \
+	+((x&0x00000F00LU)?4:0)	 \
+	+((x&0x0000F000LU)?8:0)	 \
+	+((x&0x000F0000LU)?16:0) \
+	+((x&0x00F00000LU)?32:0) \
+	+((x&0x0F000000LU)?64:0) \
+	+((x&0xF0000000LU)?128:0)
+
+/** for upto 8-bit binary constants */
+#define B8(d) ((unsigned char)B8__(HEX__(d)))
+
+/** for upto 16-bit binary constants, MSB first */
+#define B16(dmsb,dlsb) (((unsigned short)B8(dmsb)<<8) + B8(dlsb))
+
+/** turn a numeric literal into a hex constant
+ *(avoids problems with leading zeroes)
+ * 8-bit constants max value 0x11111111, always fits in unsigned long
+ */
+#define HEX__(n) 0x##n##LU
+
+/** 8-bit conversion function */
+#define B8__(x) ((x&0x0000000FLU)?1:0)	\
+	+((x&0x000000F0LU)?2:0)  \
+	+((x&0x00000F00LU)?4:0)  \
+	+((x&0x0000F000LU)?8:0)  \
+	+((x&0x000F0000LU)?16:0) \
+	+((x&0x00F00000LU)?32:0) \
+	+((x&0x0F000000LU)?64:0) \
+	+((x&0xF0000000LU)?128:0)
+
+
+/** for upto 8-bit binary constants */
+#define B8(d) ((unsigned char)B8__(HEX__(d)))
+
+/** for upto 16-bit binary constants, MSB first */
+#define B16(dmsb,dlsb) (((unsigned short)B8(dmsb)<<8) + B8(dlsb))
+
+/* Example usage:
+ * B8(01010101) = 85
+ * B16(10101010,01010101) = 43605
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "decoder.h"
+
+#define DEBUG_DUMP(msg, f) \
+{ \
+	int _ii; \
+	printf("%s", msg); \
+	for (_ii=0; _ii < (LTC_FRAME_BIT_COUNT >> 3); _ii++) { \
+		const unsigned char _bit = ((unsigned char*)(f))[_ii]; \
+		printf("%c", (_bit & B8(10000000) ) ? '1' : '0'); \
+		printf("%c", (_bit & B8(01000000) ) ? '1' : '0'); \
+		printf("%c", (_bit & B8(00100000) ) ? '1' : '0'); \
+		printf("%c", (_bit & B8(00010000) ) ? '1' : '0'); \
+		printf("%c", (_bit & B8(00001000) ) ? '1' : '0'); \
+		printf("%c", (_bit & B8(00000100) ) ? '1' : '0'); \
+		printf("%c", (_bit & B8(00000010) ) ? '1' : '0'); \
+		printf("%c", (_bit & B8(00000001) ) ? '1' : '0'); \
+		printf(" "); \
+	}\
+	printf("\n"); \
+}
+
+#if (defined _MSC_VER && _MSC_VER <= 1800)
+#define inline __inline
+#endif
+
+#if (!defined INFINITY && defined _MSC_VER)
+#define INFINITY std::numeric_limits<double>::infinity()
+#endif
+#if (!defined INFINITY && defined HUGE_VAL)
+#define INFINITY HUGE_VAL
+#endif
+
+static double calc_volume_db(LTCDecoder *d) {
+	if (d->snd_to_biphase_max <= d->snd_to_biphase_min)
+		return -INFINITY;
+	return (20.0 * log10((d->snd_to_biphase_max - d->snd_to_biphase_min) / 255.0));
+}
+
+/* move the queue write position on. If the reader has not kept up the
+ * oldest unread frame is dropped and the overflow is counted.
+ * A queued frame also means the tracking path is locked.
+ */
+static inline void queue_advance(LTCDecoder *d) {
+	d->acq_since_frame = 0;
+	if (d->acq_state == LTC_ACQ_SEARCH)
+		d->acq_state = LTC_ACQ_OFF;
+
+	d->queue_write_off++;
+
+	if (d->queue_write_off == d->queue_len)
+		d->queue_write_off = 0;
+
+	if (d->queue_write_off == d->queue_read_off) {
+		d->queue_read_off++;
+		if (d->queue_read_off == d->queue_len)
+			d->queue_read_off = 0;
+		d->queue_overflows++;
+	}
+}
+
+static inline int queue_full(LTCDecoder *d) {
+	int next = d->queue_write_off + 1;
+	if (next == d->queue_len)
+		next = 0;
+	return next == d->queue_read_off;
+}
+
+static void parse_ltc(LTCDecoder *d, unsigned char bit, ltc_off_t offset, ltc_off_t posinfo) {
+	int bit_num, bit_set, byte_num;
+
+	if (d->bit_cnt == 0) {
+		memset(&d->ltc_frame, 0, sizeof(LTCFrame));
+
+		if (d->frame_start_prev < 0) {
+			d->frame_start_off = posinfo - d->snd_to_biphase_period;
+		} else {
+			d->frame_start_off = d->frame_start_prev;
+		}
+	}
+	d->frame_start_prev = offset + posinfo;
+
+	if (d->bit_cnt >= LTC_FRAME_BIT_COUNT) {
+		/* shift bits backwards */
+		int k = 0;
+		const int byte_num_max = LTC_FRAME_BIT_COUNT >> 3;
+
+		for (k=0; k< byte_num_max; k++) {
+			const unsigned char bi = ((unsigned char*)&d->ltc_frame)[k];
+			unsigned char bo = 0;
+			bo |= (bi & B8(10000000) ) ? B8(01000000) : 0;
+			bo |= (bi & B8(01000000) ) ? B8(00100000) : 0;
+			bo |= (bi & B8(00100000) ) ? B8(00010000) : 0;
+			bo |= (bi & B8(00010000) ) ? B8(00001000) : 0;
+			bo |= (bi & B8(00001000) ) ? B8(00000100) : 0;
+			bo |= (bi & B8(00000100) ) ? B8(00000010) : 0;
+			bo |= (bi & B8(00000010) ) ? B8(00000001) : 0;
+			if (k+1 < byte_num_max) {
+				bo |= ( (((unsigned char*)&d->ltc_frame)[k+1]) & B8(00000001) ) ? B8(10000000): B8(00000000);
+			}
+			((unsigned char*)&d->ltc_frame)[k] = bo;
+		}
+
+		d->frame_start_off += ceil(d->snd_to_biphase_period);
+		d->bit_cnt--;
+	}
+
+	d->decoder_sync_word <<= 1;
+	if (bit) {
+
+		d->decoder_sync_word |= B16(00000000,00000001);
+
+		if (d->bit_cnt < LTC_FRAME_BIT_COUNT) {
+			// Isolating the lowest three bits: the location of this bit in the current byte
+			bit_num = (d->bit_cnt & B8(00000111));
+			// Using the bit number to define which of the eight bits to set
+			bit_set = (B8(00000001) << bit_num);
+			// Isolating the higher bits: the number of the byte/char the target bit is contained in
+			byte_num = d->bit_cnt >> 3;
+
+			(((unsigned char*)&d->ltc_frame)[byte_num]) |= bit_set;
+		}
+
+	}
+	d->bit_cnt++;
+
+	if (d->decoder_sync_word == B16(00111111,11111101) /*LTC Sync Word 0x3ffd*/) {
+		if (d->bit_cnt == LTC_FRAME_BIT_COUNT) {
+			int bc;
+
+			memcpy( &d->queue[d->queue_write_off].ltc,
+				&d->ltc_frame,
+				sizeof(LTCFrame));
+
+			for(bc = 0; bc < LTC_FRAME_BIT_COUNT; ++bc) {
+				const int btc = (d->biphase_tic + bc ) % LTC_FRAME_BIT_COUNT;
+				d->queue[d->queue_write_off].biphase_tics[bc] = d->biphase_tics[btc];
+			}
+
+			d->queue[d->queue_write_off].off_start = d->frame_start_off;
+			d->queue[d->queue_write_off].off_end = posinfo + (ltc_off_t) offset - 1LL;
+			d->queue[d->queue_write_off].reverse = 0;
+			d->queue[d->queue_write_off].volume = calc_volume_db(d);
+			d->queue[d->queue_write_off].sample_min = d->snd_to_biphase_min;
+			d->queue[d->queue_write_off].sample_max = d->snd_to_biphase_max;
+
+			queue_advance(d);
+		}
+		d->bit_cnt = 0;
+	}
+
+	if (d->decoder_sync_word == B16(10111111,11111100) /* reverse sync-word*/) {
+		if (d->bit_cnt == LTC_FRAME_BIT_COUNT) {
+			/* reverse frame */
+			int bc;
+			int k = 0;
+			int byte_num_max = LTC_FRAME_BIT_COUNT >> 3;
+
+			/* swap bits */
+			for (k=0; k< byte_num_max; k++) {
+				const unsigned char bi = ((unsigned char*)&d->ltc_frame)[k];
+				unsigned char bo = 0;
+				bo |= (bi & B8(10000000) ) ? B8(00000001) : 0;
+				bo |= (bi & B8(01000000) ) ? B8(00000010) : 0;
+				bo |= (bi & B8(00100000) ) ? B8(00000100) : 0;
+				bo |= (bi & B8(00010000) ) ? B8(00001000) : 0;
+				bo |= (bi & B8(00001000) ) ? B8(00010000) : 0;
+				bo |= (bi & B8(00000100) ) ? B8(00100000) : 0;
+				bo |= (bi & B8(00000010) ) ? B8(01000000) : 0;
+				bo |= (bi & B8(00000001) ) ? B8(10000000) : 0;
+				((unsigned char*)&d->ltc_frame)[k] = bo;
+			}
+
+			/* swap bytes */
+			byte_num_max-=2; // skip sync-word
+			for (k=0; k< (byte_num_max)/2; k++) {
+				const unsigned char bi = ((unsigned char*)&d->ltc_frame)[k];
+				((unsigned char*)&d->ltc_frame)[k] = ((unsigned char*)&d->ltc_frame)[byte_num_max-1-k];
+				((unsigned char*)&d->ltc_frame)[byte_num_max-1-k] = bi;
+			}
+
+			memcpy( &d->queue[d->queue_write_off].ltc,
+				&d->ltc_frame,
+				sizeof(LTCFrame));
+
+			for(bc = 0; bc < LTC_FRAME_BIT_COUNT; ++bc) {
+				const int btc = (d->biphase_tic + bc ) % LTC_FRAME_BIT_COUNT;
+				d->queue[d->queue_write_off].biphase_tics[bc] = d->biphase_tics[btc];
+			}
+
+			d->queue[d->queue_write_off].off_start = d->frame_start_off - 16 * d->snd_to_biphase_period;
+			d->queue[d->queue_write_off].off_end = posinfo + (ltc_off_t) offset - 1LL - 16 * d->snd_to_biphase_period;
+			d->queue[d->queue_write_off].reverse = (LTC_FRAME_BIT_COUNT >> 3) * 8 * d->snd_to_biphase_period;
+			d->queue[d->queue_write_off].volume = calc_volume_db(d);
+			d->queue[d->queue_write_off].sample_min = d->snd_to_biphase_min;
+			d->queue[d->queue_write_off].sample_max = d->snd_to_biphase_max;
+
+			queue_advance(d);
+		}
+		d->bit_cnt = 0;
+	}
+}
+
+/* -+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * Correlation based acquisition
+ *
+ * The tracking path below needs clean edges crossing the envelope
+ * hysteresis thresholds and a perfect sync word. For weak or heavily
+ * filtered signals that may never happen, so while there is no lock
+ * every sample is also given a soft decision: for a bit cell ending at
+ * that sample, are the two halves of the cell of opposite sign (biphase
+ * '1') or the same sign ('0')? The soft decisions one bit period apart
+ * are correlated against the sync word for a few candidate bit periods.
+ *
+ * When the correlation peaks above the threshold the strongest candidate
+ * is locked on to. A clean signal is handed straight to the tracking path.
+ * A weak one is decoded from the soft decisions, one per bit period, until
+ * the signal is good enough to hand over. Once the tracking path is
+ * producing frames none of this runs so the per-sample cost is unchanged.
+ */
+
+/* bit period of the candidates relative to the period derived from apv (24, 25 and 30fps when apv is for 25fps) */
+static const double acq_rates[LTC_ACQ_RATES] = {25.0/24.0, 1.0, 25.0/30.0};
+
+/* correlation needed (out of LTC_ACQ_SYNC_BITS) to accept a sync word */
+#define LTC_ACQ_THRESHOLD 13.0f
+/* mean soft decision strength above which the tracking path can cope with the signal */
+#define LTC_ACQ_CLEAN 0.97f
+/* lock is considered lost if nothing is decoded for this many bits */
+#define LTC_ACQ_LOST_BITS (2 * LTC_FRAME_BIT_COUNT)
+
+#define ACQ_MASK (LTC_ACQ_HISTORY - 1)
+
+void acquisition_init(LTCDecoder *d, double period) {
+	int r, k;
+	for (r = 0; r < LTC_ACQ_RATES; r++) {
+		d->acq_period[r] = period * acq_rates[r];
+		d->acq_half[r] = (int)(d->acq_period[r] / 2.0);
+		for (k = 0; k < LTC_ACQ_SYNC_BITS; k++) {
+			d->acq_offset[r][k] = (int)rint((LTC_ACQ_SYNC_BITS - 1 - k) * d->acq_period[r]);
+		}
+		/* the sync word, the soft decision window and the current sample must fit in the history */
+		if (d->acq_offset[r][0] + 2 * d->acq_half[r] + 1 >= LTC_ACQ_HISTORY) {
+			d->acq_half[r] = 0;
+		}
+	}
+	/* start off searching */
+	d->acq_state = LTC_ACQ_SEARCH;
+	d->acq_fill = 0;
+	d->acq_since_frame = 0;
+}
+
+static void acquisition_search(LTCDecoder *d) {
+	d->acq_state = LTC_ACQ_SEARCH;
+	d->acq_fill = 0;
+	d->acq_since_frame = 0;
+}
+
+static inline int acquisition_amplitude(int amp) {
+	if (amp < 1) return 1;
+	if (amp > SAMPLE_CENTER - 1) return SAMPLE_CENTER - 1;
+	return amp;
+}
+
+/* set up the tracking path as if it had just decoded the first half of the
+ * final '1' of a sync word and is waiting for the transition at the end of it.
+ */
+static void acquisition_handover(LTCDecoder *d, int r, int amp, ltc_off_t pos) {
+	amp = acquisition_amplitude(amp);
+
+	d->snd_to_biphase_period = d->acq_period[r];
+	d->snd_to_biphase_lmt = (d->snd_to_biphase_period * 3) / 4;
+	d->snd_to_biphase_cnt = d->acq_half[r];
+	d->snd_to_biphase_min = SAMPLE_CENTER - amp;
+	d->snd_to_biphase_max = SAMPLE_CENTER + amp;
+	/* snd_to_biphase_state is 1 while the signal is low */
+	d->snd_to_biphase_state = d->acq_prev_level > 0 ? 0 : 1;
+	d->biphase_prev = !d->snd_to_biphase_state;
+	d->biphase_state = 0;
+
+	/* the next bit completes the sync word, the frame starts after it */
+	d->decoder_sync_word = B16(00111111,11111101) >> 1;
+	d->bit_cnt = 0;
+	d->frame_start_prev = pos;
+
+	d->acq_state = LTC_ACQ_OFF;
+	d->acq_since_frame = 0;
+}
+
+/* decode the following bits from the soft decisions, the sync word has just ended at sample t */
+static void acquisition_soft(LTCDecoder *d, int r, float corr, unsigned int t, ltc_off_t pos) {
+	d->acq_state = LTC_ACQ_SOFT;
+	d->acq_rate = r;
+	d->acq_next = (double)t + d->acq_period[r];
+	d->acq_quality = corr / LTC_ACQ_SYNC_BITS;
+	d->acq_since_frame = 0;
+
+	d->decoder_sync_word = B16(00111111,11111101);
+	d->bit_cnt = 0;
+	d->frame_start_prev = pos;
+}
+
+static inline void acquisition_soft_bit(LTCDecoder *d, unsigned int t, ltc_off_t pos) {
+	const int r = d->acq_rate;
+	const unsigned int expected = (unsigned int)rint(d->acq_next);
+	unsigned int end = expected;
+	float soft = d->acq_soft[r][expected & ACQ_MASK];
+	float strength;
+	int queued = d->queue_write_off;
+	int k;
+
+	/* early-late: use whichever of the cells ending a sample either side has the strongest decision */
+	for (k = -1; k <= 1; k += 2) {
+		const float s = d->acq_soft[r][(expected + k) & ACQ_MASK];
+		if (fabsf(s) > fabsf(soft)) {
+			soft = s;
+			end = expected + k;
+		}
+	}
+	d->acq_next += d->acq_period[r] + 0.25 * (double)(int)(end - expected);
+
+	strength = fabsf(soft);
+	d->acq_quality += (strength - d->acq_quality) / 16.0f;
+
+	parse_ltc(d, soft > 0 ? 1 : 0, 0, pos - (ltc_off_t)(t - end) + 1);
+
+	if (queued != d->queue_write_off) {
+		/* a frame was just queued. If the signal is good enough let the tracking path take it from here */
+		if (d->acq_quality > LTC_ACQ_CLEAN) {
+			d->snd_to_biphase_period = d->acq_period[r];
+			d->snd_to_biphase_lmt = (d->snd_to_biphase_period * 3) / 4;
+			d->snd_to_biphase_min = SAMPLE_CENTER - acquisition_amplitude((int)d->acq_amp[r]);
+			d->snd_to_biphase_max = SAMPLE_CENTER + acquisition_amplitude((int)d->acq_amp[r]);
+			d->bit_cnt = 0;
+			d->acq_state = LTC_ACQ_OFF;
+		}
+	}
+}
+
+static inline void acquisition(LTCDecoder *d, ltcsnd_sample_t sample, ltc_off_t pos) {
+	const int x = (int)sample - SAMPLE_CENTER;
+	const unsigned int t = d->acq_pos;
+	int r, k;
+	int best = -1;
+	float best_amp = 0;
+	float best_corr = 0;
+
+	d->acq_sum[t & ACQ_MASK] = d->acq_sum[(t - 1) & ACQ_MASK] + (unsigned int)x;
+
+	for (r = 0; r < LTC_ACQ_RATES; r++) {
+		const int h = d->acq_half[r];
+		float soft = 0;
+		float corr = 0;
+		int h1, h2, amp;
+
+		if (h == 0) continue;
+		if (d->acq_state == LTC_ACQ_SOFT && r != d->acq_rate) continue;
+
+		h2 = (int)(d->acq_sum[t & ACQ_MASK] - d->acq_sum[(t - h) & ACQ_MASK]);
+		h1 = (int)(d->acq_sum[(t - h) & ACQ_MASK] - d->acq_sum[(t - 2 * h) & ACQ_MASK]);
+		amp = abs(h1) + abs(h2);
+
+		/* +1 for a transition in the middle of the cell, -1 for none. Ignore cells below 1 LSB */
+		if (amp >= 2 * h) {
+			soft = (float)(abs(h1 - h2) - abs(h1 + h2)) / (float)amp;
+		}
+		d->acq_soft[r][t & ACQ_MASK] = soft;
+
+		if (d->acq_state == LTC_ACQ_SEARCH && d->acq_fill > d->acq_offset[r][0] + 2 * h) {
+			/* sync word 0011 1111 1111 1101, oldest bit first */
+			for (k = 0; k < LTC_ACQ_SYNC_BITS; k++) {
+				const float s = d->acq_soft[r][(t - d->acq_offset[r][k]) & ACQ_MASK];
+				corr += ((0x3FFD >> (LTC_ACQ_SYNC_BITS - 1 - k)) & 1) ? s : -s;
+			}
+			/* the sync word ended at the previous sample if the correlation peaked there */
+			if (d->acq_corr[r] >= LTC_ACQ_THRESHOLD && d->acq_corr[r] > corr && d->acq_corr[r] > best_corr) {
+				best = r;
+				best_corr = d->acq_corr[r];
+				best_amp = d->acq_amp[r];
+			}
+		}
+		d->acq_corr[r] = corr;
+		/* slow average of the level for seeding the tracking path's thresholds */
+		d->acq_amp[r] += ((float)amp / (float)(2 * h) - d->acq_amp[r]) / 8.0f;
+	}
+
+	if (best >= 0) {
+		d->acq_locks++;
+		if (best_corr >= LTC_ACQ_CLEAN * LTC_ACQ_SYNC_BITS) {
+			/* leave the tracking path alone if it has found the same sync word */
+			if ((d->decoder_sync_word & 0x7FFF) != (B16(00111111,11111101) >> 1)) {
+				acquisition_handover(d, best, (int)best_amp, pos);
+			} else {
+				d->acq_state = LTC_ACQ_OFF;
+				d->acq_since_frame = 0;
+			}
+		} else {
+			acquisition_soft(d, best, best_corr, t - 1, pos);
+		}
+	} else if (d->acq_state == LTC_ACQ_SOFT) {
+		/* decide each bit a sample after it is due so the early-late check has the cell either side */
+		if ((int)(t - (unsigned int)rint(d->acq_next)) >= 1) {
+			acquisition_soft_bit(d, t, pos);
+		}
+		if (d->acq_state == LTC_ACQ_SOFT && ++d->acq_since_frame > LTC_ACQ_LOST_BITS * d->acq_period[d->acq_rate]) {
+			acquisition_search(d);
+		}
+	}
+
+	d->acq_prev_level = x;
+	d->acq_pos++;
+	if (d->acq_fill < LTC_ACQ_HISTORY) d->acq_fill++;
+}
+
+static inline void biphase_decode2(LTCDecoder *d, ltc_off_t offset, ltc_off_t pos) {
+
+	d->biphase_tics[d->biphase_tic] = d->snd_to_biphase_period;
+	d->biphase_tic = (d->biphase_tic + 1) % LTC_FRAME_BIT_COUNT;
+	if (d->snd_to_biphase_cnt <= 2 * d->snd_to_biphase_period) {
+		pos -= (d->snd_to_biphase_period - d->snd_to_biphase_cnt);
+	}
+
+	if (d->snd_to_biphase_state == d->biphase_prev) {
+		d->biphase_state = 1;
+		parse_ltc(d, 0, offset, pos);
+	} else {
+		d->biphase_state = 1 - d->biphase_state;
+		if (d->biphase_state == 1) {
+			parse_ltc(d, 1, offset, pos);
+		}
+	}
+	d->biphase_prev = d->snd_to_biphase_state;
+}
+
+void decoder_reset(LTCDecoder *d) {
+	/* keep the bit period and signal envelope, they still describe the signal,
+	 * but forget the bit and frame being assembled */
+	d->biphase_state = 1;
+	d->biphase_prev = d->snd_to_biphase_state;
+	d->snd_to_biphase_cnt = 0;
+	d->snd_to_biphase_lmt = (d->snd_to_biphase_period * 3) / 4;
+	d->decoder_sync_word = 0;
+	d->bit_cnt = 0;
+	memset(&d->ltc_frame, 0, sizeof(LTCFrame));
+	d->frame_start_off = 0;
+	d->frame_start_prev = -1;
+
+	if (d->acq_state != LTC_ACQ_OFF)
+		acquisition_search(d);
+}
+
+size_t decode_ltc(LTCDecoder *d, ltcsnd_sample_t *sound, size_t size, ltc_off_t posinfo) {
+	size_t i;
+
+	for (i = 0 ; i < size ; i++) {
+		ltcsnd_sample_t max_threshold, min_threshold;
+
+		/* in back-pressure mode stop before a sample that could complete
+		 * a frame the queue has no room for */
+		if (d->queue_backpressure && queue_full(d))
+			return i;
+
+		/* no frame from the tracking path for a while: search for the sync word */
+		if (d->acq_enabled) {
+			if (d->acq_state != LTC_ACQ_OFF) {
+				acquisition(d, sound[i], posinfo + i);
+			} else if (++d->acq_since_frame > LTC_ACQ_LOST_BITS * d->snd_to_biphase_period) {
+				acquisition_search(d);
+			}
+		}
+
+		/* track minimum and maximum values */
+		d->snd_to_biphase_min = SAMPLE_CENTER - (((SAMPLE_CENTER - d->snd_to_biphase_min) * 15) / 16);
+		d->snd_to_biphase_max = SAMPLE_CENTER + (((d->snd_to_biphase_max - SAMPLE_CENTER) * 15) / 16);
+
+		if (sound[i] < d->snd_to_biphase_min)
+			d->snd_to_biphase_min = sound[i];
+		if (sound[i] > d->snd_to_biphase_max)
+			d->snd_to_biphase_max = sound[i];
+
+		/* set the thresholds for hi/lo state tracking */
+		min_threshold = SAMPLE_CENTER - (((SAMPLE_CENTER - d->snd_to_biphase_min) * 8) / 16);
+		max_threshold = SAMPLE_CENTER + (((d->snd_to_biphase_max - SAMPLE_CENTER) * 8) / 16);
+
+		if ( /* Check for a biphase state change */
+			   (  d->snd_to_biphase_state && (sound[i] > max_threshold) )
+			|| ( !d->snd_to_biphase_state && (sound[i] < min_threshold) )
+		   ) {
+
+			/* If the sample count has risen above the biphase length limit */
+			if (d->acq_state == LTC_ACQ_SOFT) {
+				/* bits are coming from the soft decisions */
+			} else if (d->snd_to_biphase_cnt > d->snd_to_biphase_lmt) {
+				/* single state change within a biphase priod. decode to a 0 */
+				biphase_decode2(d, i, posinfo);
+				biphase_decode2(d, i, posinfo);
+
+			} else {
+				/* "short" state change covering half a period
+				 * together with the next or previous state change decode to a 1
+				 */
+				d->snd_to_biphase_cnt *= 2;
+				biphase_decode2(d, i, posinfo);
+
+			}
+
+			if (d->snd_to_biphase_cnt > (d->snd_to_biphase_period * 4)) {
+				/* "long" silence in between
+				 * -> reset parser, don't use it for phase-tracking
+				 */
+				if (d->acq_state != LTC_ACQ_SOFT)
+					d->bit_cnt = 0;
+			} else  {
+				/* track speed variations
+				 * As this is only executed at a state change,
+				 * d->snd_to_biphase_cnt is an accurate representation of the current period length.
+				 */
+				d->snd_to_biphase_period = (d->snd_to_biphase_period * 3.0 + d->snd_to_biphase_cnt) / 4.0;
+
+				/* This limit specifies when a state-change is
+				 * considered biphase-clock or 2*biphase-clock.
+				 * The relation with period has been determined
+				 * empirically through trial-and-error */
+				d->snd_to_biphase_lmt = (d->snd_to_biphase_period * 3) / 4;
+			}
+
+			d->snd_to_biphase_cnt = 0;
+			d->snd_to_biphase_state = !d->snd_to_biphase_state;
+		}
+		d->snd_to_biphase_cnt++;
+	}
+	return size;
+}
@@ -0,0 +1,90 @@
+/*
+   libltc - en+decode linear timecode
+
+   Copyright (C) 2006-2012 Robin Gareus <robin@gareus.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library.
+   If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The LTCDecoder that goes with the reference decoder.c next to it */
+
+#include "ltc.h"
+#ifndef SAMPLE_CENTER // also defined in encoder.h
+#define SAMPLE_CENTER 128 // unsigned 8 bit.
+#endif
+
+#define LTC_ACQ_HISTORY 1024 ///< samples of soft-decision history kept by the sync-word correlator, power of 2
+#define LTC_ACQ_RATES 3 ///< number of bit periods the correlator searches
+#define LTC_ACQ_SYNC_BITS 16
+
+enum LTC_ACQ_STATE {
+	LTC_ACQ_OFF, ///< the tracking path is decoding
+	LTC_ACQ_SEARCH, ///< correlating against the sync word
+	LTC_ACQ_SOFT ///< decoding from soft decisions
+};
+
+struct LTCDecoder {
+	LTCFrameExt* queue;
+	int queue_len;
+	int queue_read_off;
+	int queue_write_off;
+	int queue_backpressure;
+	unsigned long long queue_overflows;
+
+	unsigned char biphase_state;
+	unsigned char biphase_prev;
+	unsigned char snd_to_biphase_state;
+	int snd_to_biphase_cnt;		///< counts the samples in the current period
+	int snd_to_biphase_lmt;	///< specifies when a state-change is considered biphase-clock or 2*biphase-clock
+	double snd_to_biphase_period;	///< track length of a period - used to set snd_to_biphase_lmt
+
+	ltcsnd_sample_t snd_to_biphase_min;
+	ltcsnd_sample_t snd_to_biphase_max;
+
+	unsigned short decoder_sync_word;
+	LTCFrame ltc_frame;
+	int bit_cnt;
+
+	ltc_off_t frame_start_off;
+	ltc_off_t frame_start_prev;
+
+	float biphase_tics[LTC_FRAME_BIT_COUNT];
+	int biphase_tic;
+
+	/* correlation based acquisition - only runs while the tracking path has no lock */
+	int acq_enabled;
+	enum LTC_ACQ_STATE acq_state;
+	int acq_since_frame; ///< samples since a frame was last queued
+	int acq_fill; ///< number of valid samples in the acquisition history
+	unsigned int acq_pos;
+	unsigned int acq_sum[LTC_ACQ_HISTORY]; ///< running sum of the centred signal
+	float acq_soft[LTC_ACQ_RATES][LTC_ACQ_HISTORY]; ///< soft bit decision for a bit cell ending at each sample
+	double acq_period[LTC_ACQ_RATES];
+	int acq_half[LTC_ACQ_RATES];
+	int acq_offset[LTC_ACQ_RATES][LTC_ACQ_SYNC_BITS]; ///< distance back in samples to the end of each bit of the sync word
+	float acq_corr[LTC_ACQ_RATES]; ///< correlation at the previous sample
+	float acq_amp[LTC_ACQ_RATES]; ///< average signal amplitude
+	int acq_prev_level;
+	int acq_rate; ///< candidate being decoded from soft decisions
+	double acq_next; ///< position in the history of the end of the next bit
+	float acq_quality; ///< average strength of the soft decisions
+	unsigned long long acq_locks;
+};
+
+void acquisition_init(LTCDecoder *d, double period);
+void decoder_reset(LTCDecoder *d);
+
+
+size_t decode_ltc(LTCDecoder *d, ltcsnd_sample_t *sound, size_t size, ltc_off_t posinfo);
@@ -0,0 +1,125 @@
+//Dumps an ltcclient event recorder file to CSV on stdout, oldest frame first
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+#include "eventrecorder.h"
+#include "ltc.h"
+#include "timecodeindex.h"
+#include "log.h"
+#include "utils.h"
+
+using namespace std;
+
+namespace
+{
+    const string STR_COMMAND[4] = {"", "slew", "frequency", "step"};
+
+    string ToIso(int64_t nNs)
+    {
+        return ConvertTimeToIsoString(std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(nNs))));
+    }
+
+    string ToTimecode(const uint8_t* pRaw)
+    {
+        LTCFrame frame;
+        memcpy(&frame, pRaw, sizeof(frame));
+
+        stringstream ss;
+        ss << setfill('0') << setw(2) << (frame.hours_tens*10 + frame.hours_units) << ":"
+           << setw(2) << (frame.mins_tens*10 + frame.mins_units) << ":"
+           << setw(2) << (frame.secs_tens*10 + frame.secs_units) << (frame.dfbit ? ";" : ":")
+           << setw(2) << (frame.frame_tens*10 + frame.frame_units);
+        return ss.str();
+    }
+
+    //frames missing between this record's timecode and the previous one's, blank if either can't be placed
+    string ToGap(const framerecord& record, long long& nLastIndex)
+    {
+        LTCFrame frame;
+        memcpy(&frame, record.raw, sizeof(frame));
+        int nFPS = static_cast<int>(record.fFPS+0.5f);
+        long long nIndex = -1;
+        long long nPerDay = 0;
+        if(nFPS == 24 || nFPS == 25 || nFPS == 30)
+        {
+            TimecodeIndex index(nFPS, frame.dfbit != 0);
+            nIndex = index.ToIndex(frame, 0);
+            nPerDay = index.GetFramesPerDay();
+        }
+
+        string sGap;
+        if(nIndex >= 0 && nLastIndex >= 0)
+        {
+            sGap = to_string(((nIndex-nLastIndex-1)%nPerDay + nPerDay)%nPerDay);
+        }
+        nLastIndex = nIndex;
+        return sGap;
+    }
+
+    string ToHex(const uint8_t* pRaw, size_t nSize)
+    {
+        stringstream ss;
+        ss << hex << setfill('0');
+        for(size_t i = 0; i < nSize; i++)
+        {
+            ss << setw(2) << static_cast<unsigned int>(pRaw[i]);
+        }
+        return ss.str();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " <recorder file>" << endl;
+        return -1;
+    }
+
+    pml::LogStream::AddOutput(std::make_unique<pml::LogOutput>());
+
+    EventReader reader;
+    if(reader.Open(argv[1]) == false)
+    {
+        return -1;
+    }
+
+    cout << "sequence,capture_time,ltc_time,timecode,offset_us,frame_start,frame_end,volume_dbfs,fps,ppm,rejected,command,command_value,"
+         << "discontinuity,synced,discarded,source,failover,combined,paused,tc_gap,raw" << endl;
+
+    cout << setprecision(9);
+    framerecord record;
+    long long nLastIndex = -1;
+    while(reader.Next(record))
+    {
+        cout << record.nSequence << ","
+             << ToIso(record.nCaptureNs) << ","
+             << ToIso(record.nLtcNs) << ","
+             << ToTimecode(record.raw) << ","
+             << record.nOffsetUs << ","
+             << record.nFrameStart << ","
+             << record.nFrameEnd << ","
+             << record.fVolume << ","
+             << record.fFPS << ","
+             << record.fPPM << ","
+             << record.nRejected << ","
+             << (record.nCommand < 4 ? STR_COMMAND[record.nCommand] : to_string(record.nCommand)) << ","
+             << record.dCommandValue << ","
+             << ((record.nFlags & framerecord::FLAG_DISCONTINUITY) ? 1 : 0) << ","
+             << ((record.nFlags & framerecord::FLAG_SYNCED) ? 1 : 0) << ","
+             << ((record.nFlags & framerecord::FLAG_DISCARDED) ? 1 : 0) << ","
+             << static_cast<unsigned int>(record.nSource) << ","
+             << ((record.nFlags & framerecord::FLAG_FAILOVER) ? 1 : 0) << ","
+             << ((record.nFlags & framerecord::FLAG_COMBINED) ? 1 : 0) << ","
+             << ((record.nFlags & framerecord::FLAG_PAUSED) ? 1 : 0) << ","
+             << ToGap(record, nLastIndex) << ","
+             << ToHex(record.raw, sizeof(record.raw)) << "\n";
+    }
+
+    if(reader.GetSkipped() != 0)
+    {
+        cerr << reader.GetSkipped() << " torn records skipped" << endl;
+    }
+    return 0;
+}